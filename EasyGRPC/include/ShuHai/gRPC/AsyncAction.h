@@ -2,15 +2,30 @@
 
 #include "ShuHai/gRPC/IAsyncAction.h"
 
+#include <future>
+#include <functional>
+
 namespace ShuHai::gRPC
 {
     template<typename T>
     class AsyncAction : public IAsyncAction
     {
     public:
+        using ResultCallback = std::function<void(std::future<T>)>;
+
         std::future<T> result() { return _resultPromise.get_future(); }
 
-        void setResult(T result) { _resultPromise.set_value(result); }
+        /**
+         * \brief Set the function to be called with the future of the result once the result is set, the future is
+         *  not available by result() in that case.
+         */
+        void setResultCallback(ResultCallback callback) { _resultCallback = std::move(callback); }
+
+        void setResult(T result)
+        {
+            _resultPromise.set_value(result);
+            notifyResult();
+        }
 
         template<typename E, typename... Args>
         void setException(Args... args)
@@ -23,19 +38,39 @@ namespace ShuHai::gRPC
             {
                 _resultPromise.set_exception(std::current_exception());
             }
+            notifyResult();
         }
 
     private:
+        void notifyResult()
+        {
+            if (_resultCallback)
+                _resultCallback(_resultPromise.get_future());
+        }
+
         std::promise<T> _resultPromise;
+        ResultCallback _resultCallback;
     };
 
     template<>
     class AsyncAction<void> : public IAsyncAction
     {
     public:
+        using ResultCallback = std::function<void(std::future<void>)>;
+
         std::future<void> result() { return _resultPromise.get_future(); }
 
-        void setResult() { _resultPromise.set_value(); }
+        /**
+         * \brief Set the function to be called with the future of the result once the result is set, the future is
+         *  not available by result() in that case.
+         */
+        void setResultCallback(ResultCallback callback) { _resultCallback = std::move(callback); }
+
+        void setResult()
+        {
+            _resultPromise.set_value();
+            notifyResult();
+        }
 
         template<typename E, typename... Args>
         void setException(Args... args)
@@ -48,10 +83,18 @@ namespace ShuHai::gRPC
             {
                 _resultPromise.set_exception(std::current_exception());
             }
+            notifyResult();
         }
 
     private:
+        void notifyResult()
+        {
+            if (_resultCallback)
+                _resultCallback(_resultPromise.get_future());
+        }
+
         std::promise<void> _resultPromise;
+        ResultCallback _resultCallback;
     };
 
     template class AsyncAction<bool>;
@@ -6,9 +6,11 @@
 
 #include <atomic>
 #include <mutex>
+#include <shared_mutex>
 #include <condition_variable>
 #include <utility>
 #include <type_traits>
+#include <cstdint>
 
 namespace ShuHai::gRPC
 {
@@ -22,7 +24,11 @@ namespace ShuHai::gRPC
             : _completionQueue(std::move(cq))
         { }
 
-        virtual ~AsyncActionQueue() { waitForShutdown(); }
+        virtual ~AsyncActionQueue()
+        {
+            shutdown();
+            drain();
+        }
 
         AsyncActionQueue(const AsyncActionQueue&) = delete;
         AsyncActionQueue& operator=(const AsyncActionQueue&) = delete;
@@ -33,41 +39,107 @@ namespace ShuHai::gRPC
          * \return true if an event is handled or the \p deadline is up, false if the server shutdown.
          */
         grpc::CompletionQueue::NextStatus asyncNext(const gpr_timespec& deadline = gpr_inf_future(GPR_CLOCK_REALTIME))
+        {
+            return asyncNext(deadline, []() {});
+        }
+
+        /**
+         * \brief Same as asyncNext(const gpr_timespec&), except that \p onEvent is invoked once an event arrives,
+         *  before the event is handled.
+         */
+        template<typename Func>
+        grpc::CompletionQueue::NextStatus asyncNext(const gpr_timespec& deadline, Func&& onEvent)
         {
             void* tag {};
             bool ok;
             auto status = _completionQueue->AsyncNext(&tag, &ok, deadline);
             if (status == grpc::CompletionQueue::GOT_EVENT)
+            {
+                std::forward<Func>(onEvent)();
                 finalizeResult(tag, ok);
+            }
+            return status;
+        }
 
-            _nextStatus.store(status, std::memory_order_release);
+        /**
+         * \brief Shut down the queue, no operation is allowed to start afterwards while the pending ones are still
+         *  delivered. Shutting down a queue that is already shut down has no effect.
+         */
+        virtual void shutdown()
+        {
+            std::unique_lock l(_shutdownMutex);
+            if (_shutdown)
+                return;
+            _shutdown = true;
+            _completionQueue->Shutdown();
+        }
 
-            return status;
+        [[nodiscard]] bool isShutdown() const
+        {
+            std::shared_lock l(_shutdownMutex);
+            return _shutdown;
         }
 
-        virtual void shutdown() { _completionQueue->Shutdown(); }
+        /**
+         * \brief Block until the queue is shut down and all its pending events are handled. The calling thread handles
+         *  the pending events together with other threads polling the queue, if any, thus the queue is drained even if
+         *  nobody else polls it. The queue has to be shut down, or the call blocks forever.
+         */
+        void drain()
+        {
+            while (asyncNext() != grpc::CompletionQueue::SHUTDOWN)
+                continue;
+        }
+
+        /**
+         * \brief Invoke the specified function that starts an operation on the underlying completion queue, unless the
+         *  queue is shut down. No operation is allowed to start on a completion queue after it is shut down, so any
+         *  operation that possibly starts after shutdown (e.g. writing a stream from a user thread) should start this
+         *  way.
+         * \return true if the function is invoked, false if the queue is already shut down.
+         */
+        template<typename Func>
+        bool tryStartOperation(Func&& func)
+        {
+            std::shared_lock l(_shutdownMutex);
+            if (_shutdown)
+                return false;
+            std::forward<Func>(func)();
+            return true;
+        }
 
         /**
          * \brief The underlying grpc::CompletionQueue that current instance wraps.
          */
         [[nodiscard]] grpc::CompletionQueue* completionQueue() const { return _completionQueue.get(); }
 
-    private:
-        static void finalizeResult(void* tag, bool ok)
+        /**
+         * \brief Make the completion queue tag of an action that is owned by someone else, e.g. an action embedded in a
+         *  call object and reused for each of its operations. Unlike actions tagged by their address, the action is not
+         *  deleted once its result is finalized, thus no allocation is required per completion queue event.
+         */
+        static void* embeddedTag(IAsyncAction* action)
         {
-            auto action = static_cast<IAsyncAction*>(tag);
-            action->finalizeResult(ok);
-            delete action;
+            return reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(action) | EmbeddedTagBit);
         }
 
-        void waitForShutdown()
+    private:
+        // Actions are at least pointer aligned, the lowest bit of a tag is free to mark embedded actions.
+        static constexpr std::uintptr_t EmbeddedTagBit = 1;
+        static_assert(alignof(IAsyncAction) > EmbeddedTagBit);
+
+        static void finalizeResult(void* tag, bool ok)
         {
-            while (_nextStatus.load(std::memory_order_acquire) != grpc::CompletionQueue::SHUTDOWN)
-                continue;
+            auto bits = reinterpret_cast<std::uintptr_t>(tag);
+            auto action = reinterpret_cast<IAsyncAction*>(bits & ~EmbeddedTagBit);
+            action->finalizeResult(ok);
+            if (!(bits & EmbeddedTagBit))
+                delete action;
         }
 
         std::unique_ptr<grpc::CompletionQueue> _completionQueue;
 
-        std::atomic<grpc::CompletionQueue::NextStatus> _nextStatus;
+        mutable std::shared_mutex _shutdownMutex;
+        bool _shutdown {};
     };
 }
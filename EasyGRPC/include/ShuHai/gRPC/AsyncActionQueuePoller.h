@@ -0,0 +1,265 @@
+#pragma once
+
+#include "ShuHai/gRPC/AsyncActionQueue.h"
+#include "ShuHai/gRPC/PollerOptions.h"
+#include "ShuHai/gRPC/ThreadAffinity.h"
+
+#include <grpc/support/time.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+namespace ShuHai::gRPC
+{
+    /**
+     * \brief Threads that poll an AsyncActionQueue until it is shut down, by blocking in wait for events or by spinning
+     *  for a while before blocking, see PollerOptions::spinDurations. The number of threads grows and shrinks with the
+     *  load if PollerOptions::maxThreadCount is set, the load is measured and the threads are started by a separate
+     *  thread so that the polling threads are never held up by it.
+     */
+    class AsyncActionQueuePoller
+    {
+    public:
+        /**
+         * \brief Start polling the specified \p queue.
+         * \param queue The queue to poll, it must outlive current instance.
+         * \param options Options of the polling threads.
+         * \param queueIndex Index of the queue among the queues polled with the same options, which selects the CPU set
+         *  of the threads.
+         */
+        AsyncActionQueuePoller(AsyncActionQueue& queue, const PollerOptions& options, size_t queueIndex = 0)
+            : _queue(queue)
+            , _cpus(options.cpusOf(queueIndex))
+            , _spinDuration(options.spinDurationOf(queueIndex))
+            , _minThreadCount(options.threadCount)
+            , _maxThreadCount(std::max(options.threadCount, options.maxThreadCount))
+            , _idleTimeout(options.idleTimeout)
+            , _growBusyRatio(options.growBusyRatio)
+            , _growInterval(options.growInterval)
+        {
+            if (options.threadCount == 0)
+                throw std::invalid_argument("At least one polling thread is required.");
+            if (_spinDuration < std::chrono::nanoseconds::zero())
+                throw std::invalid_argument("Spin duration of polling threads must not be negative.");
+            if (elastic() && _idleTimeout <= std::chrono::nanoseconds::zero())
+                throw std::invalid_argument("Idle timeout of elastic polling threads must be greater than zero.");
+            if (elastic() && (!(_growBusyRatio > 0) || _growInterval <= std::chrono::nanoseconds::zero()))
+                throw std::invalid_argument("Busy ratio and interval of growing polling threads must be positive.");
+
+            {
+                std::lock_guard l(_threadsMutex);
+                for (size_t i = 0; i < _minThreadCount; ++i)
+                    startThread();
+            }
+            if (elastic())
+                _growingThread = std::thread([this]() { runGrowing(); });
+        }
+
+        ~AsyncActionQueuePoller() { join(); }
+
+        AsyncActionQueuePoller(const AsyncActionQueuePoller&) = delete;
+        AsyncActionQueuePoller& operator=(const AsyncActionQueuePoller&) = delete;
+
+        /**
+         * \brief Number of threads currently polling the queue.
+         */
+        [[nodiscard]] size_t threadCount() const { return _threadCount.load(std::memory_order_relaxed); }
+
+        /**
+         * \brief Total time the threads spent on handling events rather than waiting for them.
+         */
+        [[nodiscard]] std::chrono::nanoseconds busyTime() const
+        {
+            return std::chrono::nanoseconds(_busyNanoseconds.load(std::memory_order_relaxed));
+        }
+
+        /**
+         * \brief Wait for the polling threads to exit, which happens once the queue is shut down and drained.
+         */
+        void join()
+        {
+            if (_growingThread.joinable())
+            {
+                {
+                    std::lock_guard l(_growingMutex);
+                    _growingStopped = true;
+                }
+                _growingCondition.notify_one();
+                _growingThread.join();
+            }
+
+            // Threads are started by the growing thread only, none starts once it is stopped.
+            std::vector<std::thread> threads;
+            {
+                std::lock_guard l(_threadsMutex);
+                threads.swap(_threads);
+                _retiredThreadIds.clear();
+            }
+            for (auto& t : threads)
+                t.join();
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        [[nodiscard]] bool elastic() const { return _maxThreadCount > _minThreadCount; }
+
+        // Must be called with _threadsMutex locked.
+        void startThread()
+        {
+            _threadCount.fetch_add(1, std::memory_order_relaxed);
+            _threads.emplace_back(
+                [this]()
+                {
+                    if (!_cpus.empty())
+                        setCurrentThreadAffinity(_cpus);
+                    poll();
+                });
+        }
+
+        // Start another thread once the threads stay busy for most of an interval. Starting and joining threads takes
+        // long, thus it is done here rather than by the polling threads in between events.
+        void runGrowing()
+        {
+            auto busyNanoseconds = _busyNanoseconds.load(std::memory_order_relaxed);
+            auto time = Clock::now();
+
+            std::unique_lock l(_growingMutex);
+            while (!_growingCondition.wait_for(l, _growInterval, [this]() { return _growingStopped; }))
+            {
+                auto latestBusyNanoseconds = _busyNanoseconds.load(std::memory_order_relaxed);
+                auto latestTime = Clock::now();
+                auto busyTime = static_cast<double>(latestBusyNanoseconds - busyNanoseconds);
+                auto interval = static_cast<double>((latestTime - time).count());
+                busyNanoseconds = latestBusyNanoseconds;
+                time = latestTime;
+
+                // The threads exit once the queue is shut down, no thread is started for the events drained then.
+                auto threads = threadCount();
+                if (threads == 0 || _queue.isShutdown())
+                    continue;
+
+                if (busyTime / interval / static_cast<double>(threads) >= _growBusyRatio)
+                {
+                    l.unlock();
+                    grow();
+                    l.lock();
+                }
+            }
+        }
+
+        void grow()
+        {
+            std::vector<std::thread> retiredThreads;
+            {
+                std::lock_guard l(_threadsMutex);
+
+                // Retired threads are already exiting.
+                for (auto id : _retiredThreadIds)
+                {
+                    auto it =
+                        std::find_if(_threads.begin(), _threads.end(), [id](auto& t) { return t.get_id() == id; });
+                    if (it == _threads.end())
+                        continue;
+                    retiredThreads.emplace_back(std::move(*it));
+                    _threads.erase(it);
+                }
+                _retiredThreadIds.clear();
+
+                if (_threadCount.load(std::memory_order_relaxed) < _maxThreadCount && !_queue.isShutdown())
+                    startThread();
+            }
+
+            for (auto& t : retiredThreads)
+                t.join();
+        }
+
+        // Threads beyond the minimum number retire once they stay idle for the idle timeout.
+        bool tryRetire()
+        {
+            std::lock_guard l(_threadsMutex);
+            if (_threadCount.load(std::memory_order_relaxed) <= _minThreadCount)
+                return false;
+            _threadCount.fetch_sub(1, std::memory_order_relaxed);
+            _retiredThreadIds.emplace_back(std::this_thread::get_id());
+            return true;
+        }
+
+        grpc::CompletionQueue::NextStatus next(const gpr_timespec& deadline)
+        {
+            bool gotEvent = false;
+            Clock::time_point eventTime;
+            auto status = _queue.asyncNext(deadline,
+                [&gotEvent, &eventTime]()
+                {
+                    gotEvent = true;
+                    eventTime = Clock::now();
+                });
+            if (gotEvent)
+                _busyNanoseconds.fetch_add((Clock::now() - eventTime).count(), std::memory_order_relaxed);
+            return status;
+        }
+
+        void poll()
+        {
+            auto immediately = gpr_time_0(GPR_CLOCK_MONOTONIC);
+            while (true)
+            {
+                auto status = grpc::CompletionQueue::TIMEOUT;
+
+                // Each event renews the spin duration, the thread blocks only once the queue stays idle for that long.
+                if (_spinDuration > std::chrono::nanoseconds::zero())
+                {
+                    auto spinEnd = Clock::now() + _spinDuration;
+                    do
+                    {
+                        status = next(immediately);
+                    } while (status == grpc::CompletionQueue::TIMEOUT && Clock::now() < spinEnd);
+                }
+
+                if (status == grpc::CompletionQueue::TIMEOUT)
+                {
+                    status = next(elastic() ? gpr_time_add(gpr_now(GPR_CLOCK_MONOTONIC),
+                                                  gpr_time_from_nanos(_idleTimeout.count(), GPR_TIMESPAN))
+                                            : gpr_inf_future(GPR_CLOCK_MONOTONIC));
+                    if (status == grpc::CompletionQueue::TIMEOUT && tryRetire())
+                        return;
+                }
+
+                if (status == grpc::CompletionQueue::SHUTDOWN)
+                {
+                    _threadCount.fetch_sub(1, std::memory_order_relaxed);
+                    return;
+                }
+            }
+        }
+
+        AsyncActionQueue& _queue;
+        const std::vector<size_t> _cpus;
+        const std::chrono::nanoseconds _spinDuration;
+        const size_t _minThreadCount;
+        const size_t _maxThreadCount;
+        const std::chrono::nanoseconds _idleTimeout;
+        const double _growBusyRatio;
+        const std::chrono::nanoseconds _growInterval;
+
+        std::atomic<size_t> _threadCount { 0 };
+        std::atomic<int64_t> _busyNanoseconds { 0 };
+
+        std::mutex _threadsMutex;
+        std::vector<std::thread> _threads;
+        std::vector<std::thread::id> _retiredThreadIds;
+
+        std::mutex _growingMutex;
+        std::condition_variable _growingCondition;
+        bool _growingStopped {};
+        std::thread _growingThread;
+    };
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace ShuHai::gRPC
+{
+    /**
+     * \brief Tells whether an operation is cancelled, e.g. a call whose client has gone away. Checking the token costs
+     *  a single atomic load, so long computations are able to check it often and stop early. A default constructed
+     *  token is never cancelled.
+     */
+    class CancellationToken
+    {
+    public:
+        CancellationToken() = default;
+
+        explicit CancellationToken(std::shared_ptr<const std::atomic_bool> cancelled)
+            : _cancelled(std::move(cancelled))
+        { }
+
+        [[nodiscard]] bool cancelled() const { return _cancelled && _cancelled->load(std::memory_order_acquire); }
+
+    private:
+        std::shared_ptr<const std::atomic_bool> _cancelled;
+    };
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include "ShuHai/gRPC/Client/AsyncClientStreamWriter.h"
+#include "ShuHai/gRPC/Client/AsyncServerStreamReader.h"
+#include "ShuHai/gRPC/Client/AsyncCall.h"
+#include "ShuHai/gRPC/Client/TypeTraits.h"
+#include "ShuHai/gRPC/SharedPromise.h"
+
+#include <future>
+#include <memory>
+#include <mutex>
+
+namespace ShuHai::gRPC::Client
+{
+    /**
+     * \brief Bidirectional streaming call. Messages are written by the stream writer and read by the stream reader, a
+     *  read and a write are allowed to be in progress at the same time. The call finishes once the stream writer
+     *  finished and all messages are read.
+     */
+    template<typename CallFunc>
+    class AsyncBidiStreamCall
+        : public AsyncCall
+        , public std::enable_shared_from_this<AsyncBidiStreamCall<CallFunc>>
+    {
+    public:
+        SHUHAI_GRPC_CLIENT_EXPAND_AsyncCallTraits(CallFunc);
+        using StreamWriter = AsyncClientStreamWriter<CallFunc>;
+        using StreamReader = AsyncServerStreamReader<CallFunc>;
+        using DeadCallback = std::function<void(std::shared_ptr<AsyncBidiStreamCall>)>;
+
+        AsyncBidiStreamCall(Stub* stub, CallFunc func, std::unique_ptr<grpc::ClientContext> context,
+            gRPC::AsyncActionQueue* actionQueue, DeadCallback deadCallback)
+            : AsyncCall(std::move(context))
+            , _stub(stub)
+            , _func(func)
+            , _actionQueue(actionQueue)
+            , _deadCallback(std::move(deadCallback))
+        { }
+
+        ~AsyncBidiStreamCall() override
+        {
+            delete _streamReader;
+            _streamReader = nullptr;
+            delete _streamWriter;
+            _streamWriter = nullptr;
+        }
+
+        /**
+         * \brief The stream writer of the call, it is ready once the call started.
+         */
+        [[nodiscard]] std::shared_future<StreamWriter*> streamWriter() { return _streamWriterPromise.future(); }
+
+        /**
+         * \brief Same as streamWriter(), except that the future is passed to the specified \p callback once it is
+         *  ready, on the thread that makes it ready, or immediately if it is already ready.
+         */
+        void streamWriter(typename SharedPromise<StreamWriter*>::Callback callback)
+        {
+            _streamWriterPromise.then(std::move(callback));
+        }
+
+        /**
+         * \brief The stream reader of the call, it is ready once the call started.
+         */
+        [[nodiscard]] std::shared_future<StreamReader*> streamReader() { return _streamReaderPromise.future(); }
+
+        /**
+         * \brief Same as streamReader(), except that the future is passed to the specified \p callback once it is
+         *  ready, on the thread that makes it ready, or immediately if it is already ready.
+         */
+        void streamReader(typename SharedPromise<StreamReader*>::Callback callback)
+        {
+            _streamReaderPromise.then(std::move(callback));
+        }
+
+        /**
+         * \brief The final status of the call, it is ready once the stream writer finished and all messages are read.
+         */
+        [[nodiscard]] std::shared_future<grpc::Status> finished() const { return _finishedPromise.future(); }
+
+        /**
+         * \brief Same as finished(), except that the future is passed to the specified \p callback once it is
+         *  ready, on the thread that makes it ready, or immediately if it is already ready.
+         */
+        void finished(typename SharedPromise<grpc::Status>::Callback callback)
+        {
+            _finishedPromise.then(std::move(callback));
+        }
+
+    private:
+        template<typename... Stubs>
+        friend class AsyncClient;
+
+        // The call starts once it is owned by the client, since it may finish on another polling thread as soon as its
+        // stream is ready.
+        void start()
+        {
+            // The call may start before the stream reader and writer are created.
+            std::lock_guard l(_startMutex);
+            auto cq = _actionQueue->completionQueue();
+            _stream = (_stub->*_func)(this->_context.get(), cq, new CallAction(this));
+            _streamWriter =
+                new StreamWriter(_actionQueue, *_stream, this->_status, [this]() { onStreamWriterFinished(); });
+            _streamReader = new StreamReader(_actionQueue, *_stream, [this]() { onStreamReaderFinished(); });
+        }
+
+        class CallAction : public IAsyncAction
+        {
+        public:
+            explicit CallAction(AsyncBidiStreamCall* owner)
+                : _owner(owner)
+            { }
+
+            // The call may finish on another polling thread once its stream is ready, it is kept alive until the
+            // notification is done.
+            void finalizeResult(bool ok) override
+            {
+                auto owner = _owner->shared_from_this();
+                owner->markStreamReady();
+            }
+
+        private:
+            AsyncBidiStreamCall* const _owner;
+        };
+
+        class FinishAction : public IAsyncAction
+        {
+        public:
+            explicit FinishAction(AsyncBidiStreamCall* owner)
+                : _owner(owner)
+            { }
+
+            void perform() { _owner->_stream->Finish(&_owner->_status, this); }
+
+            void finalizeResult(bool ok) override { _owner->finalizeFinish(); }
+
+        private:
+            AsyncBidiStreamCall* const _owner;
+        };
+
+        void markStreamReady()
+        {
+            {
+                // Wait until the stream reader and writer are created.
+                std::lock_guard l(_startMutex);
+            }
+            _streamWriterPromise.setValue(_streamWriter);
+            _streamReaderPromise.setValue(_streamReader);
+        }
+
+        void onStreamWriterFinished()
+        {
+            bool finish;
+            {
+                std::lock_guard l(_finishMutex);
+                _writeDone = true;
+                finish = _readDone;
+            }
+            if (finish)
+                performFinish();
+        }
+
+        void onStreamReaderFinished()
+        {
+            bool finish;
+            {
+                std::lock_guard l(_finishMutex);
+                _readDone = true;
+                finish = _writeDone;
+            }
+
+            // No more message is going to be read, the server has finished the call, further writes are meaningless.
+            if (finish)
+                performFinish();
+            else
+                _streamWriter->finishIfNotRequested();
+        }
+
+        void performFinish()
+        {
+            auto action = new FinishAction(this);
+            if (_actionQueue->tryStartOperation([action]() { action->perform(); }))
+                return;
+
+            delete action;
+            this->_status = grpc::Status(grpc::StatusCode::CANCELLED, "The completion queue is shut down.");
+            finalizeFinish();
+        }
+
+        void finalizeFinish()
+        {
+            _finishedPromise.setValue(this->_status);
+
+            if (_deadCallback)
+                _deadCallback(this->shared_from_this());
+        }
+
+        Stub* const _stub;
+        const CallFunc _func;
+        gRPC::AsyncActionQueue* const _actionQueue;
+
+        std::mutex _startMutex;
+        std::unique_ptr<StreamingInterface> _stream;
+
+        StreamWriter* _streamWriter {};
+        SharedPromise<StreamWriter*> _streamWriterPromise;
+
+        StreamReader* _streamReader {};
+        SharedPromise<StreamReader*> _streamReaderPromise;
+
+        std::mutex _finishMutex;
+        bool _writeDone {};
+        bool _readDone {};
+        SharedPromise<grpc::Status> _finishedPromise;
+
+        DeadCallback _deadCallback;
+    };
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+namespace ShuHai::gRPC::Client
+{
+    /**
+     * \brief Hedging policy of an idempotent unary method, see AsyncClient::callHedged(). A call that gets no response
+     *  within the hedge delay is sent again, and the first successful attempt wins. The delay is either fixed or a
+     *  percentile of the recent latency of the method, so that only the slowest calls are hedged. Hedges are paid from
+     *  a budget that each call adds a fraction of a hedge to, which caps the extra load put on the servers.
+     *  A hedger is expected to be shared by all calls of the same method.
+     */
+    class AsyncCallHedger
+    {
+    public:
+        struct Options
+        {
+            /**
+             * \brief Delay before each hedge, the delay follows delayPercentile if zero.
+             */
+            std::chrono::nanoseconds delay {};
+
+            /**
+             * \brief Percentile of the latency of recent successful attempts used as the delay, in range (0, 1).
+             */
+            double delayPercentile = 0.95;
+
+            /**
+             * \brief Lower bound of the delay that follows delayPercentile.
+             */
+            std::chrono::nanoseconds minDelay = std::chrono::milliseconds(1);
+
+            /**
+             * \brief Number of recent latency samples that the percentile is taken from. Calls are not hedged by
+             *  percentile until the window is full.
+             */
+            size_t sampleWindow = 1000;
+
+            /**
+             * \brief Maximum number of attempts of a call, including the first one.
+             */
+            size_t maxAttempts = 2;
+
+            /**
+             * \brief Number of hedges each call adds to the budget, e.g. 0.05 allows about 5% extra attempts.
+             */
+            double budgetRatio = 0.05;
+
+            /**
+             * \brief Maximum number of hedges in the budget, which is also the initial budget. It caps the burst of
+             *  hedges once many calls turn slow at the same time.
+             */
+            double maxBudget = 10;
+        };
+
+        AsyncCallHedger()
+            : AsyncCallHedger(Options())
+        { }
+
+        explicit AsyncCallHedger(const Options& options)
+            : _options(options)
+            , _budget(options.maxBudget)
+        {
+            if (options.delay < std::chrono::nanoseconds::zero() || options.minDelay < std::chrono::nanoseconds::zero())
+                throw std::invalid_argument("Hedge delay must not be negative.");
+            if (!(options.delayPercentile > 0 && options.delayPercentile < 1))
+                throw std::invalid_argument("Percentile of hedge delay must be in range (0, 1).");
+            if (options.sampleWindow == 0)
+                throw std::invalid_argument("Sample window of hedger must be greater than zero.");
+            if (options.maxAttempts == 0)
+                throw std::invalid_argument("At least one attempt is required.");
+            if (options.budgetRatio < 0 || options.maxBudget < 0)
+                throw std::invalid_argument("Hedge budget must not be negative.");
+
+            _samples.reserve(options.sampleWindow);
+        }
+
+        AsyncCallHedger(const AsyncCallHedger&) = delete;
+        AsyncCallHedger& operator=(const AsyncCallHedger&) = delete;
+
+        [[nodiscard]] const Options& options() const { return _options; }
+
+        /**
+         * \brief The delay before a hedge, empty while the delay follows the percentile and too few samples are
+         *  collected.
+         */
+        [[nodiscard]] std::optional<std::chrono::nanoseconds> delay() const
+        {
+            if (_options.delay > std::chrono::nanoseconds::zero())
+                return _options.delay;
+
+            auto delay = _percentileDelay.load(std::memory_order_relaxed);
+            if (delay < 0)
+                return std::nullopt;
+            return std::max(std::chrono::nanoseconds(delay), _options.minDelay);
+        }
+
+        /**
+         * \brief Number of calls made with current hedger.
+         */
+        [[nodiscard]] uint64_t callCount() const { return _callCount.load(std::memory_order_relaxed); }
+
+        /**
+         * \brief Number of hedges sent, i.e. attempts beyond the first one of each call.
+         */
+        [[nodiscard]] uint64_t hedgeCount() const { return _hedgeCount.load(std::memory_order_relaxed); }
+
+        /**
+         * \brief Number of calls whose response came from a hedge rather than the first attempt.
+         */
+        [[nodiscard]] uint64_t hedgeWinCount() const { return _hedgeWinCount.load(std::memory_order_relaxed); }
+
+        /**
+         * \brief Number of hedges not sent since the budget ran out.
+         */
+        [[nodiscard]] uint64_t budgetExhaustedCount() const
+        {
+            return _budgetExhaustedCount.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief Account a new call, which adds to the budget.
+         */
+        void addCall()
+        {
+            _callCount.fetch_add(1, std::memory_order_relaxed);
+            if (_options.budgetRatio <= 0)
+                return;
+
+            auto budget = _budget.load(std::memory_order_relaxed);
+            while (budget < _options.maxBudget
+                && !_budget.compare_exchange_weak(
+                    budget, std::min(budget + _options.budgetRatio, _options.maxBudget), std::memory_order_relaxed))
+                continue;
+        }
+
+        /**
+         * \brief Take a hedge from the budget.
+         * \return false if the budget is exhausted, the hedge is not expected to be sent in that case.
+         */
+        bool tryAcquireHedge()
+        {
+            auto budget = _budget.load(std::memory_order_relaxed);
+            while (true)
+            {
+                if (budget < 1)
+                {
+                    _budgetExhaustedCount.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                if (_budget.compare_exchange_weak(budget, budget - 1, std::memory_order_relaxed))
+                    break;
+            }
+            _hedgeCount.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        /**
+         * \brief Account a call whose response came from a hedge.
+         */
+        void addHedgeWin() { _hedgeWinCount.fetch_add(1, std::memory_order_relaxed); }
+
+        /**
+         * \brief Add the latency of a successful attempt.
+         */
+        void addSample(std::chrono::nanoseconds latency)
+        {
+            if (_options.delay > std::chrono::nanoseconds::zero())
+                return;
+
+            // Missing the latency of an attempt that completes along with another one barely moves the percentile of
+            // a whole window.
+            std::unique_lock l(_mutex, std::try_to_lock);
+            if (!l.owns_lock())
+                return;
+
+            if (_samples.size() < _options.sampleWindow)
+                _samples.emplace_back(latency.count());
+            else
+                _samples[_nextSampleIndex] = latency.count();
+            _nextSampleIndex = (_nextSampleIndex + 1) % _options.sampleWindow;
+
+            // The percentile is taken once per eighth of the window, which keeps the cost per sample low.
+            if (_samples.size() < _options.sampleWindow)
+                return;
+            bool updated = _percentileDelay.load(std::memory_order_relaxed) >= 0;
+            if (updated && ++_samplesSinceUpdate < (_options.sampleWindow + 7) / 8)
+                return;
+            _samplesSinceUpdate = 0;
+
+            _sortBuffer.assign(_samples.begin(), _samples.end());
+            auto nth = _sortBuffer.begin()
+                + static_cast<ptrdiff_t>(_options.delayPercentile * static_cast<double>(_sortBuffer.size() - 1));
+            std::nth_element(_sortBuffer.begin(), nth, _sortBuffer.end());
+            _percentileDelay.store(*nth, std::memory_order_relaxed);
+        }
+
+    private:
+        const Options _options;
+
+        std::atomic<double> _budget;
+        std::atomic<int64_t> _percentileDelay { -1 };
+
+        std::atomic<uint64_t> _callCount {};
+        std::atomic<uint64_t> _hedgeCount {};
+        std::atomic<uint64_t> _hedgeWinCount {};
+        std::atomic<uint64_t> _budgetExhaustedCount {};
+
+        std::mutex _mutex;
+        std::vector<int64_t> _samples;
+        std::vector<int64_t> _sortBuffer;
+        size_t _nextSampleIndex {};
+        size_t _samplesSinceUpdate {};
+    };
+}
@@ -0,0 +1,365 @@
+#pragma once
+
+#include <grpcpp/support/status.h>
+
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <stdexcept>
+
+namespace ShuHai::gRPC::Client
+{
+    /**
+     * \brief Limits the number of unary calls a client has in flight, see AsyncClientOptions::concurrencyLimit. Calls
+     *  beyond the limit wait in a bounded local queue and start once earlier calls finish, calls beyond the queue fail
+     *  at once with grpc::StatusCode::RESOURCE_EXHAUSTED. The limit adapts to the servers in AIMD style: it grows by
+     *  one per round trip of calls while the latency stays near the lowest latency observed recently, and shrinks by
+     *  AsyncCallLimiter::Options::backoffRatio once the latency grows beyond the tolerance or calls get dropped by
+     *  overloaded servers. A struggling server thus gets fewer calls, and the memory the client holds for pending calls
+     *  stays bounded.
+     */
+    class AsyncCallLimiter
+    {
+    public:
+        struct Options
+        {
+            /**
+             * \brief The limit before any call completes.
+             */
+            size_t initialLimit = 20;
+
+            /**
+             * \brief Lower bound of the limit.
+             */
+            size_t minLimit = 1;
+
+            /**
+             * \brief Upper bound of the limit.
+             */
+            size_t maxLimit = 1000;
+
+            /**
+             * \brief Maximum number of calls waiting for the limit, calls beyond it fail at once.
+             */
+            size_t maxQueueSize = 1000;
+
+            /**
+             * \brief The servers are taken as overloaded once the smoothed latency exceeds the lowest latency of recent
+             *  calls by this ratio.
+             */
+            double latencyTolerance = 2;
+
+            /**
+             * \brief Weight of the latest sample in the exponentially weighted moving average of the latency, in range
+             *  (0, 1].
+             */
+            double latencySmoothing = 0.1;
+
+            /**
+             * \brief Number of samples per window that the lowest latency is taken from. The lowest latency is taken
+             *  from the current and the previous window, thus it follows a lasting change of the latency, e.g. servers
+             *  of another region, within two windows.
+             */
+            size_t baselineWindow = 1000;
+
+            /**
+             * \brief Ratio the limit is multiplied with on overload, in range (0, 1).
+             */
+            double backoffRatio = 0.9;
+        };
+
+        using Clock = std::chrono::steady_clock;
+
+        /**
+         * \brief Starts a call, returns false if the call is not started, e.g. its deadline passed while queued.
+         */
+        using Starter = std::function<bool()>;
+
+        /**
+         * \brief Fails a call that is not started with the specified status. It is invoked on the thread that rejects
+         *  the call, e.g. the one calling acquire(), thus it should hand the failure over rather than complete the call
+         *  inline.
+         */
+        using Rejecter = std::function<void(const grpc::Status&)>;
+
+        /**
+         * \brief Identifies a queued call, see acquire() and expire().
+         */
+        using Ticket = uint64_t;
+
+        AsyncCallLimiter()
+            : AsyncCallLimiter(Options())
+        { }
+
+        explicit AsyncCallLimiter(const Options& options)
+            : _options(options)
+            , _limit(static_cast<double>(options.initialLimit))
+        {
+            if (options.minLimit == 0)
+                throw std::invalid_argument("Concurrency limit must be greater than zero.");
+            if (options.minLimit > options.maxLimit
+                || options.initialLimit < options.minLimit || options.initialLimit > options.maxLimit)
+                throw std::invalid_argument("Initial concurrency limit must be in range [minLimit, maxLimit].");
+            if (!(options.latencyTolerance > 1))
+                throw std::invalid_argument("Latency tolerance must be greater than 1.");
+            if (!(options.latencySmoothing > 0 && options.latencySmoothing <= 1))
+                throw std::invalid_argument("Latency smoothing must be in range (0, 1].");
+            if (options.baselineWindow == 0)
+                throw std::invalid_argument("Baseline window must be greater than zero.");
+            if (!(options.backoffRatio > 0 && options.backoffRatio < 1))
+                throw std::invalid_argument("Backoff ratio must be in range (0, 1).");
+        }
+
+        AsyncCallLimiter(const AsyncCallLimiter&) = delete;
+        AsyncCallLimiter& operator=(const AsyncCallLimiter&) = delete;
+
+        [[nodiscard]] const Options& options() const { return _options; }
+
+        /**
+         * \brief Current number of calls allowed in flight.
+         */
+        [[nodiscard]] size_t limit() const
+        {
+            std::lock_guard l(_mutex);
+            return currentLimit();
+        }
+
+        /**
+         * \brief Number of calls in flight.
+         */
+        [[nodiscard]] size_t inFlightCount() const
+        {
+            std::lock_guard l(_mutex);
+            return _inFlightCount;
+        }
+
+        /**
+         * \brief Number of calls waiting for the limit.
+         */
+        [[nodiscard]] size_t queuedCount() const
+        {
+            std::lock_guard l(_mutex);
+            return _queue.size();
+        }
+
+        /**
+         * \brief Number of calls failed at once since the queue was full.
+         */
+        [[nodiscard]] uint64_t rejectedCount() const
+        {
+            std::lock_guard l(_mutex);
+            return _rejectedCount;
+        }
+
+        /**
+         * \brief Start a call by the specified \p starter if the limit allows, queue it otherwise. The call is failed
+         *  by the specified \p rejecter if the queue is full or the limiter is closed. Each started call is expected to
+         *  be released by release() once it finishes.
+         * \return The ticket of the call if it is queued, the call may have left the queue already by the time it
+         *  returns.
+         */
+        std::optional<Ticket> acquire(Starter starter, Rejecter rejecter)
+        {
+            std::optional<Ticket> ticket;
+            {
+                std::unique_lock l(_mutex);
+                if (_closed)
+                {
+                    l.unlock();
+                    rejecter(grpc::Status(grpc::StatusCode::CANCELLED, "The call limiter is closed."));
+                    return std::nullopt;
+                }
+
+                if (_inFlightCount >= currentLimit() || !_queue.empty())
+                {
+                    if (_queue.size() >= _options.maxQueueSize)
+                    {
+                        ++_rejectedCount;
+                        l.unlock();
+                        rejecter(grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Too many calls in flight."));
+                        return std::nullopt;
+                    }
+                    ticket = ++_lastTicket;
+                    _queue.push_back({ *ticket, std::move(starter), std::move(rejecter) });
+                }
+                else
+                {
+                    ++_inFlightCount;
+                }
+            }
+
+            // Calls queued ahead of current one go first, the limit may have grown meanwhile.
+            if (ticket)
+                startQueued();
+            else if (!starter())
+                release();
+            return ticket;
+        }
+
+        /**
+         * \brief Fail the queued call of the specified \p ticket with grpc::StatusCode::DEADLINE_EXCEEDED, e.g. once
+         *  its deadline passes while it waits for the limit.
+         * \return false if the call is no longer queued.
+         */
+        bool expire(Ticket ticket)
+        {
+            Pending pending;
+            {
+                std::lock_guard l(_mutex);
+                // Tickets grow along the queue.
+                auto it = std::lower_bound(_queue.begin(), _queue.end(), ticket,
+                    [](const Pending& p, Ticket t) { return p.ticket < t; });
+                if (it == _queue.end() || it->ticket != ticket)
+                    return false;
+                pending = std::move(*it);
+                _queue.erase(it);
+            }
+
+            pending.rejecter(grpc::Status(grpc::StatusCode::DEADLINE_EXCEEDED, "Deadline exceeded in queue."));
+            return true;
+        }
+
+        /**
+         * \brief Release a call started at the specified \p startTime that finished with the specified \p status,
+         *  which adapts the limit and starts the queued calls the limit allows.
+         */
+        void release(Clock::time_point startTime, const grpc::Status& status)
+        {
+            auto now = Clock::now();
+            {
+                std::lock_guard l(_mutex);
+                if (isDrop(status.error_code()))
+                    backoff(startTime, now);
+                else if (status.ok())
+                    addSample(startTime, now);
+                --_inFlightCount;
+            }
+            startQueued();
+        }
+
+        /**
+         * \brief Fail all queued calls and the ones to come, e.g. once the client is about to shut down.
+         */
+        void close()
+        {
+            std::deque<Pending> queue;
+            {
+                std::lock_guard l(_mutex);
+                _closed = true;
+                queue.swap(_queue);
+            }
+
+            grpc::Status status(grpc::StatusCode::CANCELLED, "The call limiter is closed.");
+            for (auto& pending : queue)
+                pending.rejecter(status);
+        }
+
+    private:
+        struct Pending
+        {
+            Ticket ticket {};
+            Starter starter;
+            Rejecter rejecter;
+        };
+
+        // Codes that servers and transports use to shed load, rather than errors of the calls.
+        static bool isDrop(grpc::StatusCode code)
+        {
+            return code == grpc::StatusCode::RESOURCE_EXHAUSTED || code == grpc::StatusCode::UNAVAILABLE
+                || code == grpc::StatusCode::DEADLINE_EXCEEDED;
+        }
+
+        // Release a call that is not started.
+        void release()
+        {
+            {
+                std::lock_guard l(_mutex);
+                --_inFlightCount;
+            }
+            startQueued();
+        }
+
+        void startQueued()
+        {
+            while (true)
+            {
+                Pending pending;
+                {
+                    std::lock_guard l(_mutex);
+                    if (_closed || _queue.empty() || _inFlightCount >= currentLimit())
+                        return;
+                    pending = std::move(_queue.front());
+                    _queue.pop_front();
+                    ++_inFlightCount;
+                }
+
+                if (!pending.starter())
+                {
+                    std::lock_guard l(_mutex);
+                    --_inFlightCount;
+                }
+            }
+        }
+
+        // Must be called with _mutex locked.
+        [[nodiscard]] size_t currentLimit() const { return static_cast<size_t>(_limit); }
+
+        // Must be called with _mutex locked.
+        void addSample(Clock::time_point startTime, Clock::time_point now)
+        {
+            auto latency = std::chrono::duration<double, std::nano>(now - startTime).count();
+
+            _windowMinLatency = std::min(_windowMinLatency, latency);
+            if (++_windowSampleCount >= _options.baselineWindow)
+            {
+                _previousWindowMinLatency = _windowMinLatency;
+                _windowMinLatency = std::numeric_limits<double>::infinity();
+                _windowSampleCount = 0;
+            }
+            auto baseline = std::min(_windowMinLatency, _previousWindowMinLatency);
+
+            _latency = _latency > 0 ? _latency + (latency - _latency) * _options.latencySmoothing : latency;
+            if (_latency > baseline * _options.latencyTolerance)
+            {
+                backoff(startTime, now);
+                return;
+            }
+
+            // The limit grows only while it is in use, otherwise an idle client would end up with the maximum limit.
+            if (static_cast<double>(_inFlightCount) * 2 >= _limit)
+                _limit = std::min(_limit + 1 / _limit, static_cast<double>(_options.maxLimit));
+        }
+
+        // Must be called with _mutex locked.
+        void backoff(Clock::time_point startTime, Clock::time_point now)
+        {
+            // The calls started before the latest backoff saw the previous limit, backing off for each of them would
+            // collapse the limit on a single burst.
+            if (startTime < _lastBackoffTime)
+                return;
+            _lastBackoffTime = now;
+            _limit = std::max(_limit * _options.backoffRatio, static_cast<double>(_options.minLimit));
+        }
+
+        const Options _options;
+
+        mutable std::mutex _mutex;
+        double _limit;
+        size_t _inFlightCount {};
+        std::deque<Pending> _queue;
+        Ticket _lastTicket {};
+        bool _closed {};
+        uint64_t _rejectedCount {};
+
+        double _latency {};
+        double _windowMinLatency = std::numeric_limits<double>::infinity();
+        double _previousWindowMinLatency = std::numeric_limits<double>::infinity();
+        size_t _windowSampleCount {};
+        Clock::time_point _lastBackoffTime {};
+    };
+}
@@ -2,13 +2,27 @@
 
 #include "ShuHai/gRPC/Client/AsyncUnaryCall.h"
 #include "ShuHai/gRPC/Client/AsyncClientStreamCall.h"
+#include "ShuHai/gRPC/Client/AsyncServerStreamCall.h"
+#include "ShuHai/gRPC/Client/AsyncBidiStreamCall.h"
+#include "ShuHai/gRPC/Client/AsyncHedgedUnaryCall.h"
+#include "ShuHai/gRPC/Client/AsyncClientOptions.h"
 #include "ShuHai/gRPC/AsyncActionQueue.h"
+#include "ShuHai/gRPC/AsyncActionQueuePoller.h"
+#include "ShuHai/gRPC/CustomAsyncAction.h"
+#include "ShuHai/gRPC/ServerLoad.h"
+#include "ShuHai/gRPC/ThreadAffinity.h"
 
 #include <grpcpp/grpcpp.h>
 
 #include <thread>
 #include <future>
+#include <atomic>
 #include <unordered_set>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <optional>
+#include <chrono>
 #include <tuple>
 
 namespace ShuHai::gRPC::Client
@@ -19,17 +33,42 @@ namespace ShuHai::gRPC::Client
     public:
         explicit AsyncClient(const std::string& targetEndpoint,
             std::shared_ptr<grpc::ChannelCredentials> credentials = grpc::InsecureChannelCredentials(),
-            const grpc::ChannelArguments& channelArguments = {})
+            const grpc::ChannelArguments& channelArguments = {}, const AsyncClientOptions& options = {})
+            : AsyncClient(std::vector<std::string> { targetEndpoint }, std::move(credentials), channelArguments,
+                options)
+        { }
+
+        /**
+         * \brief Create a client that balances its calls among the specified \p targetEndpoints on its own, each of
+         *  them gets AsyncClientOptions::channelCount channels, and each call picks one of the channels as specified by
+         *  AsyncClientOptions::channelSelection.
+         */
+        AsyncClient(const std::vector<std::string>& targetEndpoints,
+            const std::shared_ptr<grpc::ChannelCredentials>& credentials = grpc::InsecureChannelCredentials(),
+            const grpc::ChannelArguments& channelArguments = {}, const AsyncClientOptions& options = {})
+            : _channelSelection(options.channelSelection)
+            , _latencyEwmaWeight(options.latencyEwmaWeight)
         {
-            _channel = grpc::CreateCustomChannel(targetEndpoint, credentials, channelArguments);
-            initStubs();
-            initAsyncActionQueue();
-        }
+            if (options.concurrencyLimit)
+                _callLimiter = std::make_unique<AsyncCallLimiter>(*options.concurrencyLimit);
 
-        ~AsyncClient() { deinitAsyncActionQueue(); }
+            if (targetEndpoints.empty())
+                throw std::invalid_argument("At least one target endpoint is required.");
+            if (!(_latencyEwmaWeight > 0 && _latencyEwmaWeight <= 1))
+                throw std::invalid_argument("Weight of latency samples must be in range (0, 1].");
 
-    private:
-        std::shared_ptr<grpc::Channel> _channel;
+            for (const auto& endpoint : targetEndpoints)
+                initChannels(endpoint, credentials, channelArguments, options.channelCount);
+            initAsyncActionQueues(options);
+        }
+
+        ~AsyncClient()
+        {
+            if (_callLimiter)
+                _callLimiter->close();
+            closeHedgedCalls();
+            deinitAsyncActionQueues();
+        }
 
 
         // Calls -------------------------------------------------------------------------------------------------------
@@ -46,7 +85,7 @@ namespace ShuHai::gRPC::Client
             CallFunc asyncCall, const RequestTypeOf<CallFunc>& request,
             std::unique_ptr<grpc::ClientContext> context = nullptr)
         {
-            return call(asyncCall, request, nullptr, nullptr, std::move(context));
+            return callOn(nextQueue(), asyncCall, request, nullptr, nullptr, std::move(context));
         }
 
         /**
@@ -64,32 +103,306 @@ namespace ShuHai::gRPC::Client
         EnableIfRpcTypeMatch<CallFunc, RpcType::UnaryCall, std::shared_ptr<AsyncUnaryCall<CallFunc>>> call(
             CallFunc asyncCall, const RequestTypeOf<CallFunc>& request,
             typename AsyncUnaryCall<CallFunc>::ResponseCallback callback,
-            asio::execution_context* callbackExecutionContext = nullptr,
+            Executor callbackExecutionContext = nullptr,
+            std::unique_ptr<grpc::ClientContext> context = nullptr)
+        {
+            return callOn(nextQueue(), asyncCall, request, std::move(callback), callbackExecutionContext,
+                std::move(context));
+        }
+
+        template<typename CallFunc>
+        EnableIfRpcTypeMatch<CallFunc, RpcType::ClientStream, std::shared_ptr<AsyncClientStreamCall<CallFunc>>> call(
+            CallFunc asyncCall, std::unique_ptr<grpc::ClientContext> context = nullptr)
+        {
+            return callOn(nextQueue(), asyncCall, std::move(context));
+        }
+
+        /**
+         * \brief Starts certain server streaming rpc via the specified generated function Stub::Async<RpcName>.
+         *  Messages from the server are read by the stream reader of the returned call instance.
+         * \param asyncCall The function address of Stub::Async<RpcName> which need to be executed.
+         * \param request The rpc parameter.
+         * \param context The gRPC context for the call.
+         * \return The call instance.
+         */
+        template<typename CallFunc>
+        EnableIfRpcTypeMatch<CallFunc, RpcType::ServerStream, std::shared_ptr<AsyncServerStreamCall<CallFunc>>> call(
+            CallFunc asyncCall, const RequestTypeOf<CallFunc>& request,
             std::unique_ptr<grpc::ClientContext> context = nullptr)
+        {
+            return callOn(nextQueue(), asyncCall, request, std::move(context));
+        }
+
+        /**
+         * \brief Starts certain bidirectional streaming rpc via the specified generated function Stub::Async<RpcName>.
+         *  Messages are written and read by the stream writer and the stream reader of the returned call instance.
+         * \param asyncCall The function address of Stub::Async<RpcName> which need to be executed.
+         * \param context The gRPC context for the call.
+         * \return The call instance.
+         */
+        template<typename CallFunc>
+        EnableIfRpcTypeMatch<CallFunc, RpcType::BidiStream, std::shared_ptr<AsyncBidiStreamCall<CallFunc>>> call(
+            CallFunc asyncCall, std::unique_ptr<grpc::ClientContext> context = nullptr)
+        {
+            return callOn(nextQueue(), asyncCall, std::move(context));
+        }
+
+        /**
+         * \brief Same as call(), except that the call is handled by the completion queue selected by the specified
+         *  \p queueKey rather than the next one in turn. Calls of the same key are handled by the same completion queue
+         *  and its threads, e.g. to keep the calls of a session together.
+         * \param queueKey Key of the call, the completion queue of index \p queueKey modulo completionQueueCount() is
+         *  selected.
+         * \param asyncCall The function address of Stub::Async<RpcName> which need to be executed.
+         * \param args Arguments of the call, same as the ones of the corresponding call() overload.
+         * \return The call instance.
+         */
+        template<typename CallFunc, typename... Args>
+        auto callByKey(size_t queueKey, CallFunc asyncCall, Args&&... args)
+        {
+            return callOn(*_asyncActionQueues[queueKey % _asyncActionQueues.size()], asyncCall,
+                std::forward<Args>(args)...);
+        }
+
+        /**
+         * \brief Executes certain idempotent unary rpc that is sent again if it gets no response in time, see
+         *  AsyncCallHedger. Each attempt goes to a channel other than the ones of the previous attempts if the client
+         *  has more than one channel, e.g. another endpoint of a multi-endpoint client.
+         * \param hedger The hedging policy of the rpc, which is expected to be shared by all calls of the rpc.
+         * \param asyncCall The function address of Stub::Async<RpcName> which need to be executed.
+         * \param request The rpc parameter.
+         * \param callback The callback function for rpc result notification.
+         * \param callbackExecutionContext The execution context that execute the specified callback function, the
+         *  callback is called on the completion queue thread if null.
+         * \param contextFactory Makes the gRPC context of each attempt, e.g. to set the deadline or the metadata of
+         *  the call, since a context is not allowed to be shared by attempts. Default contexts are used if null.
+         * \return The call instance.
+         */
+        template<typename CallFunc>
+        EnableIfRpcTypeMatch<CallFunc, RpcType::UnaryCall, std::shared_ptr<AsyncHedgedUnaryCall<CallFunc>>>
+        callHedged(std::shared_ptr<AsyncCallHedger> hedger, CallFunc asyncCall, const RequestTypeOf<CallFunc>& request,
+            typename AsyncHedgedUnaryCall<CallFunc>::ResponseCallback callback = nullptr,
+            Executor callbackExecutionContext = nullptr,
+            std::function<std::unique_ptr<grpc::ClientContext>()> contextFactory = nullptr)
+        {
+            using Call = AsyncHedgedUnaryCall<CallFunc>;
+            if (!hedger)
+                throw std::invalid_argument("Null hedger.");
+
+            auto& queue = nextQueue();
+            auto usedChannels = std::make_shared<std::vector<const Channel*>>();
+            auto starter = [this, &queue, asyncCall, request, contextFactory = std::move(contextFactory),
+                               usedChannels](typename Call::ResponseCallback cb)
+            {
+                auto& channel = selectChannelExcept(*usedChannels);
+                usedChannels->emplace_back(&channel);
+                return callOnChannel(queue, channel, asyncCall, request, std::move(cb), nullptr,
+                    contextFactory ? contextFactory() : nullptr);
+            };
+
+            auto call = std::make_shared<Call>(std::move(hedger), &queue, std::move(starter), std::move(callback),
+                callbackExecutionContext, [this](std::shared_ptr<Call> c) { removeHedgedCall(c); });
+            addHedgedCall(call);
+            call->start();
+            return call;
+        }
+
+    private:
+        using HedgedCallPtr = std::shared_ptr<AsyncHedgedCall>;
+
+        void addHedgedCall(HedgedCallPtr call)
+        {
+            std::lock_guard l(_hedgedCallsMutex);
+            _hedgedCalls.emplace(std::move(call));
+        }
+
+        void removeHedgedCall(const HedgedCallPtr& call)
+        {
+            std::lock_guard l(_hedgedCallsMutex);
+            _hedgedCalls.erase(call);
+        }
+
+        // Hedge timers armed on the completion queues would hold the shutdown until they expire and start attempts on
+        // the queues shut down, thus they are cancelled ahead.
+        void closeHedgedCalls()
+        {
+            std::unordered_set<HedgedCallPtr> calls;
+            {
+                std::lock_guard l(_hedgedCallsMutex);
+                calls = _hedgedCalls;
+            }
+            for (auto& call : calls)
+                call->close();
+        }
+
+        std::mutex _hedgedCallsMutex;
+        std::unordered_set<HedgedCallPtr> _hedgedCalls;
+
+    private:
+        struct Channel;
+
+        template<typename CallFunc>
+        EnableIfRpcTypeMatch<CallFunc, RpcType::UnaryCall, std::shared_ptr<AsyncUnaryCall<CallFunc>>> callOn(
+            AsyncActionQueue& queue, CallFunc asyncCall, const RequestTypeOf<CallFunc>& request,
+            std::unique_ptr<grpc::ClientContext> context = nullptr)
+        {
+            return callOn(queue, asyncCall, request, nullptr, nullptr, std::move(context));
+        }
+
+        template<typename CallFunc>
+        EnableIfRpcTypeMatch<CallFunc, RpcType::UnaryCall, std::shared_ptr<AsyncUnaryCall<CallFunc>>> callOn(
+            AsyncActionQueue& queue, CallFunc asyncCall, const RequestTypeOf<CallFunc>& request,
+            typename AsyncUnaryCall<CallFunc>::ResponseCallback callback,
+            Executor callbackExecutionContext = nullptr,
+            std::unique_ptr<grpc::ClientContext> context = nullptr)
+        {
+            return callOnChannel(queue, selectChannel(), asyncCall, request, std::move(callback),
+                callbackExecutionContext, std::move(context));
+        }
+
+        template<typename CallFunc>
+        std::shared_ptr<AsyncUnaryCall<CallFunc>> callOnChannel(AsyncActionQueue& queue, Channel& channel,
+            CallFunc asyncCall, const RequestTypeOf<CallFunc>& request,
+            typename AsyncUnaryCall<CallFunc>::ResponseCallback callback, Executor callbackExecutionContext,
+            std::unique_ptr<grpc::ClientContext> context)
         {
             using Call = AsyncUnaryCall<CallFunc>;
-            auto call = std::make_shared<Call>(stub<typename Call::Stub>(), asyncCall, request,
-                _asyncActionQueue->completionQueue(), std::move(context), std::move(callback), callbackExecutionContext,
-                [this](std::shared_ptr<Call> c) { onCallDead(c); });
+            auto call = std::make_shared<Call>(stubOf<typename Call::Stub>(channel), asyncCall, &queue,
+                std::move(context), std::move(callback), callbackExecutionContext,
+                [this, &channel](std::shared_ptr<Call> c)
+                {
+                    // Calls failed before being sent tell nothing about the channel, nor are they charged to it.
+                    if (!c->_startTime)
+                    {
+                        removeStreamingCall(c);
+                        return;
+                    }
+
+                    // Neither do cancelled calls, e.g. the losing attempts of hedged calls, which would otherwise be
+                    // taken as failures of the channel.
+                    if (c->status().error_code() != grpc::StatusCode::CANCELLED)
+                    {
+                        channel.addLatencySample(std::chrono::steady_clock::now() - *c->_startTime,
+                            c->status().ok(), _latencyEwmaWeight);
+                    }
+                    onCallDead(c, channel);
+                    if (_callLimiter)
+                        _callLimiter->release(*c->_startTime, c->status());
+                });
             addStreamingCall(call);
+
+            if (!_callLimiter)
+            {
+                startCall(*call, channel, request);
+                return call;
+            }
+
+            // The request is copied since the call may wait in the queue of the limiter.
+            auto deadline = call->context().deadline();
+            std::shared_ptr<QueuedCallDeadline> queuedDeadline;
+            if (deadline != std::chrono::system_clock::time_point::max())
+                queuedDeadline = std::make_shared<QueuedCallDeadline>(_callLimiter.get());
+            auto ticket = _callLimiter->acquire(
+                [&queue, &channel, call, request, queuedDeadline]()
+                {
+                    if (queuedDeadline)
+                        queuedDeadline->disarm();
+                    if (call->context().deadline() <= std::chrono::system_clock::now())
+                    {
+                        rejectCall(queue, call,
+                            grpc::Status(grpc::StatusCode::DEADLINE_EXCEEDED, "Deadline exceeded in queue."));
+                        return false;
+                    }
+                    return startCall(*call, channel, request);
+                },
+                [&queue, call, queuedDeadline](const grpc::Status& status)
+                {
+                    if (queuedDeadline)
+                        queuedDeadline->disarm();
+                    rejectCall(queue, call, status);
+                });
+            if (ticket && queuedDeadline)
+                queuedDeadline->arm(queue, *ticket, deadline);
             return call;
         }
 
+        // The channel is charged once the call is sent rather than once it is made, the calls waiting for the limiter
+        // are not outstanding on any channel.
+        template<typename Call>
+        static bool startCall(Call& call, Channel& channel, const typename Call::Request& request)
+        {
+            channel.outstandingCallCount.fetch_add(1, std::memory_order_relaxed);
+            if (call.start(request))
+                return true;
+            channel.outstandingCallCount.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+
         template<typename CallFunc>
-        EnableIfRpcTypeMatch<CallFunc, RpcType::ClientStream, std::shared_ptr<AsyncClientStreamCall<CallFunc>>> call(
-            CallFunc asyncCall, std::unique_ptr<grpc::ClientContext> context = nullptr)
+        EnableIfRpcTypeMatch<CallFunc, RpcType::ClientStream, std::shared_ptr<AsyncClientStreamCall<CallFunc>>> callOn(
+            AsyncActionQueue& queue, CallFunc asyncCall, std::unique_ptr<grpc::ClientContext> context = nullptr)
         {
             using Call = AsyncClientStreamCall<CallFunc>;
-            auto call = std::make_shared<Call>(
-                stub<typename Call::Stub>(), asyncCall, std::move(context), _asyncActionQueue->completionQueue());
-            addStreamingCall(call);
+            auto& channel = selectChannel();
+            auto call = std::make_shared<Call>(stubOf<typename Call::Stub>(channel), asyncCall, std::move(context),
+                &queue, [this, &channel](std::shared_ptr<Call> c) { onCallDead(c, channel); });
+            addCall(call, channel);
+            call->start();
+            return call;
+        }
+
+        template<typename CallFunc>
+        EnableIfRpcTypeMatch<CallFunc, RpcType::ServerStream, std::shared_ptr<AsyncServerStreamCall<CallFunc>>> callOn(
+            AsyncActionQueue& queue, CallFunc asyncCall, const RequestTypeOf<CallFunc>& request,
+            std::unique_ptr<grpc::ClientContext> context = nullptr)
+        {
+            using Call = AsyncServerStreamCall<CallFunc>;
+            auto& channel = selectChannel();
+            auto call = std::make_shared<Call>(stubOf<typename Call::Stub>(channel), asyncCall, request,
+                std::move(context), &queue, [this, &channel](std::shared_ptr<Call> c) { onCallDead(c, channel); });
+            addCall(call, channel);
+            call->start();
+            return call;
+        }
+
+        template<typename CallFunc>
+        EnableIfRpcTypeMatch<CallFunc, RpcType::BidiStream, std::shared_ptr<AsyncBidiStreamCall<CallFunc>>> callOn(
+            AsyncActionQueue& queue, CallFunc asyncCall, std::unique_ptr<grpc::ClientContext> context = nullptr)
+        {
+            using Call = AsyncBidiStreamCall<CallFunc>;
+            auto& channel = selectChannel();
+            auto call = std::make_shared<Call>(stubOf<typename Call::Stub>(channel), asyncCall, std::move(context),
+                &queue, [this, &channel](std::shared_ptr<Call> c) { onCallDead(c, channel); });
+            addCall(call, channel);
+            call->start();
             return call;
         }
 
     private:
         using CallPtr = std::shared_ptr<AsyncCall>;
 
-        void onCallDead(CallPtr call) { removeStreamingCall(call); }
+        void onCallDead(CallPtr call, Channel& channel)
+        {
+            if (_channelSelection == ChannelSelection::ServerLoad)
+            {
+                const auto& trailers = call->context().GetServerTrailingMetadata();
+                auto it = trailers.find(ServerLoad::MetadataKey);
+                if (it != trailers.end())
+                {
+                    if (auto load = ServerLoad::parse(it->second))
+                        channel.setServerLoad(*load);
+                }
+            }
+
+            channel.outstandingCallCount.fetch_sub(1, std::memory_order_relaxed);
+            removeStreamingCall(call);
+        }
+
+        void addCall(CallPtr call, Channel& channel)
+        {
+            channel.outstandingCallCount.fetch_add(1, std::memory_order_relaxed);
+            addStreamingCall(call);
+        }
 
         void addStreamingCall(CallPtr call)
         {
@@ -106,34 +419,169 @@ namespace ShuHai::gRPC::Client
         std::mutex _streamingCallsMutex;
         std::unordered_set<CallPtr> _streamingCalls;
 
-        // Action Queue ------------------------------------------------------------------------------------------------
+
+        // Concurrency Limit -------------------------------------------------------------------------------------------
+    public:
+        /**
+         * \brief The limiter of the unary calls in flight, null if the calls are not limited, see
+         *  AsyncClientOptions::concurrencyLimit.
+         */
+        [[nodiscard]] const AsyncCallLimiter* callLimiter() const { return _callLimiter.get(); }
+
     private:
-        void initAsyncActionQueue()
+        // Fails a call that the limiter never starts.
+        template<typename Call>
+        class CallRejectAction : public CustomAsyncAction
+        {
+        public:
+            CallRejectAction(std::shared_ptr<Call> call, grpc::Status status)
+                : _call(std::move(call))
+                , _status(std::move(status))
+            { }
+
+            void finalizeResult(bool) override { _call->fail(std::move(_status)); }
+
+        private:
+            const std::shared_ptr<Call> _call;
+            grpc::Status _status;
+        };
+
+        // Calls are rejected on their completion queues like calls failed by servers, rather than on the thread that
+        // happens to reject them, e.g. the one making the call, which may hold locks that the response callback takes.
+        template<typename Call>
+        static void rejectCall(AsyncActionQueue& queue, std::shared_ptr<Call> call, grpc::Status status)
         {
-            _asyncActionQueue = std::make_unique<AsyncActionQueue>(std::make_unique<grpc::CompletionQueue>());
+            auto action = std::make_unique<CallRejectAction<Call>>(call, status);
+            if (queue.tryStartOperation([&]() { action->trigger(queue.completionQueue()); }))
+                action.release();
+            else
+                call->fail(std::move(status));
+        }
+
+        // Fails a call waiting in the queue of the limiter once its deadline passes, rather than once the call reaches
+        // the head of the queue. The alarm is embedded, thus the instance keeps itself alive while the alarm is armed.
+        class QueuedCallDeadline
+            : public IAsyncAction
+            , public std::enable_shared_from_this<QueuedCallDeadline>
+        {
+        public:
+            explicit QueuedCallDeadline(AsyncCallLimiter* limiter)
+                : _limiter(limiter)
+            { }
+
+            void arm(AsyncActionQueue& queue, AsyncCallLimiter::Ticket ticket,
+                std::chrono::system_clock::time_point deadline)
+            {
+                std::lock_guard l(_mutex);
+                if (_disarmed)
+                    return;
+                _ticket = ticket;
+                _armed = queue.tryStartOperation(
+                    [&]() { _alarm.Set(queue.completionQueue(), deadline, AsyncActionQueue::embeddedTag(this)); });
+                if (_armed)
+                    _keepAlive = this->shared_from_this();
+            }
+
+            // The call left the queue, either started or failed.
+            void disarm()
+            {
+                std::lock_guard l(_mutex);
+                _disarmed = true;
+                if (_armed)
+                    _alarm.Cancel();
+            }
 
-            _asyncActionThread = std::thread(
-                [this]()
+            void finalizeResult(bool ok) override
+            {
+                std::shared_ptr<QueuedCallDeadline> keepAlive;
                 {
-                    while (_asyncActionQueue->asyncNext() != grpc::CompletionQueue::SHUTDOWN)
-                        continue;
-                });
+                    std::lock_guard l(_mutex);
+                    keepAlive = std::move(_keepAlive);
+                    _armed = false;
+                    if (!ok || _disarmed)
+                        return;
+                }
+                _limiter->expire(_ticket);
+            }
+
+        private:
+            AsyncCallLimiter* const _limiter;
+
+            std::mutex _mutex;
+            grpc::Alarm _alarm;
+            AsyncCallLimiter::Ticket _ticket {};
+            bool _armed {};
+            bool _disarmed {};
+            std::shared_ptr<QueuedCallDeadline> _keepAlive;
+        };
+
+        std::unique_ptr<AsyncCallLimiter> _callLimiter;
+
+        // Action Queue ------------------------------------------------------------------------------------------------
+    public:
+        /**
+         * \brief Number of completion queues of the client, each of them is polled by its own threads.
+         */
+        [[nodiscard]] size_t completionQueueCount() const { return _asyncActionQueues.size(); }
+
+        /**
+         * \brief Number of threads currently polling the completion queues, which changes with the load if
+         *  PollerOptions::maxThreadCount is set, see AsyncClientOptions::pollers.
+         */
+        [[nodiscard]] size_t pollerThreadCount() const
+        {
+            size_t count = 0;
+            for (const auto& poller : _asyncActionQueuePollers)
+                count += poller->threadCount();
+            return count;
         }
 
-        void deinitAsyncActionQueue()
+    private:
+        void initAsyncActionQueues(const AsyncClientOptions& options)
         {
-            _asyncActionQueue->shutdown();
+            if (options.pollers.threadCount == 0)
+                throw std::invalid_argument("At least one polling thread per completion queue is required.");
 
-            _asyncActionThread.join();
+            size_t queueCount = options.completionQueueCount;
+            if (queueCount == 0)
+                queueCount = std::max<size_t>(std::thread::hardware_concurrency(), 1);
 
-            _asyncActionQueue = nullptr;
+            for (size_t i = 0; i < queueCount; ++i)
+            {
+                _asyncActionQueues.emplace_back(invokeOnCpus(options.pollers.cpusOf(i),
+                    []() { return std::make_unique<AsyncActionQueue>(std::make_unique<grpc::CompletionQueue>()); }));
+            }
+            for (size_t i = 0; i < queueCount; ++i)
+            {
+                _asyncActionQueuePollers.emplace_back(
+                    std::make_unique<AsyncActionQueuePoller>(*_asyncActionQueues[i], options.pollers, i));
+            }
         }
 
-        std::unique_ptr<AsyncActionQueue> _asyncActionQueue;
-        std::thread _asyncActionThread;
+        void deinitAsyncActionQueues()
+        {
+            for (auto& q : _asyncActionQueues)
+                q->shutdown();
+
+            _asyncActionQueuePollers.clear();
+
+            _asyncActionQueues.clear();
+        }
+
+        AsyncActionQueue& nextQueue()
+        {
+            if (_asyncActionQueues.size() == 1)
+                return *_asyncActionQueues.front();
+            auto index = _nextQueueIndex.fetch_add(1, std::memory_order_relaxed);
+            return *_asyncActionQueues[index % _asyncActionQueues.size()];
+        }
 
+        std::vector<std::unique_ptr<AsyncActionQueue>> _asyncActionQueues;
+        std::vector<std::unique_ptr<AsyncActionQueuePoller>> _asyncActionQueuePollers;
+        std::atomic<size_t> _nextQueueIndex { 0 };
 
-        // Stubs -------------------------------------------------------------------------------------------------------
+
+        // Channels & Stubs --------------------------------------------------------------------------------------------
     public:
         using StubIndices = std::index_sequence_for<Stubs...>;
         static constexpr size_t StubCount = StubIndices::size();
@@ -145,10 +593,62 @@ namespace ShuHai::gRPC::Client
             return ((std::is_same_v<Stub, Stubs>) || ...);
         }
 
+        /**
+         * \brief The stub of the first channel.
+         */
         template<typename Stub>
         [[nodiscard]] Stub* stub() const
         {
-            return std::get<indexOfStub<Stub>()>(_stubs).get();
+            return stubOf<Stub>(*_channels.front());
+        }
+
+        /**
+         * \brief Number of channels of the client across all its target endpoints, see
+         *  AsyncClientOptions::channelCount.
+         */
+        [[nodiscard]] size_t channelCount() const { return _channels.size(); }
+
+        /**
+         * \brief Target endpoint of the channel of the specified \p channelIndex.
+         */
+        [[nodiscard]] const std::string& channelEndpoint(size_t channelIndex) const
+        {
+            return _channels.at(channelIndex)->endpoint;
+        }
+
+        /**
+         * \brief Number of calls in flight on the channel of the specified \p channelIndex.
+         */
+        [[nodiscard]] size_t outstandingCallCount(size_t channelIndex) const
+        {
+            return _channels.at(channelIndex)->outstandingCallCount.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief The load reported by the server of the channel of the specified \p channelIndex through the latest
+         *  finished call, empty if none is reported yet. Only tracked by ChannelSelection::ServerLoad.
+         */
+        [[nodiscard]] std::optional<ServerLoad> channelServerLoad(size_t channelIndex) const
+        {
+            const auto& channel = *_channels.at(channelIndex);
+            if (!channel.serverLoadReported.load(std::memory_order_acquire))
+                return std::nullopt;
+
+            ServerLoad load;
+            load.inFlightCallCount = channel.serverInFlightCallCount.load(std::memory_order_relaxed);
+            load.queueDepth = channel.serverQueueDepth.load(std::memory_order_relaxed);
+            load.cpuBusyRatio = channel.serverCpuBusyRatio.load(std::memory_order_relaxed);
+            return load;
+        }
+
+        /**
+         * \brief Exponentially weighted moving average of the latency of the unary calls made on the channel of the
+         *  specified \p channelIndex, zero until a call on the channel completes.
+         */
+        [[nodiscard]] std::chrono::nanoseconds channelLatency(size_t channelIndex) const
+        {
+            return std::chrono::nanoseconds(static_cast<int64_t>(
+                _channels.at(channelIndex)->latencyNanoseconds.load(std::memory_order_relaxed)));
         }
 
     private:
@@ -169,9 +669,164 @@ namespace ShuHai::gRPC::Client
                 return indexOfStubImpl<I + 1, Stub>();
         }
 
-        void initStubs() { _stubs = std::make_tuple(std::make_unique<Stubs>(_channel)...); }
-
         using StubTuple = std::tuple<std::unique_ptr<Stubs>...>;
-        StubTuple _stubs;
+
+        struct Channel
+        {
+            Channel(std::string e, std::shared_ptr<grpc::Channel> c)
+                : endpoint(std::move(e))
+                , channel(std::move(c))
+                , stubs(std::make_unique<Stubs>(channel)...)
+            { }
+
+            // Failed calls count no less than twice the current average, so that an endpoint failing fast does not
+            // attract more calls.
+            void addLatencySample(std::chrono::nanoseconds latency, bool succeeded, double weight)
+            {
+                auto sample = static_cast<double>(latency.count());
+                auto average = latencyNanoseconds.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    auto s = succeeded ? sample : std::max(sample, average * 2);
+                    auto updated = average > 0 ? average + (s - average) * weight : s;
+                    if (latencyNanoseconds.compare_exchange_weak(average, updated, std::memory_order_relaxed))
+                        break;
+                }
+            }
+
+            // Expected time for a new call to complete, the calls in flight are assumed to be served one by one.
+            [[nodiscard]] double cost() const
+            {
+                auto latency = latencyNanoseconds.load(std::memory_order_relaxed);
+                auto outstanding = outstandingCallCount.load(std::memory_order_relaxed);
+                return std::max(latency, 1.0) * static_cast<double>(outstanding + 1);
+            }
+
+            void setServerLoad(const ServerLoad& load)
+            {
+                serverInFlightCallCount.store(load.inFlightCallCount, std::memory_order_relaxed);
+                serverQueueDepth.store(load.queueDepth, std::memory_order_relaxed);
+                serverCpuBusyRatio.store(load.cpuBusyRatio, std::memory_order_relaxed);
+                serverLoadReported.store(true, std::memory_order_release);
+            }
+
+            // Servers fully busy still get a trickle of calls, so that their lower load gets reported once they cool
+            // down.
+            [[nodiscard]] double serverLoadCost() const
+            {
+                auto outstanding = outstandingCallCount.load(std::memory_order_relaxed);
+                auto queueDepth = serverQueueDepth.load(std::memory_order_relaxed);
+                auto idleRatio = 1 - serverCpuBusyRatio.load(std::memory_order_relaxed);
+                return static_cast<double>(outstanding + queueDepth + 1) / std::max(idleRatio, 0.05);
+            }
+
+            const std::string endpoint;
+            std::shared_ptr<grpc::Channel> channel;
+            StubTuple stubs;
+            std::atomic<size_t> outstandingCallCount { 0 };
+            std::atomic<double> latencyNanoseconds { 0 };
+
+            std::atomic_bool serverLoadReported { false };
+            std::atomic<uint64_t> serverInFlightCallCount { 0 };
+            std::atomic<uint64_t> serverQueueDepth { 0 };
+            std::atomic<double> serverCpuBusyRatio { 0 };
+        };
+
+        template<typename Stub>
+        static Stub* stubOf(const Channel& channel)
+        {
+            return std::get<indexOfStub<Stub>()>(channel.stubs).get();
+        }
+
+        void initChannels(const std::string& targetEndpoint,
+            const std::shared_ptr<grpc::ChannelCredentials>& credentials,
+            const grpc::ChannelArguments& channelArguments, size_t channelCount)
+        {
+            if (channelCount == 0)
+                throw std::invalid_argument("At least one channel is required.");
+
+            if (channelCount == 1)
+            {
+                _channels.emplace_back(std::make_unique<Channel>(
+                    targetEndpoint, grpc::CreateCustomChannel(targetEndpoint, credentials, channelArguments)));
+                return;
+            }
+
+            // Channels with identical arguments share their subchannels, thus their connections.
+            for (size_t i = 0; i < channelCount; ++i)
+            {
+                auto arguments = channelArguments;
+                arguments.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+                arguments.SetInt("shuhai.grpc.channel_index", static_cast<int>(i));
+                _channels.emplace_back(std::make_unique<Channel>(
+                    targetEndpoint, grpc::CreateCustomChannel(targetEndpoint, credentials, arguments)));
+            }
+        }
+
+        // Prefer the channels not yet used, the selected channel is replaced by the next unused one otherwise.
+        Channel& selectChannelExcept(const std::vector<const Channel*>& used)
+        {
+            auto& selected = selectChannel();
+            auto isUsed = [&used](const Channel& c) { return std::find(used.begin(), used.end(), &c) != used.end(); };
+            if (!isUsed(selected) || used.size() >= _channels.size())
+                return selected;
+
+            auto it = std::find_if(_channels.begin(), _channels.end(), [&](auto& c) { return c.get() == &selected; });
+            auto index = static_cast<size_t>(it - _channels.begin());
+            for (size_t i = 1; i < _channels.size(); ++i)
+            {
+                auto& channel = *_channels[(index + i) % _channels.size()];
+                if (!isUsed(channel))
+                    return channel;
+            }
+            return selected;
+        }
+
+        Channel& selectChannel()
+        {
+            if (_channels.size() == 1)
+                return *_channels.front();
+
+            auto start = _nextChannelIndex.fetch_add(1, std::memory_order_relaxed);
+            if (_channelSelection == ChannelSelection::RoundRobin)
+                return *_channels[start % _channels.size()];
+            if (_channelSelection == ChannelSelection::PowerOfTwoChoices)
+                return selectChannelOfTwo([](const Channel& c) { return c.cost(); });
+            if (_channelSelection == ChannelSelection::ServerLoad)
+                return selectChannelOfTwo([](const Channel& c) { return c.serverLoadCost(); });
+
+            // Scanning from a rotating start spreads the calls among the channels that tie.
+            Channel* selected = nullptr;
+            size_t selectedCount = 0;
+            for (size_t i = 0; i < _channels.size(); ++i)
+            {
+                auto& channel = *_channels[(start + i) % _channels.size()];
+                auto count = channel.outstandingCallCount.load(std::memory_order_relaxed);
+                if (!selected || count < selectedCount)
+                {
+                    selected = &channel;
+                    selectedCount = count;
+                }
+            }
+            return *selected;
+        }
+
+        // Pick two distinct channels at random and take the one of lower cost.
+        template<typename CostFunc>
+        Channel& selectChannelOfTwo(CostFunc cost)
+        {
+            thread_local std::minstd_rand engine(std::random_device {}());
+            auto count = _channels.size();
+            auto first = engine() % count;
+            auto second = (first + 1 + engine() % (count - 1)) % count;
+            auto& a = *_channels[first];
+            auto& b = *_channels[second];
+            return cost(a) <= cost(b) ? a : b;
+        }
+
+        const ChannelSelection _channelSelection;
+        const double _latencyEwmaWeight;
+        std::vector<std::unique_ptr<Channel>> _channels;
+        std::atomic<size_t> _nextChannelIndex { 0 };
     };
 }
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "ShuHai/gRPC/Client/AsyncCallLimiter.h"
+#include "ShuHai/gRPC/PollerOptions.h"
+
+#include <cstddef>
+#include <optional>
+
+namespace ShuHai::gRPC::Client
+{
+    /**
+     * \brief Ways to pick the channel of a call among the channels of a client.
+     */
+    enum class ChannelSelection
+    {
+        /**
+         * \brief Pick the channels in turn.
+         */
+        RoundRobin,
+
+        /**
+         * \brief Pick the channel with the fewest calls in flight, which keeps long streams and slow calls from piling
+         *  up on a single connection.
+         */
+        LeastOutstanding,
+
+        /**
+         * \brief Pick two channels at random and take the one expected to complete a new call sooner, that is the one
+         *  of lower EWMA latency of unary calls times the number of calls in flight plus one. Calls then prefer the
+         *  fastest endpoints of a multi-endpoint client while slow ones still get probed, see
+         *  AsyncClientOptions::latencyEwmaWeight.
+         */
+        PowerOfTwoChoices,
+
+        /**
+         * \brief Pick two channels at random and take the one whose server reported more room for a new call in the
+         *  trailing metadata of the latest finished call, that is the one of lower number of calls in flight on the
+         *  channel plus calls waiting on the server, divided by the idle ratio of the server. Servers report their load
+         *  if AsyncServerOptions::reportLoad is set, channels without a report are taken as idle.
+         */
+        ServerLoad
+    };
+
+    /**
+     * \brief Options of AsyncClient.
+     */
+    struct AsyncClientOptions
+    {
+        /**
+         * \brief Number of completion queues, each of them is polled by its own threads. Calls are spread across the
+         *  completion queues in turn, or by key, see AsyncClient::callByKey(). The number of hardware threads if zero.
+         */
+        size_t completionQueueCount = 1;
+
+        /**
+         * \brief Number and placement of the threads polling each completion queue.
+         */
+        PollerOptions pollers;
+
+        /**
+         * \brief Number of channels per target endpoint. Each channel has its own connection to the target, since the
+         *  channels are created with distinct channel arguments and local subchannel pools, thus a busy client is not
+         *  limited by the stream concurrency and the transport of a single connection.
+         */
+        size_t channelCount = 1;
+
+        /**
+         * \brief How each call picks its channel if there are more than one.
+         */
+        ChannelSelection channelSelection = ChannelSelection::RoundRobin;
+
+        /**
+         * \brief Weight of the latest sample in the exponentially weighted moving average of the latency of each
+         *  channel, in range (0, 1]. Higher weights follow latency changes faster while lower ones smooth out outliers.
+         */
+        double latencyEwmaWeight = 0.2;
+
+        /**
+         * \brief Limits the number of unary calls in flight across all channels of the client, which adapts to the
+         *  latency of the calls, see AsyncCallLimiter. Calls are not limited if empty. Calls failed by the limiter
+         *  complete on the completion queue of the call like any other call, thus the response callback never runs on
+         *  the thread making the call.
+         */
+        std::optional<AsyncCallLimiter::Options> concurrencyLimit;
+    };
+}
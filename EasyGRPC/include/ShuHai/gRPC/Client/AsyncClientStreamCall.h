@@ -2,11 +2,14 @@
 
 #include "ShuHai/gRPC/Client/AsyncClientStreamWriter.h"
 #include "ShuHai/gRPC/Client/AsyncCall.h"
+#include "ShuHai/gRPC/Client/AsyncCallError.h"
 #include "ShuHai/gRPC/Client/TypeTraits.h"
+#include "ShuHai/gRPC/SharedPromise.h"
 
 #include <future>
 #include <atomic>
 #include <memory>
+#include <mutex>
 
 namespace ShuHai::gRPC::Client
 {
@@ -21,16 +24,16 @@ namespace ShuHai::gRPC::Client
     public:
         SHUHAI_GRPC_CLIENT_EXPAND_AsyncCallTraits(CallFunc);
         using StreamWriter = AsyncClientStreamWriter<CallFunc>;
+        using DeadCallback = std::function<void(std::shared_ptr<AsyncClientStreamCall>)>;
 
-        AsyncClientStreamCall(
-            Stub* stub, CallFunc func, std::unique_ptr<grpc::ClientContext> context, grpc::CompletionQueue* cq)
+        AsyncClientStreamCall(Stub* stub, CallFunc func, std::unique_ptr<grpc::ClientContext> context,
+            gRPC::AsyncActionQueue* actionQueue, DeadCallback deadCallback)
             : AsyncCall(std::move(context))
-            , _streamWriterFuture(_streamWriterPromise.get_future())
-            , _responseFuture(_responsePromise.get_future())
-        {
-            _stream = (new CallAction(this))->perform(stub, func, this->_context.get(), &_response, cq);
-            _streamWriter = new StreamWriter(cq, *_stream, this->_status, [this]() { onStreamWriterFinish(); });
-        }
+            , _stub(stub)
+            , _func(func)
+            , _actionQueue(actionQueue)
+            , _deadCallback(std::move(deadCallback))
+        { }
 
         ~AsyncClientStreamCall() override
         {
@@ -38,11 +41,48 @@ namespace ShuHai::gRPC::Client
             _streamWriter = nullptr;
         }
 
-        [[nodiscard]] std::shared_future<StreamWriter*> streamWriter() { return _streamWriterFuture; }
+        [[nodiscard]] std::shared_future<StreamWriter*> streamWriter() { return _streamWriterPromise.future(); }
 
-        [[nodiscard]] std::shared_future<Response> response() const { return _responseFuture; }
+        /**
+         * \brief Same as streamWriter(), except that the future is passed to the specified \p callback once it is
+         *  ready, on the thread that makes it ready, or immediately if it is already ready.
+         */
+        void streamWriter(typename SharedPromise<StreamWriter*>::Callback callback)
+        {
+            _streamWriterPromise.then(std::move(callback));
+        }
+
+        /**
+         * \brief The response of the call, it is ready once the stream writer finished. AsyncCallError is thrown by
+         *  the future if the call finished with error.
+         */
+        [[nodiscard]] std::shared_future<Response> response() const { return _responsePromise.future(); }
+
+        /**
+         * \brief Same as response(), except that the future is passed to the specified \p callback once it is
+         *  ready, on the thread that makes it ready, or immediately if it is already ready.
+         */
+        void response(typename SharedPromise<Response>::Callback callback)
+        {
+            _responsePromise.then(std::move(callback));
+        }
 
     private:
+        template<typename... Stubs>
+        friend class AsyncClient;
+
+        // The call starts once it is owned by the client, since it may finish on another polling thread as soon as its
+        // stream is ready.
+        void start()
+        {
+            // The call may start before the stream writer is created.
+            std::lock_guard l(_startMutex);
+            auto cq = _actionQueue->completionQueue();
+            _stream = (new CallAction(this))->perform(_stub, _func, this->_context.get(), &_response, cq);
+            _streamWriter =
+                new StreamWriter(_actionQueue, *_stream, this->_status, [this]() { onStreamWriterFinish(); });
+        }
+
         class CallAction : public IAsyncAction
         {
         public:
@@ -56,24 +96,52 @@ namespace ShuHai::gRPC::Client
                 return (stub->*func)(context, response, cq, this);
             }
 
-            void finalizeResult(bool ok) override { _owner->markStreamWriterReady(); }
+            // The call may finish on another polling thread once its stream is ready, it is kept alive until the
+            // notification is done.
+            void finalizeResult(bool ok) override
+            {
+                auto owner = _owner->shared_from_this();
+                owner->markStreamWriterReady();
+            }
 
         private:
             AsyncClientStreamCall* const _owner;
         };
 
-        void markStreamWriterReady() { _streamWriterPromise.set_value(_streamWriter); }
+        void markStreamWriterReady()
+        {
+            StreamWriter* streamWriter;
+            {
+                std::lock_guard l(_startMutex);
+                streamWriter = _streamWriter;
+            }
+            _streamWriterPromise.setValue(streamWriter);
+        }
 
-        void onStreamWriterFinish() { _responsePromise.set_value(_response); }
+        void onStreamWriterFinish()
+        {
+            if (this->_status.ok())
+                _responsePromise.setValue(_response);
+            else
+                _responsePromise.setException(std::make_exception_ptr(AsyncCallError(this->_status)));
+
+            if (_deadCallback)
+                _deadCallback(this->shared_from_this());
+        }
 
+        Stub* const _stub;
+        const CallFunc _func;
+        gRPC::AsyncActionQueue* const _actionQueue;
+
+        std::mutex _startMutex;
         std::unique_ptr<StreamingInterface> _stream;
 
-        StreamWriter* _streamWriter;
-        std::promise<StreamWriter*> _streamWriterPromise;
-        std::shared_future<StreamWriter*> _streamWriterFuture;
+        StreamWriter* _streamWriter {};
+        SharedPromise<StreamWriter*> _streamWriterPromise;
 
         Response _response;
-        std::promise<Response> _responsePromise;
-        std::shared_future<Response> _responseFuture;
+        SharedPromise<Response> _responsePromise;
+
+        DeadCallback _deadCallback;
     };
 }
@@ -2,46 +2,52 @@
 
 #include "ShuHai/gRPC/Client/TypeTraits.h"
 #include "ShuHai/gRPC/AsyncAction.h"
+#include "ShuHai/gRPC/AsyncActionQueue.h"
 #include "ShuHai/gRPC/StreamingError.h"
 
 #include <queue>
+#include <vector>
+#include <utility>
 #include <future>
 #include <mutex>
 #include <type_traits>
+#include <cassert>
 
 namespace ShuHai::gRPC::Client
 {
-    namespace Internal
-    {
-        enum class AsyncClientStreamWriterState
-        {
-            Ready,
-            Processing,
-            Finished
-        };
-    }
-
     template<typename CallFunc>
     class AsyncClientStreamCall;
 
+    template<typename CallFunc>
+    class AsyncBidiStreamCall;
+
+    /**
+     * \brief Writes messages to the server side of a client streaming or bidirectional streaming call.
+     *  Actions are performed one by one in the order they are made, i.e. at most one write is in progress at the same
+     *  time.
+     */
     template<typename CallFunc>
     class AsyncClientStreamWriter
     {
     public:
         SHUHAI_GRPC_CLIENT_EXPAND_AsyncCallTraits(CallFunc);
+        static_assert(rpcTypeOf<CallFunc>() == RpcType::ClientStream || rpcTypeOf<CallFunc>() == RpcType::BidiStream);
+
+        using ResultCallback = AsyncAction<bool>::ResultCallback;
 
     private:
         friend class AsyncClientStreamCall<CallFunc>;
+        friend class AsyncBidiStreamCall<CallFunc>;
 
-        AsyncClientStreamWriter(grpc::CompletionQueue* cq, StreamingInterface& stream, grpc::Status& status,
+        AsyncClientStreamWriter(gRPC::AsyncActionQueue* actionQueue, StreamingInterface& stream, grpc::Status& status,
             std::function<void()> onFinished)
-            : _cq(cq)
+            : _actionQueue(actionQueue)
             , _stream(stream)
             , _status(status)
             , _onFinished(std::move(onFinished))
         { }
 
-        grpc::CompletionQueue* const _cq;
+        gRPC::AsyncActionQueue* const _actionQueue;
         StreamingInterface& _stream;
         grpc::Status& _status;
         std::function<void()> _onFinished;
@@ -57,52 +63,113 @@ namespace ShuHai::gRPC::Client
 		 */
         std::future<bool> write(Request message, grpc::WriteOptions options = {})
         {
-            auto okFuture = newAction<WriteAction>(this, std::move(message), options);
-            tryPerformAction();
-            return okFuture;
+            auto action = new WriteAction(this, std::move(message), options);
+            auto result = action->result();
+            enqueueWrite(action);
+            return result;
         }
 
+        /**
+         * \brief Same as write(), except that the future of the result is passed to the specified \p callback once it
+         *  is ready. The callback is called from the completion queue thread in most cases, it should return as soon as
+         *  possible.
+         */
+        void write(Request message, grpc::WriteOptions options, ResultCallback callback)
+        {
+            auto action = new WriteAction(this, std::move(message), options);
+            action->setResultCallback(std::move(callback));
+            enqueueWrite(action);
+        }
+
+        /**
+         * \brief Declare that there is no more message to write. For client streaming calls the call is finished after
+         *  the last message is written, for bidirectional streaming calls the server is notified by WritesDone and the
+         *  call is finished once all messages from the server are read.
+         */
         std::future<bool> finish()
         {
-            auto okFuture = newAction<FinishAction>(this);
-            tryPerformAction();
-            return okFuture;
+            auto action = new FinishAction(this);
+            auto result = action->result();
+            enqueueFinish(action);
+            return result;
+        }
+
+        /**
+         * \brief Same as finish(), except that the future of the result is passed to the specified \p callback once it
+         *  is ready. The callback is called from the completion queue thread in most cases, it should return as soon as
+         *  possible.
+         */
+        void finish(ResultCallback callback)
+        {
+            auto action = new FinishAction(this);
+            action->setResultCallback(std::move(callback));
+            enqueueFinish(action);
         }
 
     private:
-        using State = Internal::AsyncClientStreamWriterState;
+        class WriteAction;
+        class FinishAction;
 
-        class StreamAction : public AsyncAction<bool>
+        void enqueueWrite(WriteAction* action)
         {
-        public:
-            explicit StreamAction(AsyncClientStreamWriter* owner)
-                : _owner(owner)
-            { }
-
-            void perform()
+            std::unique_lock l(_actionsMutex);
+            if (_finishRequested)
+            {
+                l.unlock();
+                action->template setException<InvalidStreamingAction>("Attempt to write after finish.");
+                delete action;
+            }
+            else if (_lastMessageWritten)
+            {
+                l.unlock();
+                action->template setException<InvalidStreamingAction>(
+                    "Last already written, no more message is allowed.");
+                delete action;
+            }
+            else
             {
-                std::lock_guard slg(_owner->_stateMutex);
-                assert(_owner->_state == State::Ready);
-                _owner->_state = State::Processing;
-                performImpl();
+                _lastMessageWritten = action->options().is_last_message();
+                enqueueAction(action);
+                unlockAndNotify(l);
             }
+        }
 
-            void finalizeResult(bool ok) final
+        void enqueueFinish(FinishAction* action)
+        {
+            std::unique_lock l(_actionsMutex);
+            if (_finishRequested)
+            {
+                l.unlock();
+                action->template setException<InvalidStreamingAction>("Duplicate finish call.");
+                delete action;
+            }
+            else
             {
+                _finishRequested = true;
+                // The server is not aware of the end of the stream unless WritesDone is performed or the last message
+                // is written.
+                if constexpr (rpcTypeOf<CallFunc>() == RpcType::ClientStream)
                 {
-                    std::lock_guard slg(_owner->_stateMutex);
-                    assert(_owner->_state == State::Processing);
-                    setResult(ok);
-                    _owner->_state = State::Ready;
+                    if (!_lastMessageWritten)
+                        enqueueAction(new WritesDoneAction(this));
                 }
-                finalizeResultImpl(ok);
+                enqueueAction(action);
+                unlockAndNotify(l);
             }
+        }
 
-        protected:
-            virtual void performImpl() = 0;
+        class StreamAction : public AsyncAction<bool>
+        {
+        public:
+            explicit StreamAction(AsyncClientStreamWriter* owner)
+                : _owner(owner)
+            { }
 
-            virtual void finalizeResultImpl(bool ok) = 0;
+            virtual void perform() = 0;
 
+            void finalizeResult(bool ok) final { _owner->finalizeAction(this, ok); }
+
+        protected:
             AsyncClientStreamWriter* const _owner;
         };
 
@@ -119,16 +186,23 @@ namespace ShuHai::gRPC::Client
 
             [[nodiscard]] const grpc::WriteOptions& options() { return _options; }
 
-        protected:
-            void performImpl() override { this->_owner->_stream.Write(_message, _options, this); }
-
-            void finalizeResultImpl(bool ok) override { this->_owner->finalizeWrite(this, ok); }
+            void perform() override { this->_owner->_stream.Write(_message, _options, this); }
 
         private:
             Request _message;
             grpc::WriteOptions _options;
         };
 
+        class WritesDoneAction : public StreamAction
+        {
+        public:
+            explicit WritesDoneAction(AsyncClientStreamWriter* owner)
+                : StreamAction(owner)
+            { }
+
+            void perform() override { this->_owner->_stream.WritesDone(this); }
+        };
+
         class FinishAction : public StreamAction
         {
         public:
@@ -136,134 +210,122 @@ namespace ShuHai::gRPC::Client
                 : StreamAction(owner)
             { }
 
-        protected:
-            void performImpl() override { this->_owner->_stream.Finish(&this->_owner->_status, this); }
-
-            void finalizeResultImpl(bool ok) override { this->_owner->finalizeFinish(this, ok); }
+            void perform() override
+            {
+                if constexpr (rpcTypeOf<CallFunc>() == RpcType::BidiStream)
+                    this->_owner->_stream.WritesDone(this);
+                else
+                    this->_owner->_stream.Finish(&this->_owner->_status, this);
+            }
         };
 
-        bool tryPerformAction()
+        // Finish the writer unless the finish is already requested.
+        void finishIfNotRequested()
         {
-            // Ensure action pop and perform in the whole is exclusive because:
-            // 1. Only one action is allowed to perform at the same time.
-            // 2. Performing order of actions have to keep the same as it pushes.
-            std::lock_guard alg(_actionsMutex);
+            std::unique_lock l(_actionsMutex);
+            if (_finishRequested)
+                return;
 
-            if (_actions.empty())
-                return false;
+            _finishRequested = true;
+            enqueueAction(new FinishAction(this));
+            unlockAndNotify(l);
+        }
 
-            auto action = popAction();
-            return tryPerformAction(action);
+        // Must be called with _actionsMutex locked.
+        void enqueueAction(StreamAction* action)
+        {
+            // Only one action is allowed to perform at the same time, and the performing order have to keep the same as
+            // it pushes.
+            _actions.emplace(action);
+            if (!_performing)
+                performNextAction();
         }
 
-        bool tryPerformAction(StreamAction* action)
+        // Must be called with _actionsMutex locked.
+        void performNextAction()
         {
-            switch (_state)
+            while (!_actions.empty())
             {
-            case State::Ready:
-                action->perform();
-                return true;
-            case State::Finished:
-                action->template setException<InvalidStreamingAction>(
-                    "The stream is finished, no more action is allowed.");
-                return false;
-            case State::Processing:
-                // Process in finalizeXxx function.
-                return false;
-            default:
-                assert("Invalid state.");
-                return false;
+                auto action = _actions.front();
+                _actions.pop();
+
+                bool isFinish = dynamic_cast<FinishAction*>(action);
+                if (!(_broken && !isFinish) && _actionQueue->tryStartOperation([action]() { action->perform(); }))
+                {
+                    _performing = true;
+                    return;
+                }
+
+                // The call is already dead or the queue is shut down, nothing is going to the wire.
+                if (isFinish)
+                    _finished = true;
+                _droppedActions.emplace_back(action);
             }
         }
 
-        void finalizeWrite(WriteAction* action, bool ok)
+        void finalizeAction(StreamAction* action, bool ok)
         {
             // ok means that the data/metadata/status/etc is going to go to the wire.
             // If it is false, it not going to the wire because the call is already dead (i.e., canceled,
             // deadline expired, other side dropped the channel, etc).
 
-            if (ok)
-            {
-                std::lock_guard alg(_actionsMutex);
+            std::unique_lock l(_actionsMutex);
+            assert(_performing);
+            _performing = false;
 
-                bool lastMessageWritten = action->options().is_last_message();
-                bool finishPerformed = false;
-                while (!_actions.empty())
-                {
-                    auto nextAction = popAction();
-                    if (auto writeAction = dynamic_cast<WriteAction*>(nextAction))
-                    {
-                        if (lastMessageWritten)
-                        {
-                            writeAction->template setException<InvalidStreamingAction>(
-                                "Last already written, no more message is allowed.");
-                        }
-                        else
-                        {
-                            if (finishPerformed)
-                            {
-                                writeAction->template setException<InvalidStreamingAction>(
-                                    "Attempt to write after finish.");
-                            }
-                            else
-                            {
-                                writeAction->perform();
-                            }
-                        }
-                    }
-                    else if (auto finishAction = dynamic_cast<FinishAction*>(nextAction))
-                    {
-                        if (finishPerformed)
-                        {
-                            finishAction->template setException<InvalidStreamingAction>("Duplicate finish call.");
-                        }
-                        else
-                        {
-                            finishAction->perform();
-                            finishPerformed = true;
-                        }
-                    }
-                }
+            if (dynamic_cast<FinishAction*>(action))
+            {
+                _finished = true;
             }
-            else
+            else if (!ok && !_broken)
             {
-                finish();
+                // Finish the call to retrieve the final status.
+                _broken = true;
+                if (!_finishRequested)
+                {
+                    _finishRequested = true;
+                    _actions.emplace(new FinishAction(this));
+                }
             }
-        }
 
-        void finalizeFinish(FinishAction* action, bool ok)
-        {
-            // ok should always be true
-            assert(ok);
+            performNextAction();
 
-            _onFinished();
+            unlockAndNotify(l, action, ok);
         }
 
-        template<typename T, typename... Args>
-        std::future<bool> newAction(Args... args)
+        // Release the lock, notify the owner call once the writer is finished, then set the result of the finalized
+        // action (if any) and the results of dropped actions. Nothing is called with the lock held since a result
+        // callback may make further actions, and the owner is notified first so that the outcome of the call (e.g. the
+        // response of a client streaming call) is ready by the time the result of the finish is.
+        // The writer may be deleted by the owner once notified, thus no member is accessed after that.
+        void unlockAndNotify(
+            std::unique_lock<std::mutex>& lock, StreamAction* finalizedAction = nullptr, bool finalizedOk = false)
         {
-            static_assert(std::is_base_of_v<StreamAction, T>);
+            auto droppedActions = std::exchange(_droppedActions, {});
+            bool notify = _finished && !_finishedNotified;
+            _finishedNotified = _finishedNotified || notify;
+            lock.unlock();
 
-            auto action = new T(std::forward<Args>(args)...);
-            auto result = action->result();
+            if (notify)
+                _onFinished();
+
+            if (finalizedAction)
+                finalizedAction->setResult(finalizedOk);
+            for (auto action : droppedActions)
             {
-                std::lock_guard l(_actionsMutex);
-                _actions.emplace(action);
+                action->setResult(false);
+                delete action;
             }
-            return result;
         }
 
-        StreamAction* popAction()
-        {
-            auto action = _actions.front();
-            _actions.pop();
-            return action;
-        }
-
-        std::mutex _stateMutex;
-        State _state { State::Ready };
-
         std::mutex _actionsMutex;
         std::queue<StreamAction*> _actions;
+        std::vector<StreamAction*> _droppedActions;
+        bool _performing {};
+        bool _lastMessageWritten {};
+        bool _finishRequested {};
+        bool _broken {};
+        bool _finished {};
+        bool _finishedNotified {};
     };
 }
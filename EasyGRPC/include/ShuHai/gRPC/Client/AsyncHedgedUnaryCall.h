@@ -0,0 +1,273 @@
+#pragma once
+
+#include "ShuHai/gRPC/Client/AsyncUnaryCall.h"
+#include "ShuHai/gRPC/Client/AsyncCallHedger.h"
+#include "ShuHai/gRPC/AsyncActionQueue.h"
+#include "ShuHai/gRPC/IAsyncAction.h"
+#include "ShuHai/gRPC/Executor.h"
+
+#include <grpcpp/alarm.h>
+
+#include <future>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <vector>
+
+namespace ShuHai::gRPC::Client
+{
+    template<typename... Stubs>
+    class AsyncClient;
+
+    /**
+     * \brief Part of AsyncHedgedUnaryCall that is independent of the rpc, which the client closes once it shuts down.
+     */
+    class AsyncHedgedCall
+    {
+    public:
+        virtual ~AsyncHedgedCall() = default;
+
+    private:
+        template<typename... Stubs>
+        friend class AsyncClient;
+
+        // Stop sending hedges, the attempts already started run on.
+        virtual void close() = 0;
+    };
+
+    /**
+     * \brief A unary call that is sent again once it gets no response within the delay of its hedger, see
+     *  AsyncCallHedger. The first successful attempt makes the response of the call and the others are cancelled, the
+     *  call fails only once all its attempts fail.
+     */
+    template<typename CallFunc>
+    class AsyncHedgedUnaryCall
+        : public AsyncHedgedCall
+        , public std::enable_shared_from_this<AsyncHedgedUnaryCall<CallFunc>>
+    {
+    public:
+        SHUHAI_GRPC_CLIENT_EXPAND_AsyncCallTraits(CallFunc);
+
+        using Attempt = AsyncUnaryCall<CallFunc>;
+        using ResponseCallback = typename Attempt::ResponseCallback;
+
+        /**
+         * \brief Starts an attempt of the call whose result is passed to the specified callback, the attempt is
+         *  expected to be sent to a channel other than the ones of the previous attempts if possible.
+         */
+        using AttemptStarter = std::function<std::shared_ptr<Attempt>(ResponseCallback)>;
+
+        using DeadCallback = std::function<void(std::shared_ptr<AsyncHedgedUnaryCall>)>;
+
+        AsyncHedgedUnaryCall(std::shared_ptr<AsyncCallHedger> hedger, gRPC::AsyncActionQueue* actionQueue,
+            AttemptStarter attemptStarter, ResponseCallback responseCallback, Executor responseCallbackExecutionContext,
+            DeadCallback deadCallback = nullptr)
+            : _hedger(std::move(hedger))
+            , _actionQueue(actionQueue)
+            , _attemptStarter(std::move(attemptStarter))
+            , _responseCallback(std::move(responseCallback))
+            , _responseCallbackExecutionContext(responseCallbackExecutionContext)
+            , _deadCallback(std::move(deadCallback))
+        {
+            _responseFuture = _responsePromise.get_future();
+        }
+
+        std::shared_future<Response> response() { return _responseFuture; }
+
+        /**
+         * \brief Number of attempts started so far, including the first one.
+         */
+        [[nodiscard]] size_t attemptCount() const
+        {
+            std::lock_guard l(_mutex);
+            return _attemptCount;
+        }
+
+    private:
+        template<typename... Stubs>
+        friend class AsyncClient;
+
+        using Clock = std::chrono::steady_clock;
+
+        void start()
+        {
+            _hedger->addCall();
+            startAttempt();
+            armTimer();
+        }
+
+        void startAttempt()
+        {
+            size_t index;
+            {
+                std::lock_guard l(_mutex);
+                index = _attemptCount++;
+                ++_pendingAttemptCount;
+            }
+
+            auto attempt = _attemptStarter(
+                [self = this->shared_from_this(), index, startTime = Clock::now()](std::shared_future<Response> f)
+                { self->finalizeAttempt(index, f, Clock::now() - startTime); });
+
+            // The call may be done before the attempt is recorded.
+            std::lock_guard l(_mutex);
+            _attempts.emplace_back(attempt);
+            if (_done && index != _winnerIndex)
+                attempt->context().TryCancel();
+        }
+
+        void armTimer()
+        {
+            auto delay = _hedger->delay();
+            if (!delay)
+                return;
+
+            std::lock_guard l(_mutex);
+            if (_done || _closed || _attemptCount >= _hedger->options().maxAttempts)
+                return;
+
+            auto deadline =
+                gpr_time_add(gpr_now(GPR_CLOCK_MONOTONIC), gpr_time_from_nanos(delay->count(), GPR_TIMESPAN));
+            _timerArmed = _actionQueue->tryStartOperation(
+                [&]()
+                {
+                    _alarm.Set(_actionQueue->completionQueue(), deadline,
+                        gRPC::AsyncActionQueue::embeddedTag(&_timerAction));
+                });
+            if (_timerArmed)
+                _timerKeepAlive = this->shared_from_this();
+        }
+
+        void finalizeTimer(bool ok)
+        {
+            std::shared_ptr<AsyncHedgedUnaryCall> self;
+            {
+                std::lock_guard l(_mutex);
+                self = std::move(_timerKeepAlive);
+                _timerArmed = false;
+                if (!ok || _done || _closed)
+                    return;
+            }
+
+            if (!_hedger->tryAcquireHedge())
+                return;
+
+            startAttempt();
+            armTimer();
+        }
+
+        void close() override
+        {
+            std::lock_guard l(_mutex);
+            _closed = true;
+            if (_timerArmed)
+                _alarm.Cancel();
+        }
+
+        void finalizeAttempt(size_t index, const std::shared_future<Response>& result, std::chrono::nanoseconds latency)
+        {
+            bool succeeded = !hasException(result);
+            if (succeeded)
+                _hedger->addSample(latency);
+
+            std::vector<std::shared_ptr<Attempt>> losers;
+            {
+                std::lock_guard l(_mutex);
+                --_pendingAttemptCount;
+                if (_done)
+                    return;
+
+                // A failed attempt makes the result only if no other attempt is able to succeed. Hedging is not meant
+                // to retry failures, thus no more attempts start once all started ones fail.
+                if (!succeeded && _pendingAttemptCount > 0)
+                    return;
+
+                _done = true;
+                _winnerIndex = index;
+                if (_timerArmed)
+                    _alarm.Cancel();
+                for (size_t i = 0; i < _attempts.size(); ++i)
+                {
+                    if (i != index)
+                        losers.emplace_back(_attempts[i]);
+                }
+                _attempts.clear();
+            }
+
+            for (auto& attempt : losers)
+                attempt->context().TryCancel();
+
+            if (succeeded && index > 0)
+                _hedger->addHedgeWin();
+
+            try
+            {
+                _responsePromise.set_value(result.get());
+            }
+            catch (...)
+            {
+                _responsePromise.set_exception(std::current_exception());
+            }
+
+            if (_responseCallback)
+            {
+                _responseCallbackExecutionContext.dispatch(
+                    [cb = std::move(_responseCallback), f = _responseFuture]() { cb(f); });
+            }
+
+            if (_deadCallback)
+                _deadCallback(this->shared_from_this());
+        }
+
+        static bool hasException(const std::shared_future<Response>& result)
+        {
+            try
+            {
+                result.get();
+                return false;
+            }
+            catch (...)
+            {
+                return true;
+            }
+        }
+
+        class TimerAction : public IAsyncAction
+        {
+        public:
+            explicit TimerAction(AsyncHedgedUnaryCall* owner)
+                : _owner(owner)
+            { }
+
+            void finalizeResult(bool ok) override { _owner->finalizeTimer(ok); }
+
+        private:
+            AsyncHedgedUnaryCall* const _owner;
+        };
+
+        const std::shared_ptr<AsyncCallHedger> _hedger;
+        gRPC::AsyncActionQueue* const _actionQueue;
+        const AttemptStarter _attemptStarter;
+
+        std::promise<Response> _responsePromise;
+        std::shared_future<Response> _responseFuture;
+        ResponseCallback _responseCallback;
+        Executor _responseCallbackExecutionContext;
+        DeadCallback _deadCallback;
+
+        mutable std::mutex _mutex;
+        std::vector<std::shared_ptr<Attempt>> _attempts;
+        size_t _attemptCount {};
+        size_t _pendingAttemptCount {};
+        bool _done {};
+        bool _closed {};
+        size_t _winnerIndex {};
+
+        // The call is kept alive while its timer is armed, since the timer action is embedded.
+        grpc::Alarm _alarm;
+        TimerAction _timerAction { this };
+        bool _timerArmed {};
+        std::shared_ptr<AsyncHedgedUnaryCall> _timerKeepAlive;
+    };
+}
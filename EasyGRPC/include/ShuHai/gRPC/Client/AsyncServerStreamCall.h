@@ -0,0 +1,164 @@
+#pragma once
+
+#include "ShuHai/gRPC/Client/AsyncServerStreamReader.h"
+#include "ShuHai/gRPC/Client/AsyncCall.h"
+#include "ShuHai/gRPC/Client/TypeTraits.h"
+#include "ShuHai/gRPC/SharedPromise.h"
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace ShuHai::gRPC::Client
+{
+    template<typename CallFunc>
+    class AsyncServerStreamCall
+        : public AsyncCall
+        , public std::enable_shared_from_this<AsyncServerStreamCall<CallFunc>>
+    {
+    public:
+        SHUHAI_GRPC_CLIENT_EXPAND_AsyncCallTraits(CallFunc);
+        using StreamReader = AsyncServerStreamReader<CallFunc>;
+        using DeadCallback = std::function<void(std::shared_ptr<AsyncServerStreamCall>)>;
+
+        AsyncServerStreamCall(Stub* stub, CallFunc func, const Request& request,
+            std::unique_ptr<grpc::ClientContext> context, gRPC::AsyncActionQueue* actionQueue,
+            DeadCallback deadCallback)
+            : AsyncCall(std::move(context))
+            , _stub(stub)
+            , _func(func)
+            , _request(&request)
+            , _actionQueue(actionQueue)
+            , _deadCallback(std::move(deadCallback))
+        { }
+
+        ~AsyncServerStreamCall() override
+        {
+            delete _streamReader;
+            _streamReader = nullptr;
+        }
+
+        /**
+         * \brief The stream reader of the call, it is ready once the call started.
+         */
+        [[nodiscard]] std::shared_future<StreamReader*> streamReader() { return _streamReaderPromise.future(); }
+
+        /**
+         * \brief Same as streamReader(), except that the future is passed to the specified \p callback once it is
+         *  ready, on the thread that makes it ready, or immediately if it is already ready.
+         */
+        void streamReader(typename SharedPromise<StreamReader*>::Callback callback)
+        {
+            _streamReaderPromise.then(std::move(callback));
+        }
+
+        /**
+         * \brief The final status of the call, it is ready once all messages are read.
+         */
+        [[nodiscard]] std::shared_future<grpc::Status> finished() const { return _finishedPromise.future(); }
+
+        /**
+         * \brief Same as finished(), except that the future is passed to the specified \p callback once it is
+         *  ready, on the thread that makes it ready, or immediately if it is already ready.
+         */
+        void finished(typename SharedPromise<grpc::Status>::Callback callback)
+        {
+            _finishedPromise.then(std::move(callback));
+        }
+
+    private:
+        template<typename... Stubs>
+        friend class AsyncClient;
+
+        // The call starts once it is owned by the client, since it may finish on another polling thread as soon as its
+        // stream is ready. The request passed to the constructor is referred until then.
+        void start()
+        {
+            // The call may start before the stream reader is created.
+            std::lock_guard l(_startMutex);
+            auto cq = _actionQueue->completionQueue();
+            auto request = std::exchange(_request, nullptr);
+            _stream = (_stub->*_func)(this->_context.get(), *request, cq, new CallAction(this));
+            _streamReader = new StreamReader(_actionQueue, *_stream, [this]() { onStreamReaderFinished(); });
+        }
+
+        class CallAction : public IAsyncAction
+        {
+        public:
+            explicit CallAction(AsyncServerStreamCall* owner)
+                : _owner(owner)
+            { }
+
+            // The call may finish on another polling thread once its stream is ready, it is kept alive until the
+            // notification is done.
+            void finalizeResult(bool ok) override
+            {
+                auto owner = _owner->shared_from_this();
+                owner->markStreamReaderReady();
+            }
+
+        private:
+            AsyncServerStreamCall* const _owner;
+        };
+
+        class FinishAction : public IAsyncAction
+        {
+        public:
+            explicit FinishAction(AsyncServerStreamCall* owner)
+                : _owner(owner)
+            { }
+
+            void perform() { _owner->_stream->Finish(&_owner->_status, this); }
+
+            void finalizeResult(bool ok) override { _owner->finalizeFinish(); }
+
+        private:
+            AsyncServerStreamCall* const _owner;
+        };
+
+        void markStreamReaderReady()
+        {
+            StreamReader* streamReader;
+            {
+                std::lock_guard l(_startMutex);
+                streamReader = _streamReader;
+            }
+            _streamReaderPromise.setValue(streamReader);
+        }
+
+        void onStreamReaderFinished()
+        {
+            auto action = new FinishAction(this);
+            if (_actionQueue->tryStartOperation([action]() { action->perform(); }))
+                return;
+
+            delete action;
+            this->_status = grpc::Status(grpc::StatusCode::CANCELLED, "The completion queue is shut down.");
+            finalizeFinish();
+        }
+
+        void finalizeFinish()
+        {
+            _finishedPromise.setValue(this->_status);
+
+            if (_deadCallback)
+                _deadCallback(this->shared_from_this());
+        }
+
+        Stub* const _stub;
+        const CallFunc _func;
+        const Request* _request;
+        gRPC::AsyncActionQueue* const _actionQueue;
+
+        std::mutex _startMutex;
+        std::unique_ptr<StreamingInterface> _stream;
+
+        StreamReader* _streamReader {};
+        SharedPromise<StreamReader*> _streamReaderPromise;
+
+        SharedPromise<grpc::Status> _finishedPromise;
+
+        DeadCallback _deadCallback;
+    };
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "ShuHai/gRPC/Client/TypeTraits.h"
+#include "ShuHai/gRPC/AsyncAction.h"
+#include "ShuHai/gRPC/AsyncActionQueue.h"
+#include "ShuHai/gRPC/StreamingError.h"
+
+#include <future>
+#include <mutex>
+#include <functional>
+
+namespace ShuHai::gRPC::Client
+{
+    template<typename CallFunc>
+    class AsyncServerStreamCall;
+
+    template<typename CallFunc>
+    class AsyncBidiStreamCall;
+
+    /**
+     * \brief Reads messages from the server side of a server streaming or bidirectional streaming call.
+     */
+    template<typename CallFunc>
+    class AsyncServerStreamReader
+    {
+    public:
+        SHUHAI_GRPC_CLIENT_EXPAND_AsyncCallTraits(CallFunc);
+        static_assert(rpcTypeOf<CallFunc>() == RpcType::ServerStream || rpcTypeOf<CallFunc>() == RpcType::BidiStream);
+
+        using ResultCallback = AsyncAction<bool>::ResultCallback;
+
+        /**
+         * \brief The message read by the last successful moveNext().
+         */
+        [[nodiscard]] const Response& current() const { return _current; }
+
+        /**
+         * \brief Read the next message from the stream, the message is available by current() once the returned future
+         *  is ready. Only one read is allowed to be in progress at the same time.
+         * \return The future object that identifies whether a message is read, false means there is no more message
+         *  that can ever be read from the stream.
+         */
+        std::future<bool> moveNext()
+        {
+            auto action = new ReadAction(this);
+            auto result = action->result();
+            startRead(action);
+            return result;
+        }
+
+        /**
+         * \brief Same as moveNext(), except that the future of the result is passed to the specified \p callback once
+         *  it is ready. The callback is called from the completion queue thread in most cases, it should return as
+         *  soon as possible.
+         */
+        void moveNext(ResultCallback callback)
+        {
+            auto action = new ReadAction(this);
+            action->setResultCallback(std::move(callback));
+            startRead(action);
+        }
+
+    private:
+        friend class AsyncServerStreamCall<CallFunc>;
+        friend class AsyncBidiStreamCall<CallFunc>;
+
+        class ReadAction : public AsyncAction<bool>
+        {
+        public:
+            explicit ReadAction(AsyncServerStreamReader* owner)
+                : _owner(owner)
+            { }
+
+            void perform() { _owner->_stream.Read(&_owner->_current, this); }
+
+            void finalizeResult(bool ok) override { _owner->finalizeRead(this, ok); }
+
+        private:
+            AsyncServerStreamReader* const _owner;
+        };
+
+        AsyncServerStreamReader(
+            gRPC::AsyncActionQueue* actionQueue, StreamingInterface& stream, std::function<void()> onFinished)
+            : _actionQueue(actionQueue)
+            , _stream(stream)
+            , _onFinished(std::move(onFinished))
+        { }
+
+        void startRead(ReadAction* action)
+        {
+            std::unique_lock l(_mutex);
+            if (_reading)
+            {
+                l.unlock();
+                action->template setException<InvalidStreamingAction>("Another read is in progress.");
+                delete action;
+            }
+            else if (_finished || !_actionQueue->tryStartOperation([action]() { action->perform(); }))
+            {
+                bool notify = !_finished;
+                _finished = true;
+                l.unlock();
+
+                action->setResult(false);
+                delete action;
+                if (notify)
+                    _onFinished();
+            }
+            else
+            {
+                _reading = true;
+            }
+        }
+
+        void finalizeRead(ReadAction* action, bool ok)
+        {
+            // ok indicates whether there is a valid message that got read.
+            // If not, you know that there are certainly no more messages that can ever be read from this stream.
+            // This could happen because the server has finished the call already.
+
+            {
+                std::lock_guard l(_mutex);
+                _reading = false;
+                _finished = !ok;
+            }
+
+            action->setResult(ok);
+
+            if (!ok)
+                _onFinished();
+        }
+
+        gRPC::AsyncActionQueue* const _actionQueue;
+        StreamingInterface& _stream;
+        std::function<void()> _onFinished;
+
+        std::mutex _mutex;
+        bool _reading {};
+        bool _finished {};
+        Response _current;
+    };
+}
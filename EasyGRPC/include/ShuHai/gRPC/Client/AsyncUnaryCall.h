@@ -3,19 +3,23 @@
 #include "ShuHai/gRPC/Client/AsyncCall.h"
 #include "ShuHai/gRPC/Client/AsyncCallError.h"
 #include "ShuHai/gRPC/Client/TypeTraits.h"
+#include "ShuHai/gRPC/AsyncActionQueue.h"
+#include "ShuHai/gRPC/Executor.h"
 
 #include <grpcpp/grpcpp.h>
 #include <google/protobuf/message.h>
 
-#include <asio/dispatch.hpp>
-#include <asio/execution_context.hpp>
-
 #include <future>
 #include <functional>
+#include <optional>
+#include <chrono>
 #include <cassert>
 
 namespace ShuHai::gRPC::Client
 {
+    template<typename... Stubs>
+    class AsyncClient;
+
     template<typename CallFunc>
     class AsyncUnaryCall
         : public AsyncCall
@@ -27,22 +31,50 @@ namespace ShuHai::gRPC::Client
         using ResponseCallback = std::function<void(std::shared_future<Response>)>;
         using DeadCallback = std::function<void(std::shared_ptr<AsyncUnaryCall>)>;
 
-        explicit AsyncUnaryCall(Stub* stub, CallFunc func, const Request& request, grpc::CompletionQueue* cq,
+        explicit AsyncUnaryCall(Stub* stub, CallFunc func, gRPC::AsyncActionQueue* actionQueue,
             std::unique_ptr<grpc::ClientContext> context, ResponseCallback responseCallback,
-            asio::execution_context* responseCallbackExecutionContext, DeadCallback deadCallback)
+            Executor responseCallbackExecutionContext, DeadCallback deadCallback)
             : AsyncCall(std::move(context))
+            , _stub(stub)
+            , _func(func)
+            , _actionQueue(actionQueue)
             , _responseCallback(std::move(responseCallback))
             , _responseCallbackExecutionContext(responseCallbackExecutionContext)
             , _deadCallback(std::move(deadCallback))
         {
             _responseFuture = _responsePromise.get_future();
-            _stream = (stub->*func)(this->_context.get(), request, cq);
-            new CallFinishAction(this, &_response, &this->_status);
         }
 
         std::shared_future<Response> response() { return _responseFuture; }
 
     private:
+        template<typename... Stubs>
+        friend class AsyncClient;
+
+        // The call is sent once it is owned by the client, since finishing the call refers to the owner. The client may
+        // also hold the call back for a while, see AsyncCallLimiter. The call fails instead if the queue is shut down
+        // meanwhile, returns false in such case.
+        bool start(const Request& request)
+        {
+            bool started = _actionQueue->tryStartOperation(
+                [&]()
+                {
+                    _startTime = std::chrono::steady_clock::now();
+                    _stream = (_stub->*_func)(this->_context.get(), request, _actionQueue->completionQueue());
+                    _finishAction.perform(&_response, &this->_status);
+                });
+            if (!started)
+                fail(grpc::Status(grpc::StatusCode::CANCELLED, "The completion queue is shut down."));
+            return started;
+        }
+
+        // Finish the call with the specified status without sending it.
+        void fail(grpc::Status status)
+        {
+            this->_status = std::move(status);
+            finish();
+        }
+
         class CallAction : public IAsyncAction
         {
         public:
@@ -57,10 +89,14 @@ namespace ShuHai::gRPC::Client
         class CallFinishAction : public CallAction
         {
         public:
-            explicit CallFinishAction(AsyncUnaryCall* owner, Response* response, grpc::Status* status)
+            explicit CallFinishAction(AsyncUnaryCall* owner)
                 : CallAction(owner)
+            { }
+
+            void perform(Response* response, grpc::Status* status)
             {
-                this->_owner->_stream->Finish(response, status, this);
+                // The action is embedded in the call, thus it is not deleted by the queue.
+                this->_owner->_stream->Finish(response, status, gRPC::AsyncActionQueue::embeddedTag(this));
             }
 
             void finalizeResult(bool ok) override { this->_owner->finalizeFinished(ok); }
@@ -70,11 +106,16 @@ namespace ShuHai::gRPC::Client
         {
             // ok should always be true
             assert(ok);
+            finish();
+        }
 
+        void finish()
+        {
             try
             {
+                // The status is kept for the client to inspect once the call is dead.
                 if (!this->_status.ok())
-                    throw AsyncCallError(std::move(this->_status));
+                    throw AsyncCallError(this->_status);
                 _responsePromise.set_value(std::move(_response));
             }
             catch (...)
@@ -92,24 +133,23 @@ namespace ShuHai::gRPC::Client
             if (!_responseCallback)
                 return;
 
-            if (_responseCallbackExecutionContext)
-            {
-                auto ex = asio::get_associated_executor(*_responseCallbackExecutionContext);
-                asio::dispatch(ex, [cb = std::move(_responseCallback), f = _responseFuture]() { cb(f); });
-            }
-            else
-            {
-                asio::dispatch([cb = std::move(_responseCallback), f = _responseFuture]() { cb(f); });
-            }
+            _responseCallbackExecutionContext.dispatch(
+                [cb = std::move(_responseCallback), f = _responseFuture]() { cb(f); });
         }
 
+        Stub* const _stub;
+        const CallFunc _func;
+        gRPC::AsyncActionQueue* const _actionQueue;
+        std::optional<std::chrono::steady_clock::time_point> _startTime;
+
         std::unique_ptr<StreamingInterface> _stream;
+        CallFinishAction _finishAction { this };
         Response _response;
         std::promise<Response> _responsePromise;
         std::shared_future<Response> _responseFuture;
 
         ResponseCallback _responseCallback;
-        asio::execution_context* _responseCallbackExecutionContext {};
+        Executor _responseCallbackExecutionContext;
 
         DeadCallback _deadCallback;
     };
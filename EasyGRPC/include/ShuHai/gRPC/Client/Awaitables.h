@@ -0,0 +1,101 @@
+#pragma once
+
+#include "ShuHai/gRPC/Client/AsyncClient.h"
+#include "ShuHai/gRPC/Task.h"
+
+#ifdef SHUHAI_GRPC_HAS_COROUTINES
+
+namespace ShuHai::gRPC::Client
+{
+    /**
+     * \brief Awaitable of a unary call made by the specified \p client. The awaiting coroutine is resumed from the
+     *  completion queue thread of the client once the call finished, the result of awaiting is the response, or
+     *  AsyncCallError is thrown if the call finished with error.
+     */
+    template<typename CallFunc, typename... Stubs>
+    auto awaitCall(AsyncClient<Stubs...>& client, CallFunc asyncCall, RequestTypeOf<CallFunc> request,
+        std::unique_ptr<grpc::ClientContext> context = nullptr)
+    {
+        using Response = ResponseTypeOf<CallFunc>;
+        return awaitFuture<std::shared_future<Response>>(
+            [&client, asyncCall, r = std::move(request), c = std::move(context)](auto callback) mutable
+            { client.call(asyncCall, r, std::move(callback), nullptr, std::move(c)); });
+    }
+
+    /**
+     * \brief Awaitable of the stream reader of the specified \p call, which is ready once the call started.
+     */
+    template<typename Call>
+    auto awaitStreamReader(const std::shared_ptr<Call>& call)
+    {
+        using StreamReader = typename Call::StreamReader;
+        return awaitFuture<std::shared_future<StreamReader*>>(
+            [call](auto callback) { call->streamReader(std::move(callback)); });
+    }
+
+    /**
+     * \brief Awaitable of the stream writer of the specified \p call, which is ready once the call started.
+     */
+    template<typename Call>
+    auto awaitStreamWriter(const std::shared_ptr<Call>& call)
+    {
+        using StreamWriter = typename Call::StreamWriter;
+        return awaitFuture<std::shared_future<StreamWriter*>>(
+            [call](auto callback) { call->streamWriter(std::move(callback)); });
+    }
+
+    /**
+     * \brief Awaitable of the response of the specified client streaming \p call, AsyncCallError is thrown if the call
+     *  finished with error.
+     */
+    template<typename CallFunc>
+    auto awaitResponse(const std::shared_ptr<AsyncClientStreamCall<CallFunc>>& call)
+    {
+        return awaitFuture<std::shared_future<ResponseTypeOf<CallFunc>>>(
+            [call](auto callback) { call->response(std::move(callback)); });
+    }
+
+    /**
+     * \brief Awaitable of the final status of the specified server streaming or bidirectional streaming \p call.
+     */
+    template<typename Call>
+    auto awaitFinished(const std::shared_ptr<Call>& call)
+    {
+        return awaitFuture<std::shared_future<grpc::Status>>(
+            [call](auto callback) { call->finished(std::move(callback)); });
+    }
+
+    /**
+     * \brief Awaitable of reading the next message by the specified stream \p reader, the result of awaiting is the
+     *  same as the result of AsyncServerStreamReader::moveNext().
+     */
+    template<typename CallFunc>
+    auto awaitRead(AsyncServerStreamReader<CallFunc>& reader)
+    {
+        return awaitFuture<std::future<bool>>([&reader](auto callback) { reader.moveNext(std::move(callback)); });
+    }
+
+    /**
+     * \brief Awaitable of writing the specified \p message by the specified stream \p writer, the result of awaiting is
+     *  the same as the result of AsyncClientStreamWriter::write().
+     */
+    template<typename CallFunc>
+    auto awaitWrite(
+        AsyncClientStreamWriter<CallFunc>& writer, RequestTypeOf<CallFunc> message, grpc::WriteOptions options = {})
+    {
+        return awaitFuture<std::future<bool>>([&writer, m = std::move(message), options](auto callback) mutable
+            { writer.write(std::move(m), options, std::move(callback)); });
+    }
+
+    /**
+     * \brief Awaitable of finishing the specified stream \p writer, the result of awaiting is the same as the result of
+     *  AsyncClientStreamWriter::finish().
+     */
+    template<typename CallFunc>
+    auto awaitFinish(AsyncClientStreamWriter<CallFunc>& writer)
+    {
+        return awaitFuture<std::future<bool>>([&writer](auto callback) { writer.finish(std::move(callback)); });
+    }
+}
+
+#endif
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <asio/dispatch.hpp>
+#include <asio/execution_context.hpp>
+
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+
+namespace ShuHai::gRPC
+{
+    namespace ExecutorDetail
+    {
+        template<typename Context, typename = void>
+        struct HasAsioExecutor : std::false_type
+        { };
+
+        template<typename Context>
+        struct HasAsioExecutor<Context, std::void_t<decltype(std::declval<Context&>().get_executor())>>
+            : std::true_type
+        { };
+
+        template<typename Context, typename = void>
+        struct HasDispatch : std::false_type
+        { };
+
+        template<typename Context>
+        struct HasDispatch<Context,
+            std::void_t<decltype(std::declval<Context&>().dispatch(std::declval<std::function<void()>>()))>>
+            : std::true_type
+        { };
+    }
+
+    /**
+     * \brief Refers to where functions such as handle functions and callbacks are executed. It is made from a pointer
+     *  to any asio execution context that provides get_executor(), e.g. asio::io_context or asio::thread_pool, or to
+     *  any context that provides dispatch(std::function<void()>), e.g. WorkStealingThreadPool. The referred context
+     *  must outlive the executor; a null one executes functions on the calling thread.
+     */
+    class Executor
+    {
+    public:
+        Executor() = default;
+
+        Executor(std::nullptr_t) { } // NOLINT(google-explicit-constructor)
+
+        template<typename Context, std::enable_if_t<ExecutorDetail::HasAsioExecutor<Context>::value, int> = 0>
+        Executor(Context* context) // NOLINT(google-explicit-constructor)
+            : _context(context)
+        {
+            if (context)
+                _dispatch = &dispatchByAsio<Context>;
+        }
+
+        template<typename Context,
+            std::enable_if_t<!ExecutorDetail::HasAsioExecutor<Context>::value
+                    && ExecutorDetail::HasDispatch<Context>::value,
+                int> = 0>
+        Executor(Context* context) // NOLINT(google-explicit-constructor)
+            : _context(context)
+        {
+            if (context)
+                _dispatch = &dispatchBy<Context>;
+        }
+
+        /**
+         * \brief Kept for the callers that still pass contexts by the asio base class, as before Executor is introduced.
+         *  The base class provides no executor to dispatch to, thus the executor made is null, as the context was
+         *  taken for the system context then; pass the pointer to the derived class, e.g. asio::io_context*, instead.
+         */
+        [[deprecated("Pass the pointer to the derived class of the execution context instead.")]]
+        Executor(asio::execution_context*) // NOLINT(google-explicit-constructor)
+        { }
+
+        explicit operator bool() const { return _dispatch != nullptr; }
+
+        /**
+         * \brief Execute the specified function by the referred execution context, the function is executed before
+         *  dispatch() returns if the calling thread runs the context, or if the executor is null.
+         */
+        template<typename Func>
+        void dispatch(Func&& func) const
+        {
+            if (_dispatch)
+                _dispatch(_context, std::function<void()>(std::forward<Func>(func)));
+            else
+                std::forward<Func>(func)();
+        }
+
+    private:
+        template<typename Context>
+        static void dispatchByAsio(void* context, std::function<void()> func)
+        {
+            asio::dispatch(static_cast<Context*>(context)->get_executor(), std::move(func));
+        }
+
+        template<typename Context>
+        static void dispatchBy(void* context, std::function<void()> func)
+        {
+            static_cast<Context*>(context)->dispatch(std::move(func));
+        }
+
+        void* _context {};
+        void (*_dispatch)(void*, std::function<void()>) {};
+    };
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <cstddef>
+
+namespace ShuHai::gRPC
+{
+    /**
+     * \brief Options of the threads that poll completion queues.
+     */
+    struct PollerOptions
+    {
+        /**
+         * \brief Number of threads polling each completion queue. More than one thread keeps a queue polled while one
+         *  of its threads finalizes a long operation, at the cost of more contention on the queue.
+         */
+        size_t threadCount = 1;
+
+        /**
+         * \brief Maximum number of threads polling each completion queue. Another thread starts polling a queue once
+         *  its threads stay busy for growBusyRatio of a growInterval, and threads beyond threadCount stop once they
+         *  wait for events longer than idleTimeout. The number of threads is fixed to threadCount if not greater than
+         *  it.
+         */
+        size_t maxThreadCount = 0;
+
+        /**
+         * \brief Share of the time that the threads of a completion queue spend on handling events during a
+         *  growInterval, beyond which another thread starts polling the queue, see maxThreadCount. Light traffic keeps
+         *  the threads busy only now and then, thus it does not grow the threads.
+         */
+        double growBusyRatio = 0.9;
+
+        /**
+         * \brief Period over which the busy ratio of the threads is measured, at most one thread starts per period, see
+         *  growBusyRatio.
+         */
+        std::chrono::nanoseconds growInterval = std::chrono::milliseconds(10);
+
+        /**
+         * \brief How long a thread beyond threadCount waits for events before it stops, see maxThreadCount.
+         */
+        std::chrono::nanoseconds idleTimeout = std::chrono::seconds(1);
+
+        /**
+         * \brief CPU sets that polling threads are pinned to, threads of completion queue i are pinned to
+         *  cpuSets[i % cpuSets.size()], and the queue itself is created by a thread pinned the same way so that its
+         *  state is allocated on the NUMA node of those CPUs. The threads are not pinned if empty.
+         */
+        std::vector<std::vector<size_t>> cpuSets;
+
+        /**
+         * \brief How long polling threads keep polling without blocking once their completion queue runs out of events,
+         *  before they block in wait for the next event. Threads of completion queue i spin for
+         *  spinDurations[i % spinDurations.size()], and always block if empty or zero.
+         *  Spinning saves the wakeup of a blocked thread from the latency of each event that arrives within the spin
+         *  duration, at the cost of a busy CPU per spinning thread.
+         */
+        std::vector<std::chrono::nanoseconds> spinDurations;
+
+        /**
+         * \brief CPUs of the completion queue at the specified \p index, empty if not pinned.
+         */
+        [[nodiscard]] std::vector<size_t> cpusOf(size_t index) const
+        {
+            return cpuSets.empty() ? std::vector<size_t>() : cpuSets[index % cpuSets.size()];
+        }
+
+        /**
+         * \brief Spin duration of the completion queue at the specified \p index.
+         */
+        [[nodiscard]] std::chrono::nanoseconds spinDurationOf(size_t index) const
+        {
+            return spinDurations.empty() ? std::chrono::nanoseconds::zero()
+                                         : spinDurations[index % spinDurations.size()];
+        }
+    };
+}
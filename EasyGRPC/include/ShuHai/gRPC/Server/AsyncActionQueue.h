@@ -2,6 +2,8 @@
 
 #include "ShuHai/gRPC/Server/AsyncUnaryCallHandler.h"
 #include "ShuHai/gRPC/Server/AsyncClientStreamCallHandler.h"
+#include "ShuHai/gRPC/Server/AsyncServerStreamCallHandler.h"
+#include "ShuHai/gRPC/Server/AsyncBidiStreamCallHandler.h"
 #include "ShuHai/gRPC/AsyncActionQueue.h"
 #include "ShuHai/gRPC/CustomAsyncAction.h"
 
@@ -22,12 +24,20 @@ namespace ShuHai::gRPC::Server
             _completionQueue = dynamic_cast<grpc::ServerCompletionQueue*>(gRPC::AsyncActionQueue::completionQueue());
         }
 
-        ~AsyncActionQueue() override = default;
+        ~AsyncActionQueue() override
+        {
+            // Pending actions refer to the call handlers, the handlers are deleted after the queue is drained.
+            shutdown();
+            drain();
+            deleteAllCallHandlers();
+        }
 
         void shutdown() override
         {
+            if (isShutdown())
+                return;
+
             shutdownCallHandlers();
-            deleteAllCallHandlers();
 
             gRPC::AsyncActionQueue::shutdown();
         }
@@ -44,33 +54,126 @@ namespace ShuHai::gRPC::Server
         // Call Handlers -----------------------------------------------------------------------------------------------
     public:
         template<typename RequestFunc>
-        EnableIfAnyRpcTypeMatch<void, RequestFunc, RpcType::UnaryCall> registerCallHandler(
-            typename AsyncUnaryCallHandler<RequestFunc>::Service* service, RequestFunc requestFunc,
+        EnableIfAnyRpcTypeMatch<std::shared_ptr<AsyncCallHandlerStats>, RequestFunc, RpcType::UnaryCall>
+        registerCallHandler(typename AsyncUnaryCallHandler<RequestFunc>::Service* service, RequestFunc requestFunc,
             typename AsyncUnaryCallHandler<RequestFunc>::HandleFunc handleFunc,
-            asio::execution_context* handleFuncExecutionContext = nullptr)
+            Executor handleFuncExecutionContext = nullptr, const AsyncCallHandlerOptions& options = {},
+            std::shared_ptr<AsyncCallHandlerStats> stats = nullptr)
         {
-            if (!handleFunc)
-                throw std::invalid_argument("Null handleFunc.");
+            return registerCallHandlerImpl<AsyncUnaryCallHandler<RequestFunc>>(
+                service, requestFunc, std::move(handleFunc), handleFuncExecutionContext, options, std::move(stats));
+        }
 
-            newCallHandler<AsyncUnaryCallHandler<RequestFunc>>(
-                _completionQueue, service, requestFunc, std::move(handleFunc), handleFuncExecutionContext);
+        template<typename RequestFunc>
+        EnableIfAnyRpcTypeMatch<std::shared_ptr<AsyncCallHandlerStats>, RequestFunc, RpcType::UnaryCall>
+        registerCallHandler(typename AsyncUnaryCallHandler<RequestFunc>::Service* service, RequestFunc requestFunc,
+            typename AsyncUnaryCallHandler<RequestFunc>::InPlaceHandleFunc handleFunc,
+            Executor handleFuncExecutionContext = nullptr, const AsyncCallHandlerOptions& options = {},
+            std::shared_ptr<AsyncCallHandlerStats> stats = nullptr)
+        {
+            return registerCallHandlerImpl<AsyncUnaryCallHandler<RequestFunc>>(
+                service, requestFunc, std::move(handleFunc), handleFuncExecutionContext, options, std::move(stats));
         }
 
         template<typename RequestFunc>
-        EnableIfAnyRpcTypeMatch<void, RequestFunc, RpcType::ClientStream> registerCallHandler(
+        EnableIfAnyRpcTypeMatch<std::shared_ptr<AsyncCallHandlerStats>, RequestFunc, RpcType::UnaryCall>
+        registerCallHandler(typename AsyncUnaryCallHandler<RequestFunc>::Service* service, RequestFunc requestFunc,
+            typename AsyncUnaryCallHandler<RequestFunc>::ResponderHandleFunc handleFunc,
+            Executor handleFuncExecutionContext = nullptr, const AsyncCallHandlerOptions& options = {},
+            std::shared_ptr<AsyncCallHandlerStats> stats = nullptr)
+        {
+            return registerCallHandlerImpl<AsyncUnaryCallHandler<RequestFunc>>(
+                service, requestFunc, std::move(handleFunc), handleFuncExecutionContext, options, std::move(stats));
+        }
+
+        template<typename RequestFunc>
+        EnableIfAnyRpcTypeMatch<std::shared_ptr<AsyncCallHandlerStats>, RequestFunc, RpcType::ClientStream>
+        registerCallHandler(
             typename AsyncClientStreamCallHandler<RequestFunc>::Service* service, RequestFunc requestFunc,
-            typename AsyncClientStreamCallHandler<RequestFunc>::HandleFunc handleFunc)
+            typename AsyncClientStreamCallHandler<RequestFunc>::HandleFunc handleFunc,
+            Executor handleFuncExecutionContext = nullptr, const AsyncCallHandlerOptions& options = {},
+            std::shared_ptr<AsyncCallHandlerStats> stats = nullptr)
         {
-            if (!handleFunc)
-                throw std::invalid_argument("Null handleFunc.");
+            return registerCallHandlerImpl<AsyncClientStreamCallHandler<RequestFunc>>(
+                service, requestFunc, std::move(handleFunc), handleFuncExecutionContext, options, std::move(stats));
+        }
 
-            newCallHandler<AsyncClientStreamCallHandler<RequestFunc>>(
-                _completionQueue, service, requestFunc, std::move(handleFunc));
+        template<typename RequestFunc>
+        EnableIfAnyRpcTypeMatch<std::shared_ptr<AsyncCallHandlerStats>, RequestFunc, RpcType::ServerStream>
+        registerCallHandler(
+            typename AsyncServerStreamCallHandler<RequestFunc>::Service* service, RequestFunc requestFunc,
+            typename AsyncServerStreamCallHandler<RequestFunc>::HandleFunc handleFunc,
+            Executor handleFuncExecutionContext = nullptr, const AsyncCallHandlerOptions& options = {},
+            std::shared_ptr<AsyncCallHandlerStats> stats = nullptr)
+        {
+            return registerCallHandlerImpl<AsyncServerStreamCallHandler<RequestFunc>>(
+                service, requestFunc, std::move(handleFunc), handleFuncExecutionContext, options, std::move(stats));
         }
 
+        template<typename RequestFunc>
+        EnableIfAnyRpcTypeMatch<std::shared_ptr<AsyncCallHandlerStats>, RequestFunc, RpcType::BidiStream>
+        registerCallHandler(typename AsyncBidiStreamCallHandler<RequestFunc>::Service* service, RequestFunc requestFunc,
+            typename AsyncBidiStreamCallHandler<RequestFunc>::HandleFunc handleFunc,
+            Executor handleFuncExecutionContext = nullptr, const AsyncCallHandlerOptions& options = {},
+            std::shared_ptr<AsyncCallHandlerStats> stats = nullptr)
+        {
+            return registerCallHandlerImpl<AsyncBidiStreamCallHandler<RequestFunc>>(
+                service, requestFunc, std::move(handleFunc), handleFuncExecutionContext, options, std::move(stats));
+        }
+
+#ifdef SHUHAI_GRPC_HAS_COROUTINES
+        template<typename RequestFunc>
+        EnableIfAnyRpcTypeMatch<std::shared_ptr<AsyncCallHandlerStats>, RequestFunc, RpcType::UnaryCall>
+        registerCallHandler(typename AsyncUnaryCallHandler<RequestFunc>::Service* service, RequestFunc requestFunc,
+            typename AsyncUnaryCallHandler<RequestFunc>::TaskHandleFunc handleFunc,
+            Executor handleFuncExecutionContext = nullptr, const AsyncCallHandlerOptions& options = {},
+            std::shared_ptr<AsyncCallHandlerStats> stats = nullptr)
+        {
+            return registerCallHandlerImpl<AsyncUnaryCallHandler<RequestFunc>>(
+                service, requestFunc, std::move(handleFunc), handleFuncExecutionContext, options, std::move(stats));
+        }
+
+        // Any function that returns a task is also convertible to the ordinary handle function, the task handle
+        // function is thus deduced to be preferred.
+        template<typename RequestFunc, typename TaskHandleFunc>
+        EnableIfTaskInvocable<
+            EnableIfAnyRpcTypeMatch<std::shared_ptr<AsyncCallHandlerStats>, RequestFunc, RpcType::ServerStream>,
+            TaskHandleFunc, grpc::ServerContext&, const RequestTypeOf<RequestFunc>&,
+            std::shared_ptr<AsyncServerStreamWriter<RequestFunc>>>
+        registerCallHandler(
+            typename AsyncServerStreamCallHandler<RequestFunc>::Service* service, RequestFunc requestFunc,
+            TaskHandleFunc handleFunc, Executor handleFuncExecutionContext = nullptr,
+            const AsyncCallHandlerOptions& options = {}, std::shared_ptr<AsyncCallHandlerStats> stats = nullptr)
+        {
+            using Handler = AsyncServerStreamCallHandler<RequestFunc>;
+            return registerCallHandlerImpl<Handler>(service, requestFunc,
+                typename Handler::TaskHandleFunc(std::move(handleFunc)), handleFuncExecutionContext, options,
+                std::move(stats));
+        }
+#endif
+
     private:
         using CallHandlerSet = std::unordered_set<AsyncCallHandlerBase*>;
 
+        template<typename Handler, typename HandleFunc>
+        std::shared_ptr<AsyncCallHandlerStats> registerCallHandlerImpl(typename Handler::Service* service,
+            typename Handler::RequestFunc requestFunc, HandleFunc handleFunc,
+            Executor handleFuncExecutionContext, const AsyncCallHandlerOptions& options,
+            std::shared_ptr<AsyncCallHandlerStats> stats)
+        {
+            if (!handleFunc)
+                throw std::invalid_argument("Null handleFunc.");
+            if (options.pendingRequestCount == 0)
+                throw std::invalid_argument("At least one pending request is required.");
+
+            if (!stats)
+                stats = std::make_shared<AsyncCallHandlerStats>();
+
+            newCallHandler<Handler>(this, _completionQueue, service, requestFunc, std::move(handleFunc),
+                handleFuncExecutionContext, options, stats);
+            return stats;
+        }
+
         void shutdownCallHandlers()
         {
             for (auto h : _callHandlers)
@@ -0,0 +1,230 @@
+#pragma once
+
+#include "ShuHai/gRPC/Server/AsyncServerStreamWriter.h"
+#include "ShuHai/gRPC/Server/AsyncCallHandler.h"
+#include "ShuHai/gRPC/IAsyncAction.h"
+
+#include <memory>
+
+namespace ShuHai::gRPC::Server
+{
+    /**
+     * \brief Handles bidirectional streaming calls. Messages from the client are read one at a time and passed to the
+     *  stream handler, while messages to the client are written through the stream writer, a read and a write are
+     *  allowed to be in progress at the same time.
+     */
+    template<typename RequestFuncType>
+    class AsyncBidiStreamCallHandler : public AsyncCallHandler<RequestFuncType>
+    {
+    public:
+        SHUHAI_GRPC_SERVER_EXPAND_AsyncRequestTraits(RequestFuncType);
+
+        using StreamWriter = AsyncServerStreamWriter<RequestFunc>;
+
+        /**
+         * \brief Functions take care of messages read from a stream.
+         */
+        struct StreamHandler
+        {
+            /**
+             * \brief Called with each message read from the stream, the next message is not read until the function
+             *  returns.
+             */
+            std::function<void(const Request&)> onRead;
+
+            /**
+             * \brief Called once there is no more message to read, i.e. the client is done with writing or the call is
+             *  dead. The stream is finished by the stream writer.
+             */
+            std::function<void()> onReadDone;
+        };
+
+        /**
+         * \brief The function takes care of a new stream by returning the handler of its messages. The stream writer is
+         *  allowed to be kept and written at any time, the call ends when the writer finished.
+         */
+        using HandleFunc = std::function<StreamHandler(grpc::ServerContext&, std::shared_ptr<StreamWriter>)>;
+
+        AsyncBidiStreamCallHandler(gRPC::AsyncActionQueue* actionQueue, grpc::ServerCompletionQueue* completionQueue,
+            Service* service, RequestFunc requestFunc, HandleFunc handleFunc,
+            Executor handleFuncExecutionContext, const AsyncCallHandlerOptions& options,
+            std::shared_ptr<AsyncCallHandlerStats> stats)
+            : AsyncCallHandler<RequestFunc>(
+                actionQueue, completionQueue, service, requestFunc, options, std::move(stats))
+            , _handleFunc(std::move(handleFunc))
+            , _handleFuncExecutionContext(handleFuncExecutionContext)
+        {
+            for (size_t i = 0; i < this->_options.pendingRequestCount; ++i)
+                newCallRequest();
+        }
+
+    private:
+        struct Stream
+        {
+            explicit Stream(std::shared_ptr<StreamWriter> writer)
+                : writer(std::move(writer))
+            { }
+
+            const std::shared_ptr<StreamWriter> writer;
+            StreamHandler handler;
+            Request request;
+        };
+
+        class ServiceRequestAction : public IAsyncAction
+        {
+        public:
+            explicit ServiceRequestAction(AsyncBidiStreamCallHandler* handler)
+                : _handler(handler)
+                , _streamWriter(new StreamWriter(handler->_actionQueue, handler->_options.loadReporter))
+                , _doneAction(_streamWriter->notifyWhenDone())
+            {
+                auto service = handler->_service;
+                auto func = handler->_requestFunc;
+                auto cq = handler->_completionQueue;
+                (service->*func)(&_streamWriter->_context, &_streamWriter->_stream, cq, cq, this);
+            }
+
+            void finalizeResult(bool ok) override
+            {
+                // The done notification is not delivered since the call never started.
+                if (!ok)
+                    delete _doneAction;
+                _handler->finalizeCallRequest(std::move(_streamWriter), ok);
+            }
+
+        private:
+            AsyncBidiStreamCallHandler* const _handler;
+            std::shared_ptr<StreamWriter> _streamWriter;
+            IAsyncAction* const _doneAction;
+        };
+
+        class ReadAction : public IAsyncAction
+        {
+        public:
+            ReadAction(AsyncBidiStreamCallHandler* handler, std::shared_ptr<Stream> stream)
+                : _handler(handler)
+                , _stream(std::move(stream))
+            { }
+
+            bool perform()
+            {
+                auto& s = *_stream;
+                return s.writer->_actionQueue->tryStartOperation([&]() { s.writer->_stream.Read(&s.request, this); });
+            }
+
+            void finalizeResult(bool ok) override { _handler->finalizeRead(std::move(_stream), ok); }
+
+        private:
+            AsyncBidiStreamCallHandler* const _handler;
+            std::shared_ptr<Stream> _stream;
+        };
+
+        void newCallRequest() { new ServiceRequestAction(this); }
+
+        void finalizeCallRequest(std::shared_ptr<StreamWriter> streamWriter, bool ok)
+        {
+            // ok indicates that the RPC has indeed been started.
+            // If it is false, the server has been Shutdown before this particular call got matched to an incoming RPC.
+
+            if (!ok)
+                return;
+
+            this->_stats->consumedRequestCount.fetch_add(1, std::memory_order_relaxed);
+            newCallRequest();
+
+            streamWriter->_admission = this->admitCall();
+            if (!streamWriter->_admission)
+            {
+                streamWriter->finishIfNotRequested(this->shedStatus());
+                return;
+            }
+
+            this->dispatch(_handleFuncExecutionContext,
+                [this, stream = std::make_shared<Stream>(std::move(streamWriter))]()
+                {
+                    if (stream->writer->_context.cancelled())
+                    {
+                        this->_stats->cancelledCallCount.fetch_add(1, std::memory_order_relaxed);
+                        stream->writer->finishIfNotRequested(this->cancelledStatus());
+                        return;
+                    }
+
+                    try
+                    {
+                        stream->handler = _handleFunc(stream->writer->context(), stream->writer);
+                    }
+                    catch (...)
+                    {
+                        failStream(*stream);
+                        return;
+                    }
+                    newRead(stream);
+                });
+        }
+
+        // The stream is finished with the error of the handler, nothing more is read from it then.
+        void failStream(Stream& stream)
+        {
+            stream.writer->finishIfNotRequested(this->errorStatus(std::current_exception()));
+        }
+
+        void newRead(std::shared_ptr<Stream> stream)
+        {
+            auto action = new ReadAction(this, stream);
+            if (action->perform())
+                return;
+
+            delete action;
+            handleReadDone(std::move(stream));
+        }
+
+        void finalizeRead(std::shared_ptr<Stream> stream, bool ok)
+        {
+            // ok indicates whether there is a valid message that got read.
+            // If not, you know that there are certainly no more messages that can ever be read from this stream.
+            // This could happen because the client has done a WritesDone already.
+
+            if (!ok)
+            {
+                handleReadDone(std::move(stream));
+                return;
+            }
+
+            this->dispatch(_handleFuncExecutionContext,
+                [this, stream = std::move(stream)]()
+                {
+                    try
+                    {
+                        if (stream->handler.onRead)
+                            stream->handler.onRead(stream->request);
+                    }
+                    catch (...)
+                    {
+                        failStream(*stream);
+                        return;
+                    }
+                    newRead(stream);
+                });
+        }
+
+        void handleReadDone(std::shared_ptr<Stream> stream)
+        {
+            this->dispatch(_handleFuncExecutionContext,
+                [this, stream = std::move(stream)]()
+                {
+                    try
+                    {
+                        if (stream->handler.onReadDone)
+                            stream->handler.onReadDone();
+                    }
+                    catch (...)
+                    {
+                        failStream(*stream);
+                    }
+                });
+        }
+
+        HandleFunc _handleFunc;
+        Executor _handleFuncExecutionContext;
+    };
+}
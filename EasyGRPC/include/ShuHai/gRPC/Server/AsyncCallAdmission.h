@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ShuHai/gRPC/Server/AsyncCallHandlerStats.h"
+#include "ShuHai/gRPC/Server/AsyncConcurrencyLimiter.h"
+
+#include <memory>
+#include <chrono>
+#include <utility>
+
+namespace ShuHai::gRPC::Server
+{
+    /**
+     * \brief In-flight slot taken by an admitted call, the slot is released once the admission is reset or destroyed.
+     *  The time the call spent in flight is reported to the concurrency limiter, if any, unless the sample is
+     *  discarded.
+     */
+    class AsyncCallAdmission
+    {
+    public:
+        AsyncCallAdmission() = default;
+
+        explicit AsyncCallAdmission(
+            std::shared_ptr<AsyncCallHandlerStats> stats, AsyncConcurrencyLimiter* limiter = nullptr)
+            : _stats(std::move(stats))
+            , _limiter(limiter)
+        {
+            if (_limiter)
+                _startTime = std::chrono::steady_clock::now();
+        }
+
+        AsyncCallAdmission(AsyncCallAdmission&& other) noexcept
+            : _stats(std::move(other._stats))
+            , _limiter(std::exchange(other._limiter, nullptr))
+            , _startTime(other._startTime)
+        { }
+
+        AsyncCallAdmission& operator=(AsyncCallAdmission&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                _stats = std::move(other._stats);
+                _limiter = std::exchange(other._limiter, nullptr);
+                _startTime = other._startTime;
+            }
+            return *this;
+        }
+
+        AsyncCallAdmission(const AsyncCallAdmission&) = delete;
+        AsyncCallAdmission& operator=(const AsyncCallAdmission&) = delete;
+
+        ~AsyncCallAdmission() { reset(); }
+
+        explicit operator bool() const { return static_cast<bool>(_stats); }
+
+        /**
+         * \brief Keep the time in flight from the concurrency limiter, e.g. for a call dropped before it is handled,
+         *  whose time in flight says nothing about how long handling takes.
+         */
+        void discardSample() { _limiter = nullptr; }
+
+        void reset()
+        {
+            if (!_stats)
+                return;
+
+            auto inFlightCount = _stats->inFlightCallCount.fetch_sub(1, std::memory_order_acq_rel);
+            if (_limiter)
+                _limiter->addSample(std::chrono::steady_clock::now() - _startTime, inFlightCount);
+
+            _stats.reset();
+            _limiter = nullptr;
+        }
+
+    private:
+        std::shared_ptr<AsyncCallHandlerStats> _stats;
+        AsyncConcurrencyLimiter* _limiter {};
+        std::chrono::steady_clock::time_point _startTime;
+    };
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "ShuHai/gRPC/CancellationToken.h"
+
+#include <grpcpp/server_context.h>
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace ShuHai::gRPC::Server
+{
+    template<typename RequestFunc>
+    class AsyncUnaryCallHandler;
+
+    template<typename RequestFunc>
+    class AsyncClientStreamCallHandler;
+
+    template<typename RequestFunc>
+    class AsyncServerStreamWriter;
+
+    /**
+     * \brief Server context of the calls taken care of by call handlers, it tracks whether its call is cancelled by
+     *  the notification of the call being done.
+     */
+    class AsyncCallContext : public grpc::ServerContext
+    {
+    public:
+        AsyncCallContext()
+            : AsyncCallContext(std::make_shared<std::atomic_bool>(false))
+        { }
+
+        explicit AsyncCallContext(std::shared_ptr<std::atomic_bool> cancelled)
+            : _cancelled(std::move(cancelled))
+        { }
+
+        /**
+         * \brief Whether the call is known to be cancelled, e.g. the client has gone away or the deadline expired.
+         */
+        [[nodiscard]] bool cancelled() const { return _cancelled->load(std::memory_order_acquire); }
+
+        [[nodiscard]] CancellationToken cancellationToken() const { return CancellationToken(_cancelled); }
+
+    private:
+        template<typename RequestFunc>
+        friend class AsyncUnaryCallHandler;
+
+        template<typename RequestFunc>
+        friend class AsyncClientStreamCallHandler;
+
+        template<typename RequestFunc>
+        friend class AsyncServerStreamWriter;
+
+        // Must be called once the tag passed to AsyncNotifyWhenDone is delivered.
+        void notifyDone()
+        {
+            if (IsCancelled())
+                _cancelled->store(true, std::memory_order_release);
+        }
+
+        const std::shared_ptr<std::atomic_bool> _cancelled;
+    };
+
+    /**
+     * \brief Cancellation token of the call of the specified \p context, which is passed to a handle function. The
+     *  token of a context not made by call handlers is never cancelled.
+     */
+    inline CancellationToken cancellationToken(const grpc::ServerContext& context)
+    {
+        auto callContext = dynamic_cast<const AsyncCallContext*>(&context);
+        return callContext ? callContext->cancellationToken() : CancellationToken();
+    }
+}
@@ -1,17 +1,30 @@
 #pragma once
 
+#include "ShuHai/gRPC/Server/AsyncCallAdmission.h"
+#include "ShuHai/gRPC/Server/AsyncCallHandlerOptions.h"
+#include "ShuHai/gRPC/Server/AsyncCallHandlerStats.h"
 #include "ShuHai/gRPC/Server/TypeTraits.h"
+#include "ShuHai/gRPC/AsyncActionQueue.h"
+#include "ShuHai/gRPC/Executor.h"
 
 #include <grpcpp/completion_queue.h>
+#include <grpcpp/support/status.h>
 #include <google/protobuf/message.h>
 
+#include <memory>
+#include <exception>
+
 namespace ShuHai::gRPC::Server
 {
     class AsyncCallHandlerBase
     {
     public:
-        explicit AsyncCallHandlerBase(grpc::ServerCompletionQueue* completionQueue)
-            : _completionQueue(completionQueue)
+        AsyncCallHandlerBase(gRPC::AsyncActionQueue* actionQueue, grpc::ServerCompletionQueue* completionQueue,
+            const AsyncCallHandlerOptions& options, std::shared_ptr<AsyncCallHandlerStats> stats)
+            : _actionQueue(actionQueue)
+            , _completionQueue(completionQueue)
+            , _options(options)
+            , _stats(std::move(stats))
         { }
 
         virtual ~AsyncCallHandlerBase() = default;
@@ -19,7 +32,75 @@ namespace ShuHai::gRPC::Server
         virtual void shutdown() { }
 
     protected:
+        /**
+         * \brief Execute the specified function by the specified executor, or on the calling thread if the executor is
+         *  null.
+         */
+        template<typename Func>
+        static void dispatch(const Executor& executor, Func&& func)
+        {
+            executor.dispatch(std::forward<Func>(func));
+        }
+
+        /**
+         * \brief The status to finish a call with when its handling fails by the specified exception.
+         */
+        static grpc::Status errorStatus(const std::exception_ptr& error)
+        {
+            try
+            {
+                std::rethrow_exception(error);
+            }
+            catch (const std::exception& e)
+            {
+                return { grpc::StatusCode::UNKNOWN, e.what() };
+            }
+            catch (...)
+            {
+                return { grpc::StatusCode::UNKNOWN, "Unknown exception." };
+            }
+        }
+
+        /**
+         * \brief Take an in-flight slot for a new call. The returned admission is empty if the in-flight limit, or the
+         *  current limit of the specified \p limiter, is reached; the call is expected to be finished by shedStatus()
+         *  right away in that case.
+         */
+        AsyncCallAdmission admitCall(AsyncConcurrencyLimiter* limiter = nullptr)
+        {
+            auto inFlightCount = _stats->inFlightCallCount.fetch_add(1, std::memory_order_acq_rel) + 1;
+            auto maxCount = _options.maxInFlightCallCount;
+            if ((maxCount > 0 && inFlightCount > maxCount) || (limiter && inFlightCount > limiter->limit()))
+            {
+                _stats->inFlightCallCount.fetch_sub(1, std::memory_order_acq_rel);
+                _stats->shedCallCount.fetch_add(1, std::memory_order_relaxed);
+                return {};
+            }
+            _stats->acceptedCallCount.fetch_add(1, std::memory_order_relaxed);
+            return AsyncCallAdmission(_stats, limiter);
+        }
+
+        /**
+         * \brief Attach the load of the server to the trailing metadata of the call of the specified \p context if
+         *  enabled by AsyncCallHandlerOptions::loadReporter, which must happen before the call is finished.
+         */
+        void reportLoad(grpc::ServerContext& context) const
+        {
+            if (_options.loadReporter)
+                _options.loadReporter->report(context);
+        }
+
+        static grpc::Status cancelledStatus() { return { grpc::StatusCode::CANCELLED, "The call is cancelled." }; }
+
+        static grpc::Status shedStatus()
+        {
+            return { grpc::StatusCode::RESOURCE_EXHAUSTED, "Too many calls in flight, try again later." };
+        }
+
+        gRPC::AsyncActionQueue* const _actionQueue;
         grpc::ServerCompletionQueue* const _completionQueue;
+        const AsyncCallHandlerOptions _options;
+        const std::shared_ptr<AsyncCallHandlerStats> _stats;
     };
 
     template<typename RequestFuncType>
@@ -29,8 +110,10 @@ namespace ShuHai::gRPC::Server
         SHUHAI_GRPC_SERVER_EXPAND_AsyncRequestTraits(RequestFuncType);
 
     protected:
-        AsyncCallHandler(grpc::ServerCompletionQueue* completionQueue, Service* service, RequestFunc requestFunc)
-            : AsyncCallHandlerBase(completionQueue)
+        AsyncCallHandler(gRPC::AsyncActionQueue* actionQueue, grpc::ServerCompletionQueue* completionQueue,
+            Service* service, RequestFunc requestFunc, const AsyncCallHandlerOptions& options,
+            std::shared_ptr<AsyncCallHandlerStats> stats)
+            : AsyncCallHandlerBase(actionQueue, completionQueue, options, std::move(stats))
             , _service(service)
             , _requestFunc(requestFunc)
         { }
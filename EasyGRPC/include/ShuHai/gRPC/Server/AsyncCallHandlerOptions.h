@@ -0,0 +1,92 @@
+#pragma once
+
+#include "ShuHai/gRPC/Server/AsyncConcurrencyLimiter.h"
+#include "ShuHai/gRPC/Server/AsyncQueueDelayController.h"
+#include "ShuHai/gRPC/Server/AsyncServerLoadReporter.h"
+
+#include <cstddef>
+#include <memory>
+
+namespace ShuHai::gRPC::Server
+{
+    /**
+     * \brief Ways to finish a call once its response is made.
+     */
+    enum class AsyncCallFinishMode
+    {
+        /**
+         * \brief Get back to the completion queue thread through an alarm and finish the call there.
+         */
+        CompletionQueue,
+
+        /**
+         * \brief Finish the call right on the thread that made the response, which saves a completion queue round trip
+         *  per call.
+         */
+        Direct
+    };
+
+    /**
+     * \brief Options of a call handler, they apply to each completion queue the handler is registered on.
+     */
+    struct AsyncCallHandlerOptions
+    {
+        /**
+         * \brief Number of call requests kept outstanding on each completion queue. Each consumed request is replaced
+         *  by a new one, so up to this number of incoming calls are matched without waiting for a request to be posted.
+         */
+        size_t pendingRequestCount = 1;
+
+        /**
+         * \brief Maximum number of finished calls kept for reuse on each completion queue. Only applies to unary calls.
+         */
+        size_t callPoolCapacity = 256;
+
+        /**
+         * \brief Size in bytes of the initial arena block owned by each pooled call, requests and responses are
+         *  allocated on the arena. Only applies to unary calls.
+         */
+        size_t arenaInitialBlockSize = 1024;
+
+        /**
+         * \brief How calls are finished once their responses are made. Only applies to unary calls.
+         */
+        AsyncCallFinishMode finishMode = AsyncCallFinishMode::CompletionQueue;
+
+        /**
+         * \brief Maximum number of calls being handled at the same time, calls beyond the limit are rejected with
+         *  RESOURCE_EXHAUSTED right after they arrive, without being passed to the handle function. The limit is shared
+         *  by the handlers sharing the same statistics, i.e. by all completion queues of a handler registered on the
+         *  server. Zero means unlimited.
+         */
+        size_t maxInFlightCallCount = 0;
+
+        /**
+         * \brief Limiter that adapts the number of calls allowed in flight to the latency of calls, calls beyond its
+         *  current limit are rejected the same way as maxInFlightCallCount, which still caps the limit if not zero.
+         *  The limiter is shared by the completion queues a handler is registered on, and is not expected to be shared
+         *  by different handlers. Only applies to unary calls.
+         */
+        std::shared_ptr<AsyncConcurrencyLimiter> concurrencyLimiter;
+
+        /**
+         * \brief Controller that drops calls waited too long in the handle function execution context, they are
+         *  finished with RESOURCE_EXHAUSTED instead of being handled. Only applies to unary calls.
+         */
+        std::shared_ptr<AsyncQueueDelayController> queueDelayController;
+
+        /**
+         * \brief Whether calls whose deadline has passed by the time they are about to be handled are finished with
+         *  DEADLINE_EXCEEDED instead of being handled, since their callers have already given up. Only applies to
+         *  unary calls.
+         */
+        bool skipExpiredCalls = true;
+
+        /**
+         * \brief Reporter that attaches the load of the server to the trailing metadata of each finished call, nothing
+         *  is attached if null. AsyncServer sets its own reporter for the handlers registered on it if
+         *  AsyncServerOptions::reportLoad is set and the handler has none.
+         */
+        std::shared_ptr<AsyncServerLoadReporter> loadReporter;
+    };
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace ShuHai::gRPC::Server
+{
+    /**
+     * \brief Statistics of a call handler, shared by the handler instances on all completion queues it is registered
+     *  on.
+     */
+    struct AsyncCallHandlerStats
+    {
+        /**
+         * \brief Number of call requests that got matched to an incoming call.
+         */
+        std::atomic<uint64_t> consumedRequestCount {};
+
+        /**
+         * \brief Number of incoming calls that got admitted and handled.
+         */
+        std::atomic<uint64_t> acceptedCallCount {};
+
+        /**
+         * \brief Number of incoming calls that got rejected with RESOURCE_EXHAUSTED since the in-flight limit was
+         *  reached, they are never passed to the handle function.
+         */
+        std::atomic<uint64_t> shedCallCount {};
+
+        /**
+         * \brief Number of admitted calls that are not yet finished.
+         */
+        std::atomic<uint64_t> inFlightCallCount {};
+
+        /**
+         * \brief Number of admitted calls dropped without being handled, since they were cancelled.
+         */
+        std::atomic<uint64_t> cancelledCallCount {};
+
+        /**
+         * \brief Number of admitted calls dropped without being handled, since their deadlines had passed.
+         */
+        std::atomic<uint64_t> expiredCallCount {};
+
+        /**
+         * \brief Number of admitted calls dropped without being handled, since they waited too long in the execution
+         *  context.
+         */
+        std::atomic<uint64_t> delayedCallCount {};
+
+        /**
+         * \brief Total time in nanoseconds that calls waited in the execution context before being handled.
+         */
+        std::atomic<uint64_t> queueDelayNanoseconds {};
+    };
+}
@@ -1,112 +1,302 @@
 #pragma once
 
-#include "ShuHai/gRPC/Server/AsyncClientStreamReader.h"
 #include "ShuHai/gRPC/Server/AsyncCallHandler.h"
+#include "ShuHai/gRPC/Server/AsyncCallContext.h"
+#include "ShuHai/gRPC/IAsyncAction.h"
 
-#include <unordered_set>
+#include <functional>
+#include <atomic>
 
 namespace ShuHai::gRPC::Server
 {
+    /**
+     * \brief Handles client streaming calls. Messages from the client are read one at a time and passed to the stream
+     *  handler, no thread is blocked while waiting for messages, the call is finished with the response made by the
+     *  stream handler once all messages are read.
+     */
     template<typename RequestFuncType>
     class AsyncClientStreamCallHandler : public AsyncCallHandler<RequestFuncType>
     {
     public:
         SHUHAI_GRPC_SERVER_EXPAND_AsyncRequestTraits(RequestFuncType);
 
-        using StreamReader = AsyncClientStreamReader<RequestFunc>;
-        using HandleFunc = std::function<Response(grpc::ServerContext&, StreamReader&)>;
+        /**
+         * \brief Functions take care of messages read from a stream.
+         */
+        struct StreamHandler
+        {
+            /**
+             * \brief Called with each message read from the stream, the next message is not read until the function
+             *  returns.
+             */
+            std::function<void(const Request&)> onRead;
+
+            /**
+             * \brief Called once there is no more message to read, the returned response finishes the call. A default
+             *  constructed response is used if the function is null.
+             */
+            std::function<Response()> onReadDone;
+        };
+
+        /**
+         * \brief The function takes care of a new stream by returning the handler of its messages.
+         */
+        using HandleFunc = std::function<StreamHandler(grpc::ServerContext&)>;
 
-        AsyncClientStreamCallHandler(grpc::ServerCompletionQueue* completionQueue, Service* service,
-            RequestFunc requestFunc, HandleFunc handleFunc)
-            : AsyncCallHandler<RequestFunc>(completionQueue, service, requestFunc)
-            , _service(service)
-            , _handleFunc(handleFunc)
+        AsyncClientStreamCallHandler(gRPC::AsyncActionQueue* actionQueue, grpc::ServerCompletionQueue* completionQueue,
+            Service* service, RequestFunc requestFunc, HandleFunc handleFunc,
+            Executor handleFuncExecutionContext, const AsyncCallHandlerOptions& options,
+            std::shared_ptr<AsyncCallHandlerStats> stats)
+            : AsyncCallHandler<RequestFunc>(
+                actionQueue, completionQueue, service, requestFunc, options, std::move(stats))
+            , _handleFunc(std::move(handleFunc))
+            , _handleFuncExecutionContext(handleFuncExecutionContext)
         {
-            new RequestStreamAction(this);
+            for (size_t i = 0; i < this->_options.pendingRequestCount; ++i)
+                newCallRequest();
         }
 
     private:
-        class Action : public IAsyncAction
+        struct Call;
+
+        class CallHandlerAction : public IAsyncAction
         {
         public:
-            explicit Action(AsyncClientStreamCallHandler* owner)
-                : _owner(owner)
+            CallHandlerAction(AsyncClientStreamCallHandler* handler, Call* call)
+                : _handler(handler)
+                , _call(call)
             { }
 
         protected:
-            AsyncClientStreamCallHandler* const _owner;
+            // The action is embedded in its call, thus it is not deleted by the queue.
+            void* tag() { return gRPC::AsyncActionQueue::embeddedTag(this); }
+
+            AsyncClientStreamCallHandler* const _handler;
+            Call* const _call;
         };
 
-        class RequestStreamAction : public Action
+        class ServiceRequestAction : public CallHandlerAction
         {
         public:
-            explicit RequestStreamAction(AsyncClientStreamCallHandler* owner)
-                : Action(owner)
+            using CallHandlerAction::CallHandlerAction;
+
+            void perform()
             {
-                auto service = owner->_service;
-                auto func = owner->_requestFunc;
-                auto cq = owner->_completionQueue;
+                auto call = this->_call;
+                auto service = this->_handler->_service;
+                auto func = this->_handler->_requestFunc;
+                auto cq = this->_handler->_completionQueue;
+                (service->*func)(&call->context, &call->stream, cq, cq, this->tag());
+            }
 
-                _streamReader =
-                    new StreamReader(service, cq, [this](auto r) { this->_owner->onStreamReaderFinished(r); });
-                auto& context = _streamReader->_context;
-                auto& stream = _streamReader->_stream;
+            void finalizeResult(bool ok) override { this->_handler->finalizeCallRequest(this->_call, ok); }
+        };
 
-                (service->*func)(&context, &stream, cq, cq, this);
-            }
+        class ReadAction : public CallHandlerAction
+        {
+        public:
+            using CallHandlerAction::CallHandlerAction;
 
-            void finalizeResult(bool ok) override
+            bool perform()
             {
-                // ok indicates that the RPC has indeed been started.
-                // If it is false, the server has been Shutdown before this particular call got matched to an incoming RPC.
-
-                if (ok)
-                    this->_owner->onNewStreamReaderReady(_streamReader);
-                else
-                    delete _streamReader;
+                auto call = this->_call;
+                return this->_handler->_actionQueue->tryStartOperation(
+                    [&]() { call->stream.Read(&call->request, this->tag()); });
             }
 
-        private:
-            StreamReader* _streamReader {};
+            void finalizeResult(bool ok) override { this->_handler->finalizeRead(this->_call, ok); }
         };
 
-        class HandleStreamAction : public Action
+        class CallFinishAction : public CallHandlerAction
         {
         public:
-            explicit HandleStreamAction(AsyncClientStreamCallHandler* owner)
-                : Action(owner)
-            { }
+            using CallHandlerAction::CallHandlerAction;
 
-            void finalizeResult(bool ok) override { }
+            bool perform(const grpc::Status& status)
+            {
+                auto call = this->_call;
+                return this->_handler->_actionQueue->tryStartOperation(
+                    [&]() { call->stream.Finish(call->response, status, this->tag()); });
+            }
+
+            void finalizeResult(bool ok) override { this->_handler->finalizeCallFinish(this->_call, ok); }
         };
 
-        class FinishAction : public Action
+        class CallDoneAction : public CallHandlerAction
         {
         public:
-            explicit FinishAction(AsyncClientStreamCallHandler* owner)
-                : Action(owner)
+            using CallHandlerAction::CallHandlerAction;
+
+            void perform() { this->_call->context.AsyncNotifyWhenDone(this->tag()); }
+
+            void finalizeResult(bool ok) override { this->_handler->finalizeCallDone(this->_call); }
+        };
+
+        // At most one operation of a call is in progress at the same time, the action of each operation is embedded
+        // in the call and reused.
+        struct Call
+        {
+            explicit Call(AsyncClientStreamCallHandler* handler)
+                : requestAction(handler, this)
+                , readAction(handler, this)
+                , finishAction(handler, this)
+                , doneAction(handler, this)
+                , stream(&context)
             { }
 
-            void finalizeResult(bool ok) override { }
+            ServiceRequestAction requestAction;
+            ReadAction readAction;
+            CallFinishAction finishAction;
+            CallDoneAction doneAction;
+            AsyncCallAdmission admission;
+
+            // A started call is deleted once it is finished and the done notification is delivered, in either order.
+            std::atomic<int> pendingCompletionCount { 2 };
+
+            AsyncCallContext context;
+            StreamingInterface stream;
+            StreamHandler handler;
+            Request request;
+            Response response;
         };
 
-        void onNewStreamReaderReady(StreamReader* streamReader)
+        void newCallRequest()
+        {
+            auto call = new Call(this);
+            call->doneAction.perform();
+            call->requestAction.perform();
+        }
+
+        void finalizeCallRequest(Call* call, bool ok)
+        {
+            // ok indicates that the RPC has indeed been started.
+            // If it is false, the server has been Shutdown before this particular call got matched to an incoming RPC.
+
+            if (!ok)
+            {
+                // The done notification is not delivered since the call never started.
+                delete call;
+                return;
+            }
+
+            this->_stats->consumedRequestCount.fetch_add(1, std::memory_order_relaxed);
+            newCallRequest();
+
+            call->admission = this->admitCall();
+            if (!call->admission)
+            {
+                newCallFinish(call, this->shedStatus());
+                return;
+            }
+
+            this->dispatch(_handleFuncExecutionContext,
+                [this, call]()
+                {
+                    if (call->context.cancelled())
+                    {
+                        this->_stats->cancelledCallCount.fetch_add(1, std::memory_order_relaxed);
+                        newCallFinish(call, this->cancelledStatus());
+                        return;
+                    }
+
+                    try
+                    {
+                        call->handler = _handleFunc(call->context);
+                    }
+                    catch (...)
+                    {
+                        failCall(call);
+                        return;
+                    }
+                    newRead(call);
+                });
+        }
+
+        // Reads and finishes are started from the handle function execution context, which may happen after the
+        // completion queue is shut down, the call is dropped in that case.
+
+        void newRead(Call* call)
         {
-            new RequestStreamAction(this);
+            if (!call->readAction.perform())
+                completeCall(call);
+        }
 
-            _streamReaders.emplace(streamReader);
-            //auto response = _handleFunc(streamReader->_context, *streamReader);
-            assert("Not implemented");
+        void finalizeRead(Call* call, bool ok)
+        {
+            // ok indicates whether there is a valid message that got read.
+            // If not, you know that there are certainly no more messages that can ever be read from this stream.
+            // This could happen because the client has done a WritesDone already.
+
+            if (ok)
+            {
+                this->dispatch(_handleFuncExecutionContext,
+                    [this, call]()
+                    {
+                        try
+                        {
+                            if (call->handler.onRead)
+                                call->handler.onRead(call->request);
+                        }
+                        catch (...)
+                        {
+                            failCall(call);
+                            return;
+                        }
+                        newRead(call);
+                    });
+            }
+            else
+            {
+                this->dispatch(_handleFuncExecutionContext,
+                    [this, call]()
+                    {
+                        try
+                        {
+                            if (call->handler.onReadDone)
+                                call->response = call->handler.onReadDone();
+                        }
+                        catch (...)
+                        {
+                            failCall(call);
+                            return;
+                        }
+                        newCallFinish(call, grpc::Status::OK);
+                    });
+            }
+        }
+
+        // The call is finished with the error of the handler, nothing more is read from it then.
+        void failCall(Call* call) { newCallFinish(call, this->errorStatus(std::current_exception())); }
+
+        void newCallFinish(Call* call, const grpc::Status& status)
+        {
+            this->reportLoad(call->context);
+            if (!call->finishAction.perform(status))
+                completeCall(call);
+        }
+
+        void finalizeCallFinish(Call* call, bool ok)
+        {
+            // ok means that the data/metadata/status/etc is going to go to the wire.
+            // If it is false, it not going to the wire because the call is already dead (i.e., canceled, deadline
+            // expired, other side dropped the channel, etc).
+
+            completeCall(call);
+        }
+
+        void finalizeCallDone(Call* call)
+        {
+            call->context.notifyDone();
+            completeCall(call);
         }
 
-        void onStreamReaderFinished(StreamReader* streamReader)
+        void completeCall(Call* call)
         {
-            _streamReaders.erase(streamReader);
-            delete streamReader;
+            if (call->pendingCompletionCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                delete call;
         }
 
-        Service* const _service;
         HandleFunc _handleFunc;
-        std::unordered_set<StreamReader*> _streamReaders;
+        Executor _handleFuncExecutionContext;
     };
 }
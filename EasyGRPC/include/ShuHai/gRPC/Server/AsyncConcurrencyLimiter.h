@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace ShuHai::gRPC::Server
+{
+    /**
+     * \brief Concurrency limit that adapts to the latency of calls, in the way of TCP Vegas. The number of calls queued
+     *  up somewhere is estimated from how much the recent latency exceeds the latency without load: the limit grows
+     *  while few calls are queued and shrinks once too many are. The latency without load is measured again once in
+     *  a while by halving the limit for a window, so that the limit follows changes of the service.
+     *  A limiter is shared by all completion queues of the handler it is set to, see
+     *  AsyncCallHandlerOptions::concurrencyLimiter.
+     */
+    class AsyncConcurrencyLimiter
+    {
+    public:
+        struct Options
+        {
+            size_t initialLimit = 20;
+            size_t minLimit = 1;
+            size_t maxLimit = 1000;
+
+            /**
+             * \brief Number of finished calls that make up a sample window, the limit is updated once per window.
+             */
+            size_t windowSampleCount = 32;
+
+            /**
+             * \brief Number of windows between two measurements of the latency without load.
+             */
+            size_t probeIntervalWindowCount = 100;
+        };
+
+        AsyncConcurrencyLimiter()
+            : AsyncConcurrencyLimiter(Options())
+        { }
+
+        explicit AsyncConcurrencyLimiter(const Options& options)
+            : _options(options)
+            , _limit(options.initialLimit)
+            , _estimatedLimit(static_cast<double>(options.initialLimit))
+        {
+            if (options.minLimit == 0 || options.minLimit > options.maxLimit)
+                throw std::invalid_argument("Invalid range of concurrency limit.");
+            if (options.initialLimit < options.minLimit || options.initialLimit > options.maxLimit)
+                throw std::invalid_argument("Initial concurrency limit is out of range.");
+            if (options.windowSampleCount == 0 || options.probeIntervalWindowCount == 0)
+                throw std::invalid_argument("Window sizes of concurrency limiter must be greater than zero.");
+        }
+
+        AsyncConcurrencyLimiter(const AsyncConcurrencyLimiter&) = delete;
+        AsyncConcurrencyLimiter& operator=(const AsyncConcurrencyLimiter&) = delete;
+
+        [[nodiscard]] const Options& options() const { return _options; }
+
+        /**
+         * \brief Current number of calls allowed to be in flight at the same time.
+         */
+        [[nodiscard]] size_t limit() const { return _limit.load(std::memory_order_relaxed); }
+
+        /**
+         * \brief Add the latency of a finished call, with the number of calls that were in flight when it finished.
+         */
+        void addSample(std::chrono::nanoseconds latency, size_t inFlightCount)
+        {
+            // Samples are statistical, dropping a few of them is better than making calls wait for each other.
+            std::unique_lock l(_mutex, std::try_to_lock);
+            if (!l.owns_lock())
+                return;
+
+            double seconds = std::chrono::duration<double>(latency).count();
+            _windowLatencySum += seconds;
+            _windowMinLatency = _windowSampleCount > 0 ? std::min(_windowMinLatency, seconds) : seconds;
+            _windowMaxInFlightCount = std::max(_windowMaxInFlightCount, inFlightCount);
+            if (++_windowSampleCount < _options.windowSampleCount)
+                return;
+
+            updateLimit(_windowLatencySum / static_cast<double>(_windowSampleCount));
+            _windowLatencySum = 0;
+            _windowSampleCount = 0;
+            _windowMaxInFlightCount = 0;
+        }
+
+    private:
+        // Must be called with _mutex locked.
+        void updateLimit(double latency)
+        {
+            if (_probing)
+            {
+                // The queue is mostly drained while the limit is halved.
+                _probing = false;
+                _noLoadLatency = _windowMinLatency;
+                publishLimit();
+                return;
+            }
+
+            if (_noLoadLatency <= 0 || _windowMinLatency < _noLoadLatency)
+                _noLoadLatency = _windowMinLatency;
+
+            if (++_windowCountSinceProbe >= _options.probeIntervalWindowCount)
+            {
+                _windowCountSinceProbe = 0;
+                _probing = true;
+                _limit.store(std::max(_options.minLimit, _limit.load(std::memory_order_relaxed) / 2),
+                    std::memory_order_relaxed);
+                return;
+            }
+
+            // The limit is not updated unless it is actually hit, otherwise it would grow without bound while the
+            // load is light.
+            if (latency <= 0 || static_cast<double>(_windowMaxInFlightCount) < _estimatedLimit / 2)
+                return;
+
+            double step = std::max(1.0, std::log10(_estimatedLimit));
+            double queueSize = _estimatedLimit * (1 - _noLoadLatency / latency);
+            if (queueSize <= step)
+                _estimatedLimit += 6 * step;
+            else if (queueSize < 3 * step)
+                _estimatedLimit += step;
+            else if (queueSize > 6 * step)
+                _estimatedLimit -= step;
+            _estimatedLimit = std::clamp(
+                _estimatedLimit, static_cast<double>(_options.minLimit), static_cast<double>(_options.maxLimit));
+            publishLimit();
+        }
+
+        void publishLimit() { _limit.store(static_cast<size_t>(_estimatedLimit), std::memory_order_relaxed); }
+
+        const Options _options;
+        std::atomic<size_t> _limit;
+
+        std::mutex _mutex;
+        double _estimatedLimit;
+        double _noLoadLatency {};
+        bool _probing {};
+        size_t _windowCountSinceProbe {};
+        double _windowLatencySum {};
+        double _windowMinLatency {};
+        size_t _windowSampleCount {};
+        size_t _windowMaxInFlightCount {};
+    };
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+namespace ShuHai::gRPC::Server
+{
+    /**
+     * \brief Decides whether a call is dropped by the time it waited in the execution context before being handled, in
+     *  the controlled delay (CoDel) way adapted to servers: the execution context is considered overloaded once the
+     *  shortest wait during an interval exceeds the target, i.e. the queue never drained during the interval. Calls
+     *  that waited longer than the interval are dropped, and calls that waited longer than the target are dropped too
+     *  while overloaded, so a standing queue is cut down quickly while bursts are still absorbed.
+     *  A controller is shared by all completion queues of the handler it is set to, see
+     *  AsyncCallHandlerOptions::queueDelayController.
+     */
+    class AsyncQueueDelayController
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        struct Options
+        {
+            /**
+             * \brief Acceptable wait of a call in the execution context.
+             */
+            Clock::duration target = std::chrono::milliseconds(5);
+
+            /**
+             * \brief Period over which the shortest wait is measured, it is also the longest wait allowed while not
+             *  overloaded.
+             */
+            Clock::duration interval = std::chrono::milliseconds(100);
+        };
+
+        AsyncQueueDelayController()
+            : AsyncQueueDelayController(Options())
+        { }
+
+        explicit AsyncQueueDelayController(const Options& options)
+            : _options(options)
+        {
+            if (options.target <= Clock::duration::zero() || options.interval < options.target)
+                throw std::invalid_argument("Invalid target or interval of queue delay controller.");
+        }
+
+        AsyncQueueDelayController(const AsyncQueueDelayController&) = delete;
+        AsyncQueueDelayController& operator=(const AsyncQueueDelayController&) = delete;
+
+        [[nodiscard]] const Options& options() const { return _options; }
+
+        /**
+         * \brief Whether the execution context is overloaded by the waits seen during the last interval.
+         */
+        [[nodiscard]] bool overloaded() const
+        {
+            std::lock_guard l(_mutex);
+            return _overloaded;
+        }
+
+        /**
+         * \brief Whether a call that has waited for the specified \p delay until \p now should be dropped.
+         */
+        bool shouldDrop(Clock::duration delay, Clock::time_point now)
+        {
+            std::lock_guard l(_mutex);
+            if (now >= _intervalEnd)
+            {
+                // No call during a whole interval means the queue is drained.
+                bool idle = now - _intervalEnd >= _options.interval;
+                _overloaded = !idle && _intervalEnd != Clock::time_point() && _minDelay > _options.target;
+                _minDelay = delay;
+                _intervalEnd = now + _options.interval;
+            }
+            else
+            {
+                _minDelay = std::min(_minDelay, delay);
+            }
+            return delay > (_overloaded ? _options.target : _options.interval);
+        }
+
+    private:
+        const Options _options;
+
+        mutable std::mutex _mutex;
+        Clock::time_point _intervalEnd;
+        Clock::duration _minDelay {};
+        bool _overloaded {};
+    };
+}
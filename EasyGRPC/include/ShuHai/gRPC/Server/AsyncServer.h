@@ -1,11 +1,21 @@
 #pragma once
 
 #include "ShuHai/gRPC/Server/AsyncActionQueue.h"
+#include "ShuHai/gRPC/Server/AsyncServerOptions.h"
+#include "ShuHai/gRPC/Server/AsyncServerStopStats.h"
+#include "ShuHai/gRPC/Server/AsyncServerLoadReporter.h"
+#include "ShuHai/gRPC/WorkStealingThreadPool.h"
+#include "ShuHai/gRPC/AsyncActionQueuePoller.h"
+#include "ShuHai/gRPC/ThreadAffinity.h"
 
 #include <grpcpp/grpcpp.h>
 
 #include <thread>
+#include <future>
+#include <mutex>
+#include <chrono>
 #include <unordered_set>
+#include <algorithm>
 #include <vector>
 #include <utility>
 #include <type_traits>
@@ -17,24 +27,44 @@ namespace ShuHai::gRPC::Server
     {
     public:
         explicit AsyncServer(const std::vector<std::string>& listeningUris, size_t numCompletionQueues = 1)
+            : AsyncServer(listeningUris, makeOptions(numCompletionQueues))
+        { }
+
+        AsyncServer(const std::vector<std::string>& listeningUris, const AsyncServerOptions& options)
         {
             if (listeningUris.empty())
                 throw std::invalid_argument("At least one listening uri is required.");
 
+            size_t numCompletionQueues = options.completionQueueCount;
             if (numCompletionQueues == 0)
                 numCompletionQueues = std::thread::hardware_concurrency();
 
+            if (!options.inlineHandlers)
+                _handlerThreadPool = std::make_unique<WorkStealingThreadPool>(options.handlerThreadPool);
+
             grpc::ServerBuilder builder;
-            for (const auto& uri : listeningUris)
-                builder.AddListeningPort(uri, grpc::InsecureServerCredentials());
+            _selectedPorts.resize(listeningUris.size());
+            for (size_t i = 0; i < listeningUris.size(); ++i)
+                builder.AddListeningPort(listeningUris[i], grpc::InsecureServerCredentials(), &_selectedPorts[i]);
             foreachService([&](auto s) { builder.RegisterService(s); });
 
+            if (options.pollers.threadCount == 0)
+                throw std::invalid_argument("At least one polling thread per completion queue is required.");
+            _pollerOptions = options.pollers;
+
             for (size_t i = 0; i < numCompletionQueues; ++i)
-                _asyncActionQueues.emplace_back(std::make_unique<AsyncActionQueue>(builder.AddCompletionQueue()));
+            {
+                _asyncActionQueues.emplace_back(invokeOnCpus(_pollerOptions.cpusOf(i),
+                    [&builder]() { return std::make_unique<AsyncActionQueue>(builder.AddCompletionQueue()); }));
+            }
 
             _server = builder.BuildAndStart();
             if (!_server)
                 throw std::logic_error("Build rpc server failed.");
+
+            _reportLoad = options.reportLoad;
+            _loadReporter = std::make_shared<AsyncServerLoadReporter>(
+                [this]() { return sampleLoad(); }, options.loadRefreshInterval);
         }
 
         explicit AsyncServer(uint16_t port)
@@ -43,51 +73,181 @@ namespace ShuHai::gRPC::Server
 
         ~AsyncServer() { stop(); }
 
+        /**
+         * \brief Start polling the completion queues. A stopped server is not allowed to start again.
+         */
         void start()
         {
             if (started())
                 throw std::logic_error("The server already started.");
+            if (stopped())
+                throw std::logic_error("The server already stopped.");
 
-            for (auto& queue : _asyncActionQueues)
             {
-                auto t = std::make_unique<std::thread>(
-                    [&queue]()
-                    {
-                        while (queue->asyncNext() != grpc::CompletionQueue::SHUTDOWN)
-                            continue;
-                    });
-                _asyncActionThreads.emplace_back(std::move(t));
+                std::lock_guard l(_pollersMutex);
+                for (size_t i = 0; i < _asyncActionQueues.size(); ++i)
+                {
+                    _pollers.emplace_back(
+                        std::make_unique<AsyncActionQueuePoller>(*_asyncActionQueues[i], _pollerOptions, i));
+                }
             }
 
             _started = true;
         }
 
-        void stop()
+        /**
+         * \brief Stop the server after all the calls in flight complete, see
+         *  stop(std::chrono::system_clock::time_point).
+         */
+        AsyncServerStopStats stop() { return stop(std::chrono::system_clock::time_point::max()); }
+
+        /**
+         * \brief Stop the server, calls in flight are given the specified \p gracePeriod to complete, see
+         *  stop(std::chrono::system_clock::time_point).
+         */
+        AsyncServerStopStats stop(std::chrono::nanoseconds gracePeriod)
         {
+            return stop(std::chrono::system_clock::now()
+                + std::chrono::duration_cast<std::chrono::system_clock::duration>(gracePeriod));
+        }
+
+        /**
+         * \brief Stop the server. New calls are rejected right away, calls in flight are given until the specified
+         *  \p deadline to complete and cancelled beyond. The function returns once the completion queues are drained
+         *  and the polling threads and the handler threads exit, which wait in blocking calls rather than spinning.
+         *  Calling it on a stopped server takes no effect.
+         * \return Statistics of the calls in flight while stopping, all zero if the server is already stopped.
+         */
+        AsyncServerStopStats stop(std::chrono::system_clock::time_point deadline)
+        {
+            AsyncServerStopStats stats;
+            if (_stopped.exchange(true))
+                return stats;
+
+            auto startTime = std::chrono::steady_clock::now();
+            stats.inFlightCallCount = inFlightCallCount();
+
+            // Calls never got polled on a server that never started, thus there is nothing to wait for.
             if (!started())
-                return;
+                deadline = std::chrono::system_clock::now();
+
+            // Calls still in flight at the deadline are the ones cancelled by the server.
+            auto shutdown = std::async(std::launch::async, [this, deadline]() { _server->Shutdown(deadline); });
+            bool bounded = deadline != std::chrono::system_clock::time_point::max();
+            if (bounded && shutdown.wait_until(deadline) == std::future_status::timeout)
+                stats.abortedCallCount = std::min(inFlightCallCount(), stats.inFlightCallCount);
+            shutdown.get();
+            stats.drainedCallCount = stats.inFlightCallCount - stats.abortedCallCount;
 
-            _server->Shutdown();
-            for (auto& w : _asyncActionQueues)
-                w->shutdown();
+            // The load is sampled from the polling threads, which are about to exit.
+            _loadReporter->stop();
 
-            for (auto& t : _asyncActionThreads)
-                t->join();
-            _asyncActionThreads.clear();
+            for (auto& q : _asyncActionQueues)
+                q->shutdown();
+
+            if (started())
+            {
+                decltype(_pollers) pollers;
+                {
+                    std::lock_guard l(_pollersMutex);
+                    pollers.swap(_pollers);
+                }
+                pollers.clear();
+            }
+            else
+            {
+                for (auto& q : _asyncActionQueues)
+                    q->drain();
+            }
+
+            // Handle functions still running refer to the calls owned by the queues.
+            if (_handlerThreadPool)
+                _handlerThreadPool->join();
 
             _server = nullptr;
             _asyncActionQueues.clear();
+            _started = false;
+
+            stats.duration = std::chrono::steady_clock::now() - startTime;
+            return stats;
         }
 
         [[nodiscard]] bool started() const { return _started; }
 
+        [[nodiscard]] bool stopped() const { return _stopped; }
+
+        /**
+         * \brief Number of calls in flight across all the registered call handlers.
+         */
+        [[nodiscard]] uint64_t inFlightCallCount() const
+        {
+            std::lock_guard l(_handlerStatsMutex);
+            uint64_t count = 0;
+            for (const auto& stats : _handlerStats)
+                count += stats->inFlightCallCount.load(std::memory_order_acquire);
+            return count;
+        }
+
+        /**
+         * \brief Ports the server listens on, one per listening uri in the same order, e.g. the port picked by the
+         *  system for a uri of port 0. Zero for a uri that failed to bind.
+         */
+        [[nodiscard]] const std::vector<int>& selectedPorts() const { return _selectedPorts; }
+
+        /**
+         * \brief Number of completion queues of the server, each of them is polled by its own threads.
+         */
+        [[nodiscard]] size_t completionQueueCount() const { return _asyncActionQueues.size(); }
+
+        /**
+         * \brief Number of threads currently polling the completion queues, which changes with the load if
+         *  PollerOptions::maxThreadCount is set, see AsyncServerOptions::pollers.
+         */
+        [[nodiscard]] size_t pollerThreadCount() const
+        {
+            std::lock_guard l(_pollersMutex);
+            size_t count = 0;
+            for (const auto& poller : _pollers)
+                count += poller->threadCount();
+            return count;
+        }
+
+        /**
+         * \brief The thread pool that runs handle functions registered without an execution context, null if they run
+         *  on the completion queue threads, see AsyncServerOptions::inlineHandlers.
+         */
+        [[nodiscard]] WorkStealingThreadPool* handlerThreadPool() const { return _handlerThreadPool.get(); }
+
+        /**
+         * \brief The latest load of the server, which is sampled once per AsyncServerOptions::loadRefreshInterval at
+         *  most, and stays as it is once the server starts to stop.
+         */
+        [[nodiscard]] ServerLoad load() const { return _loadReporter->load(); }
+
     private:
+        static AsyncServerOptions makeOptions(size_t numCompletionQueues)
+        {
+            AsyncServerOptions options;
+            options.completionQueueCount = numCompletionQueues;
+            return options;
+        }
+
         std::atomic_bool _started { false };
+        std::atomic_bool _stopped { false };
+
+        // Declared before the queues, thus destroyed after them.
+        std::unique_ptr<WorkStealingThreadPool> _handlerThreadPool;
 
         std::unique_ptr<grpc::Server> _server;
+        std::vector<int> _selectedPorts;
 
         std::vector<std::unique_ptr<AsyncActionQueue>> _asyncActionQueues;
-        std::vector<std::unique_ptr<std::thread>> _asyncActionThreads;
+        PollerOptions _pollerOptions;
+        mutable std::mutex _pollersMutex;
+        std::vector<std::unique_ptr<AsyncActionQueuePoller>> _pollers;
+
+        bool _reportLoad {};
+        std::shared_ptr<AsyncServerLoadReporter> _loadReporter;
 
 
         // Services ----------------------------------------------------------------------------------------------------
@@ -146,29 +306,245 @@ namespace ShuHai::gRPC::Server
         // Call Handlers -----------------------------------------------------------------------------------------------
     public:
         /**
-         * \brief Register certain rpc call handler corresponding to the specified function AsyncService::Request<RpcName>
-         *  located in the generated code.
+         * \brief Register certain rpc call handler corresponding to the specified function
+         *  AsyncService::Request<RpcName> located in the generated code. The overloads below differ in the type of rpc
+         *  and handle function only, the other arguments are the same as the ones of this overload.
          * \param requestFunc Function address of AsyncService::Request<RpcName> located in generated code.
-         * \param processFunc The function actually take care of the rpc call.
+         * \param handleFunc The function takes care of the unary rpc call and returns its response.
+         * \param handleFuncExecutionContext The execution context that execute the specified handle function, and the
+         *  stream handler it returns if any, the handler thread pool of the server if null.
+         * \param queueIndices Indices of the completion queues that the handler is registered on, the handler is
+         *  registered on all completion queues if empty.
+         * \param options Options of the handler, which apply to each of the completion queues.
+         * \return Statistics of the handler across all the completion queues it is registered on.
          */
         template<typename RequestFunc>
-        EnableIfAnyRpcTypeMatch<void, RequestFunc, RpcType::UnaryCall> registerCallHandler(RequestFunc requestFunc,
+        EnableIfAnyRpcTypeMatch<std::shared_ptr<const AsyncCallHandlerStats>, RequestFunc, RpcType::UnaryCall>
+        registerCallHandler(RequestFunc requestFunc,
             typename AsyncUnaryCallHandler<RequestFunc>::HandleFunc handleFunc,
-            asio::execution_context* handleFuncExecutionContext = nullptr, size_t queueIndex = 0)
+            Executor handleFuncExecutionContext = nullptr, const std::vector<size_t>& queueIndices = {},
+            const AsyncCallHandlerOptions& options = {})
         {
-            using Service = typename AsyncRequestTraits<RequestFunc>::ServiceType;
-            auto& queue = _asyncActionQueues.at(queueIndex);
-            queue->registerCallHandler(
-                this->service<Service>(), requestFunc, std::move(handleFunc), handleFuncExecutionContext);
+            return registerOnQueues(requestFunc, handleFunc, handleFuncExecutionContext, queueIndices, options);
+        }
+
+        /**
+         * \brief Register certain unary rpc call handler that fills the response in place.
+         * \param handleFunc The function takes care of the call by filling the given response, which is allocated on
+         *  the arena of the call, thus no response is allocated on the heap or copied.
+         */
+        template<typename RequestFunc>
+        EnableIfAnyRpcTypeMatch<std::shared_ptr<const AsyncCallHandlerStats>, RequestFunc, RpcType::UnaryCall>
+        registerCallHandler(RequestFunc requestFunc,
+            typename AsyncUnaryCallHandler<RequestFunc>::InPlaceHandleFunc handleFunc,
+            Executor handleFuncExecutionContext = nullptr, const std::vector<size_t>& queueIndices = {},
+            const AsyncCallHandlerOptions& options = {})
+        {
+            return registerOnQueues(requestFunc, handleFunc, handleFuncExecutionContext, queueIndices, options);
+        }
+
+        /**
+         * \brief Register certain unary rpc call handler that responds later.
+         * \param handleFunc The function takes care of the call and completes it through the given responder, which is
+         *  allowed to be moved to and completed on any thread, e.g. once a downstream call finishes. The call is
+         *  finished directly on the thread that completes the responder.
+         */
+        template<typename RequestFunc>
+        EnableIfAnyRpcTypeMatch<std::shared_ptr<const AsyncCallHandlerStats>, RequestFunc, RpcType::UnaryCall>
+        registerCallHandler(RequestFunc requestFunc,
+            typename AsyncUnaryCallHandler<RequestFunc>::ResponderHandleFunc handleFunc,
+            Executor handleFuncExecutionContext = nullptr, const std::vector<size_t>& queueIndices = {},
+            const AsyncCallHandlerOptions& options = {})
+        {
+            return registerOnQueues(requestFunc, handleFunc, handleFuncExecutionContext, queueIndices, options);
+        }
+
+        /**
+         * \brief Register certain client streaming rpc call handler.
+         * \param handleFunc The function takes care of new streams, it returns the handler of messages read from the
+         *  stream, which makes the response once all messages are read.
+         */
+        template<typename RequestFunc>
+        EnableIfAnyRpcTypeMatch<std::shared_ptr<const AsyncCallHandlerStats>, RequestFunc, RpcType::ClientStream>
+        registerCallHandler(RequestFunc requestFunc,
+            typename AsyncClientStreamCallHandler<RequestFunc>::HandleFunc handleFunc,
+            Executor handleFuncExecutionContext = nullptr, const std::vector<size_t>& queueIndices = {},
+            const AsyncCallHandlerOptions& options = {})
+        {
+            return registerOnQueues(requestFunc, handleFunc, handleFuncExecutionContext, queueIndices, options);
         }
 
+        /**
+         * \brief Same as above with a null execution context, except that the handler is registered on the completion
+         *  queue of the specified \p queueIndex only.
+         */
+        template<typename RequestFunc>
+        EnableIfAnyRpcTypeMatch<std::shared_ptr<const AsyncCallHandlerStats>, RequestFunc, RpcType::ClientStream>
+        registerCallHandler(RequestFunc requestFunc,
+            typename AsyncClientStreamCallHandler<RequestFunc>::HandleFunc handleFunc, size_t queueIndex)
+        {
+            return registerCallHandler(requestFunc, std::move(handleFunc), nullptr, { queueIndex });
+        }
+
+        /**
+         * \brief Register certain server streaming rpc call handler.
+         * \param handleFunc The function takes care of new streams, messages are written through the given stream
+         *  writer.
+         */
         template<typename RequestFunc>
-        EnableIfAnyRpcTypeMatch<void, RequestFunc, RpcType::ClientStream> registerCallHandler(RequestFunc requestFunc,
-            typename AsyncClientStreamCallHandler<RequestFunc>::HandleFunc handleFunc, size_t queueIndex = 0)
+        EnableIfAnyRpcTypeMatch<std::shared_ptr<const AsyncCallHandlerStats>, RequestFunc, RpcType::ServerStream>
+        registerCallHandler(RequestFunc requestFunc,
+            typename AsyncServerStreamCallHandler<RequestFunc>::HandleFunc handleFunc,
+            Executor handleFuncExecutionContext = nullptr, const std::vector<size_t>& queueIndices = {},
+            const AsyncCallHandlerOptions& options = {})
+        {
+            return registerOnQueues(requestFunc, handleFunc, handleFuncExecutionContext, queueIndices, options);
+        }
+
+        /**
+         * \brief Register certain bidirectional streaming rpc call handler.
+         * \param handleFunc The function takes care of new streams, it returns the handler of messages read from the
+         *  stream, messages are written through the given stream writer.
+         */
+        template<typename RequestFunc>
+        EnableIfAnyRpcTypeMatch<std::shared_ptr<const AsyncCallHandlerStats>, RequestFunc, RpcType::BidiStream>
+        registerCallHandler(RequestFunc requestFunc,
+            typename AsyncBidiStreamCallHandler<RequestFunc>::HandleFunc handleFunc,
+            Executor handleFuncExecutionContext = nullptr, const std::vector<size_t>& queueIndices = {},
+            const AsyncCallHandlerOptions& options = {})
+        {
+            return registerOnQueues(requestFunc, handleFunc, handleFuncExecutionContext, queueIndices, options);
+        }
+
+#ifdef SHUHAI_GRPC_HAS_COROUTINES
+        /**
+         * \brief Register certain unary rpc call handler which is a coroutine. The coroutine is started by the
+         *  execution context, and resumed by whoever completes the awaited operation.
+         * \param handleFunc The coroutine takes care of the rpc call, the call is finished once the returned task
+         *  completes, thus no thread is occupied while the task awaits, e.g. a call to another service.
+         */
+        template<typename RequestFunc>
+        EnableIfAnyRpcTypeMatch<std::shared_ptr<const AsyncCallHandlerStats>, RequestFunc, RpcType::UnaryCall>
+        registerCallHandler(RequestFunc requestFunc,
+            typename AsyncUnaryCallHandler<RequestFunc>::TaskHandleFunc handleFunc,
+            Executor handleFuncExecutionContext = nullptr, const std::vector<size_t>& queueIndices = {},
+            const AsyncCallHandlerOptions& options = {})
+        {
+            return registerOnQueues(requestFunc, handleFunc, handleFuncExecutionContext, queueIndices, options);
+        }
+
+        /**
+         * \brief Register certain server streaming rpc call handler which is a coroutine. The coroutine is started by
+         *  the execution context, and resumed by whoever completes the awaited operation.
+         * \param handleFunc The coroutine takes care of new streams, messages are written through the given stream
+         *  writer. The stream is finished once the returned task completes unless it is already finished.
+         */
+        template<typename RequestFunc, typename TaskHandleFunc>
+        EnableIfTaskInvocable<
+            EnableIfAnyRpcTypeMatch<std::shared_ptr<const AsyncCallHandlerStats>, RequestFunc, RpcType::ServerStream>,
+            TaskHandleFunc, grpc::ServerContext&, const RequestTypeOf<RequestFunc>&,
+            std::shared_ptr<AsyncServerStreamWriter<RequestFunc>>>
+        registerCallHandler(RequestFunc requestFunc, TaskHandleFunc handleFunc,
+            Executor handleFuncExecutionContext = nullptr, const std::vector<size_t>& queueIndices = {},
+            const AsyncCallHandlerOptions& options = {})
+        {
+            typename AsyncServerStreamCallHandler<RequestFunc>::TaskHandleFunc func(std::move(handleFunc));
+            return registerOnQueues(requestFunc, func, handleFuncExecutionContext, queueIndices, options);
+        }
+#endif
+
+        /**
+         * \brief Same as the overloads above, except that the handler is registered on the completion queue of the
+         *  specified \p queueIndex only, as the handlers registered before multiple queues were supported.
+         */
+        template<typename RequestFunc, typename HandleFunc, typename QueueIndex,
+            std::enable_if_t<std::is_integral_v<QueueIndex>, int> = 0>
+        auto registerCallHandler(RequestFunc requestFunc, HandleFunc&& handleFunc, Executor handleFuncExecutionContext,
+            QueueIndex queueIndex, const AsyncCallHandlerOptions& options = {})
+        {
+            return registerCallHandler(requestFunc, std::forward<HandleFunc>(handleFunc), handleFuncExecutionContext,
+                std::vector<size_t> { static_cast<size_t>(queueIndex) }, options);
+        }
+
+    private:
+        Executor handlerExecutor(const Executor& executor) const
+        {
+            return executor ? executor : Executor(_handlerThreadPool.get());
+        }
+
+        template<typename RequestFunc, typename HandleFunc>
+        std::shared_ptr<const AsyncCallHandlerStats> registerOnQueues(RequestFunc requestFunc,
+            const HandleFunc& handleFunc, const Executor& handleFuncExecutionContext,
+            const std::vector<size_t>& queueIndices, const AsyncCallHandlerOptions& options)
         {
             using Service = typename AsyncRequestTraits<RequestFunc>::ServiceType;
-            auto& w = _asyncActionQueues.at(queueIndex);
-            w->registerCallHandler(this->service<Service>(), requestFunc, std::move(handleFunc));
+            auto executor = handlerExecutor(handleFuncExecutionContext);
+            auto handlerOptions = withLoadReporter(options);
+            auto stats = makeHandlerStats();
+            foreachQueue(queueIndices,
+                [&](AsyncActionQueue& queue)
+                {
+                    queue.registerCallHandler(
+                        this->service<Service>(), requestFunc, handleFunc, executor, handlerOptions, stats);
+                });
+            return stats;
+        }
+
+        AsyncCallHandlerOptions withLoadReporter(const AsyncCallHandlerOptions& options) const
+        {
+            auto result = options;
+            if (_reportLoad && !result.loadReporter)
+                result.loadReporter = _loadReporter;
+            return result;
+        }
+
+        AsyncServerLoadReporter::Sample sampleLoad() const
+        {
+            AsyncServerLoadReporter::Sample sample;
+            sample.inFlightCallCount = inFlightCallCount();
+            sample.queueDepth = _handlerThreadPool ? _handlerThreadPool->pendingCount() : 0;
+
+            std::lock_guard l(_pollersMutex);
+            for (const auto& poller : _pollers)
+            {
+                sample.busyTime += poller->busyTime();
+                sample.threadCount += poller->threadCount();
+            }
+            return sample;
         }
+
+        std::shared_ptr<AsyncCallHandlerStats> makeHandlerStats()
+        {
+            auto stats = std::make_shared<AsyncCallHandlerStats>();
+            std::lock_guard l(_handlerStatsMutex);
+            _handlerStats.emplace_back(stats);
+            return stats;
+        }
+
+        template<typename Func>
+        void foreachQueue(const std::vector<size_t>& queueIndices, Func&& func)
+        {
+            if (queueIndices.empty())
+            {
+                for (auto& queue : _asyncActionQueues)
+                    func(*queue);
+                return;
+            }
+
+            // Validate all indices before registering, so that the handler is registered on all or none of the queues.
+            std::vector<AsyncActionQueue*> queues;
+            for (auto index : queueIndices)
+            {
+                auto queue = _asyncActionQueues.at(index).get();
+                if (std::find(queues.begin(), queues.end(), queue) != queues.end())
+                    throw std::invalid_argument("Duplicate completion queue index.");
+                queues.emplace_back(queue);
+            }
+            for (auto queue : queues)
+                func(*queue);
+        }
+
+        mutable std::mutex _handlerStatsMutex;
+        std::vector<std::shared_ptr<AsyncCallHandlerStats>> _handlerStats;
     };
 }
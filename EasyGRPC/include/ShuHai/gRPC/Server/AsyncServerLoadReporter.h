@@ -0,0 +1,145 @@
+#pragma once
+
+#include "ShuHai/gRPC/ServerLoad.h"
+
+#include <grpcpp/server_context.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <stdexcept>
+
+namespace ShuHai::gRPC::Server
+{
+    /**
+     * \brief Keeps the load of a server up to date and attaches it to the trailing metadata of finished calls. The load
+     *  is sampled at most once per refresh interval by whichever thread asks for it first, so reporting costs calls
+     *  little more than copying a short string.
+     */
+    class AsyncServerLoadReporter
+    {
+    public:
+        /**
+         * \brief Raw counters of a server, the load is derived from the difference of successive samples.
+         */
+        struct Sample
+        {
+            uint64_t inFlightCallCount {};
+            uint64_t queueDepth {};
+
+            /**
+             * \brief Total time the completion queue threads spent on handling events.
+             */
+            std::chrono::nanoseconds busyTime {};
+
+            /**
+             * \brief Number of completion queue threads.
+             */
+            size_t threadCount {};
+        };
+
+        using Sampler = std::function<Sample()>;
+
+        AsyncServerLoadReporter(Sampler sampler, std::chrono::nanoseconds refreshInterval)
+            : _sampler(std::move(sampler))
+            , _refreshInterval(refreshInterval)
+        {
+            if (!_sampler)
+                throw std::invalid_argument("Null sampler.");
+            if (_refreshInterval <= std::chrono::nanoseconds::zero())
+                throw std::invalid_argument("Refresh interval of server load must be greater than zero.");
+
+            _lastSample = _sampler();
+            _lastSampleTime = Clock::now();
+            _load.inFlightCallCount = _lastSample.inFlightCallCount;
+            _load.queueDepth = _lastSample.queueDepth;
+            _text = _load.toString();
+        }
+
+        AsyncServerLoadReporter(const AsyncServerLoadReporter&) = delete;
+        AsyncServerLoadReporter& operator=(const AsyncServerLoadReporter&) = delete;
+
+        /**
+         * \brief The latest load of the server.
+         */
+        [[nodiscard]] ServerLoad load()
+        {
+            refreshIfDue();
+            std::lock_guard l(_loadMutex);
+            return _load;
+        }
+
+        /**
+         * \brief Attach the latest load of the server to the trailing metadata of the call of the specified
+         *  \p context, which must happen before the call is finished.
+         */
+        void report(grpc::ServerContext& context)
+        {
+            refreshIfDue();
+            std::string text;
+            {
+                std::lock_guard l(_loadMutex);
+                text = _text;
+            }
+            context.AddTrailingMetadata(ServerLoad::MetadataKey, text);
+        }
+
+        /**
+         * \brief Stop sampling the server, the load stays as it is afterwards. The sampler is never called once the
+         *  function returns, thus it is allowed to refer to what is about to be destroyed.
+         */
+        void stop()
+        {
+            std::lock_guard l(_sampleMutex);
+            _stopped = true;
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        void refreshIfDue()
+        {
+            // Callers don't wait for the sampling in progress, the load it is about to replace is recent enough.
+            std::unique_lock sl(_sampleMutex, std::try_to_lock);
+            if (!sl || _stopped)
+                return;
+
+            auto now = Clock::now();
+            auto elapsed = now - _lastSampleTime;
+            if (elapsed < _refreshInterval)
+                return;
+
+            auto sample = _sampler();
+            auto busy = std::chrono::duration<double>(sample.busyTime - _lastSample.busyTime).count();
+            auto capacity = std::chrono::duration<double>(elapsed).count() * static_cast<double>(sample.threadCount);
+
+            ServerLoad load;
+            load.inFlightCallCount = sample.inFlightCallCount;
+            load.queueDepth = sample.queueDepth;
+            load.cpuBusyRatio = capacity > 0 ? std::clamp(busy / capacity, 0.0, 1.0) : 0.0;
+            auto text = load.toString();
+
+            _lastSample = sample;
+            _lastSampleTime = now;
+
+            std::lock_guard l(_loadMutex);
+            _load = load;
+            _text = std::move(text);
+        }
+
+        const Sampler _sampler;
+        const std::chrono::nanoseconds _refreshInterval;
+
+        std::mutex _sampleMutex;
+        bool _stopped {};
+        Sample _lastSample;
+        Clock::time_point _lastSampleTime;
+
+        std::mutex _loadMutex;
+        ServerLoad _load;
+        std::string _text;
+    };
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ShuHai/gRPC/WorkStealingThreadPool.h"
+#include "ShuHai/gRPC/PollerOptions.h"
+
+#include <cstddef>
+#include <chrono>
+
+namespace ShuHai::gRPC::Server
+{
+    /**
+     * \brief Options of AsyncServer.
+     */
+    struct AsyncServerOptions
+    {
+        /**
+         * \brief Number of completion queues, each of them is polled by its own threads. The number of hardware threads
+         *  if zero.
+         */
+        size_t completionQueueCount = 1;
+
+        /**
+         * \brief Number and placement of the threads polling each completion queue.
+         */
+        PollerOptions pollers;
+
+        /**
+         * \brief Whether handle functions registered without an execution context run right on the completion queue
+         *  threads. They run on the handler thread pool of the server otherwise, which keeps the completion queue
+         *  threads polling while handle functions block or take long.
+         */
+        bool inlineHandlers = false;
+
+        /**
+         * \brief Options of the handler thread pool of the server, unused if inlineHandlers is set.
+         */
+        WorkStealingThreadPool::Options handlerThreadPool;
+
+        /**
+         * \brief Whether the load of the server is attached to the trailing metadata of each finished call, which lets
+         *  clients balancing by ChannelSelection::ServerLoad send fewer calls to busier servers.
+         */
+        bool reportLoad = false;
+
+        /**
+         * \brief How often the load of the server is sampled, see AsyncServer::load().
+         */
+        std::chrono::nanoseconds loadRefreshInterval = std::chrono::milliseconds(100);
+    };
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace ShuHai::gRPC::Server
+{
+    /**
+     * \brief Outcome of stopping an AsyncServer, see AsyncServer::stop().
+     */
+    struct AsyncServerStopStats
+    {
+        /**
+         * \brief Number of calls in flight when the server started to stop.
+         */
+        uint64_t inFlightCallCount {};
+
+        /**
+         * \brief Number of in-flight calls that completed before the deadline.
+         */
+        uint64_t drainedCallCount {};
+
+        /**
+         * \brief Number of in-flight calls that were still running at the deadline, thus got cancelled.
+         */
+        uint64_t abortedCallCount {};
+
+        /**
+         * \brief How long it took the server to stop, including the time the polling and handler threads took to exit.
+         */
+        std::chrono::nanoseconds duration {};
+    };
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "ShuHai/gRPC/Server/AsyncServerStreamWriter.h"
+#include "ShuHai/gRPC/Server/AsyncCallHandler.h"
+#include "ShuHai/gRPC/IAsyncAction.h"
+#include "ShuHai/gRPC/Task.h"
+
+#include <memory>
+
+namespace ShuHai::gRPC::Server
+{
+    template<typename RequestFuncType>
+    class AsyncServerStreamCallHandler : public AsyncCallHandler<RequestFuncType>
+    {
+    public:
+        SHUHAI_GRPC_SERVER_EXPAND_AsyncRequestTraits(RequestFuncType);
+
+        using StreamWriter = AsyncServerStreamWriter<RequestFunc>;
+
+        /**
+         * \brief The function takes care of a new stream. The stream writer is allowed to be kept and written after the
+         *  function returns, the call ends when the writer finished.
+         */
+        using HandleFunc = std::function<void(grpc::ServerContext&, const Request&, std::shared_ptr<StreamWriter>)>;
+
+        AsyncServerStreamCallHandler(gRPC::AsyncActionQueue* actionQueue, grpc::ServerCompletionQueue* completionQueue,
+            Service* service, RequestFunc requestFunc, HandleFunc handleFunc,
+            Executor handleFuncExecutionContext, const AsyncCallHandlerOptions& options,
+            std::shared_ptr<AsyncCallHandlerStats> stats)
+            : AsyncCallHandler<RequestFunc>(
+                actionQueue, completionQueue, service, requestFunc, options, std::move(stats))
+            , _handleFunc(std::move(handleFunc))
+            , _handleFuncExecutionContext(handleFuncExecutionContext)
+        {
+            for (size_t i = 0; i < this->_options.pendingRequestCount; ++i)
+                newCallRequest();
+        }
+
+#ifdef SHUHAI_GRPC_HAS_COROUTINES
+        /**
+         * \brief Coroutine that takes care of a new stream. The stream is finished once the task completes unless it is
+         *  already finished by the task, with an error status if the task throws. The context and the request stay
+         *  valid until the task completes.
+         */
+        using TaskHandleFunc =
+            std::function<Task<>(grpc::ServerContext&, const Request&, std::shared_ptr<StreamWriter>)>;
+
+        AsyncServerStreamCallHandler(gRPC::AsyncActionQueue* actionQueue, grpc::ServerCompletionQueue* completionQueue,
+            Service* service, RequestFunc requestFunc, TaskHandleFunc taskHandleFunc,
+            Executor handleFuncExecutionContext, const AsyncCallHandlerOptions& options,
+            std::shared_ptr<AsyncCallHandlerStats> stats)
+            : AsyncCallHandler<RequestFunc>(
+                actionQueue, completionQueue, service, requestFunc, options, std::move(stats))
+            , _handleFuncExecutionContext(handleFuncExecutionContext)
+            , _taskHandleFunc(std::move(taskHandleFunc))
+        {
+            for (size_t i = 0; i < this->_options.pendingRequestCount; ++i)
+                newCallRequest();
+        }
+#endif
+
+    private:
+        class ServiceRequestAction : public IAsyncAction
+        {
+        public:
+            explicit ServiceRequestAction(AsyncServerStreamCallHandler* handler)
+                : _handler(handler)
+                , _streamWriter(new StreamWriter(handler->_actionQueue, handler->_options.loadReporter))
+                , _doneAction(_streamWriter->notifyWhenDone())
+            {
+                auto service = handler->_service;
+                auto func = handler->_requestFunc;
+                auto cq = handler->_completionQueue;
+                (service->*func)(&_streamWriter->_context, &_request, &_streamWriter->_stream, cq, cq, this);
+            }
+
+            void finalizeResult(bool ok) override
+            {
+                // The done notification is not delivered since the call never started.
+                if (!ok)
+                    delete _doneAction;
+                _handler->finalizeCallRequest(std::move(_streamWriter), std::move(_request), ok);
+            }
+
+        private:
+            AsyncServerStreamCallHandler* const _handler;
+            std::shared_ptr<StreamWriter> _streamWriter;
+            IAsyncAction* const _doneAction;
+            Request _request;
+        };
+
+        void newCallRequest() { new ServiceRequestAction(this); }
+
+        void finalizeCallRequest(std::shared_ptr<StreamWriter> streamWriter, Request request, bool ok)
+        {
+            // ok indicates that the RPC has indeed been started.
+            // If it is false, the server has been Shutdown before this particular call got matched to an incoming RPC.
+
+            if (!ok)
+                return;
+
+            this->_stats->consumedRequestCount.fetch_add(1, std::memory_order_relaxed);
+            newCallRequest();
+
+            streamWriter->_admission = this->admitCall();
+            if (!streamWriter->_admission)
+            {
+                streamWriter->finishIfNotRequested(this->shedStatus());
+                return;
+            }
+
+            this->dispatch(_handleFuncExecutionContext,
+                [this, w = std::move(streamWriter), r = std::move(request)]() mutable
+                {
+                    if (w->_context.cancelled())
+                    {
+                        this->_stats->cancelledCallCount.fetch_add(1, std::memory_order_relaxed);
+                        w->finishIfNotRequested(this->cancelledStatus());
+                        return;
+                    }
+
+#ifdef SHUHAI_GRPC_HAS_COROUTINES
+                    if (_taskHandleFunc)
+                    {
+                        startTaskHandling(w, r);
+                        return;
+                    }
+#endif
+                    try
+                    {
+                        _handleFunc(w->context(), r, w);
+                    }
+                    catch (...)
+                    {
+                        w->finishIfNotRequested(this->errorStatus(std::current_exception()));
+                    }
+                });
+        }
+
+#ifdef SHUHAI_GRPC_HAS_COROUTINES
+        void startTaskHandling(const std::shared_ptr<StreamWriter>& streamWriter, Request& request)
+        {
+            // The request is kept by the completion function, thus it outlives the task.
+            auto r = std::make_shared<Request>(std::move(request));
+            startTask(_taskHandleFunc(streamWriter->context(), *r, streamWriter),
+                [w = streamWriter, r](std::exception_ptr error)
+                {
+                    w->finishIfNotRequested(
+                        error ? AsyncServerStreamCallHandler::errorStatus(error) : grpc::Status::OK);
+                });
+        }
+#endif
+
+        HandleFunc _handleFunc;
+        Executor _handleFuncExecutionContext;
+#ifdef SHUHAI_GRPC_HAS_COROUTINES
+        TaskHandleFunc _taskHandleFunc;
+#endif
+    };
+}
@@ -0,0 +1,432 @@
+#pragma once
+
+#include "ShuHai/gRPC/Server/AsyncCallAdmission.h"
+#include "ShuHai/gRPC/Server/AsyncCallContext.h"
+#include "ShuHai/gRPC/Server/AsyncServerLoadReporter.h"
+#include "ShuHai/gRPC/Server/TypeTraits.h"
+#include "ShuHai/gRPC/AsyncAction.h"
+#include "ShuHai/gRPC/AsyncActionQueue.h"
+#include "ShuHai/gRPC/IAsyncAction.h"
+#include "ShuHai/gRPC/StreamingError.h"
+
+#include <queue>
+#include <vector>
+#include <utility>
+#include <future>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <stdexcept>
+#include <cassert>
+
+namespace ShuHai::gRPC::Server
+{
+    template<typename RequestFunc>
+    class AsyncServerStreamCallHandler;
+
+    template<typename RequestFunc>
+    class AsyncBidiStreamCallHandler;
+
+    /**
+     * \brief Writes messages to the client side of a server streaming or bidirectional streaming call.
+     *  Writes are performed one by one in the order they are made, messages written while another write is in
+     *  progress wait in a queue bounded by capacity(). The writer turns unwritable once the queue is full, the producer
+     *  is expected to stop writing until the writable callback is called.
+     *  The stream is cancelled if the last reference of the writer is released before finish() is performed.
+     */
+    template<typename RequestFuncType>
+    class AsyncServerStreamWriter : public std::enable_shared_from_this<AsyncServerStreamWriter<RequestFuncType>>
+    {
+    public:
+        SHUHAI_GRPC_SERVER_EXPAND_AsyncRequestTraits(RequestFuncType);
+        static_assert(RPC_TYPE == RpcType::ServerStream || RPC_TYPE == RpcType::BidiStream);
+
+        using ResultCallback = AsyncAction<bool>::ResultCallback;
+
+        static constexpr size_t DefaultCapacity = 64;
+
+        AsyncServerStreamWriter(const AsyncServerStreamWriter&) = delete;
+        AsyncServerStreamWriter& operator=(const AsyncServerStreamWriter&) = delete;
+
+        [[nodiscard]] grpc::ServerContext& context() { return _context; }
+
+    private:
+        friend class AsyncServerStreamCallHandler<RequestFunc>;
+        friend class AsyncBidiStreamCallHandler<RequestFunc>;
+
+        AsyncServerStreamWriter(
+            gRPC::AsyncActionQueue* actionQueue, std::shared_ptr<AsyncServerLoadReporter> loadReporter = nullptr)
+            : _actionQueue(actionQueue)
+            , _loadReporter(std::move(loadReporter))
+            , _stream(&_context)
+        { }
+
+        // Delivered once the call is done, which may happen after the writer is released.
+        class DoneAction : public IAsyncAction
+        {
+        public:
+            explicit DoneAction(std::weak_ptr<AsyncServerStreamWriter> owner)
+                : _owner(std::move(owner))
+            { }
+
+            void finalizeResult(bool ok) override
+            {
+                if (auto owner = _owner.lock())
+                    owner->_context.notifyDone();
+            }
+
+        private:
+            std::weak_ptr<AsyncServerStreamWriter> _owner;
+        };
+
+        // Must be called before the call is requested. The returned action is owned by the completion queue once the
+        // call started, otherwise it is never delivered and is expected to be deleted by the caller.
+        IAsyncAction* notifyWhenDone()
+        {
+            auto action = new DoneAction(this->weak_from_this());
+            _context.AsyncNotifyWhenDone(action);
+            return action;
+        }
+
+        gRPC::AsyncActionQueue* const _actionQueue;
+        const std::shared_ptr<AsyncServerLoadReporter> _loadReporter;
+        AsyncCallContext _context;
+        StreamingInterface _stream;
+
+        // Released once the stream is finished, the writer may be kept long after that.
+        AsyncCallAdmission _admission;
+
+
+        // Backpressure ------------------------------------------------------------------------------------------------
+    public:
+        /**
+         * \brief Max number of messages that allowed to be pending (queued or in progress) at the same time.
+         */
+        [[nodiscard]] size_t capacity() const
+        {
+            std::lock_guard l(_mutex);
+            return _capacity;
+        }
+
+        void setCapacity(size_t capacity)
+        {
+            if (capacity == 0)
+                throw std::invalid_argument("Capacity of stream writer must be greater than zero.");
+
+            std::lock_guard l(_mutex);
+            _capacity = capacity;
+        }
+
+        /**
+         * \brief Number of messages that are written but not yet finalized.
+         */
+        [[nodiscard]] size_t pendingWriteCount() const
+        {
+            std::lock_guard l(_mutex);
+            return _pendingWriteCount;
+        }
+
+        /**
+         * \brief Whether a message is allowed to be written right now.
+         */
+        [[nodiscard]] bool writable() const
+        {
+            std::lock_guard l(_mutex);
+            return !_finishRequested && _pendingWriteCount < _capacity;
+        }
+
+        /**
+         * \brief Set the function to be called when the writer turns writable again after its queue was full.
+         *  The function is called from the completion queue thread, it should return as soon as possible.
+         */
+        void setWritableCallback(std::function<void()> callback)
+        {
+            std::lock_guard l(_mutex);
+            _writableCallback = std::move(callback);
+        }
+
+    private:
+        size_t _capacity { DefaultCapacity };
+        size_t _pendingWriteCount {};
+        bool _full {};
+        std::function<void()> _writableCallback;
+
+
+        // Actions -----------------------------------------------------------------------------------------------------
+    public:
+        /**
+         * \brief Append writing of the specified \p message with certain \p options to the write queue. The writing is
+         *  performed as soon as all previous actions are done.
+         * \param message The message to be written.
+         * \param options The options to be used to write this message.
+         * \return The future object that identifies whether the message is going to the wire, or holds
+         *  StreamingQueueFull if the write queue is full, or InvalidStreamingAction if the stream is already finished.
+         */
+        std::future<bool> write(Response message, grpc::WriteOptions options = {})
+        {
+            auto action = new WriteAction(this->shared_from_this(), std::move(message), options);
+            auto result = action->result();
+            enqueueWrite(action);
+            return result;
+        }
+
+        /**
+         * \brief Same as write(), except that the future of the result is passed to the specified \p callback once it
+         *  is ready. The callback is called from the completion queue thread in most cases, it should return as soon as
+         *  possible.
+         */
+        void write(Response message, grpc::WriteOptions options, ResultCallback callback)
+        {
+            auto action = new WriteAction(this->shared_from_this(), std::move(message), options);
+            action->setResultCallback(std::move(callback));
+            enqueueWrite(action);
+        }
+
+        /**
+         * \brief Finish the stream with the specified \p status after all written messages are done.
+         * \return The future object that identifies whether the status is going to the wire.
+         */
+        std::future<bool> finish(grpc::Status status = grpc::Status::OK)
+        {
+            auto action = new FinishAction(this->shared_from_this(), std::move(status));
+            auto result = action->result();
+            enqueueFinish(action);
+            return result;
+        }
+
+        /**
+         * \brief Same as finish(), except that the future of the result is passed to the specified \p callback once it
+         *  is ready. The callback is called from the completion queue thread in most cases, it should return as soon as
+         *  possible.
+         */
+        void finish(grpc::Status status, ResultCallback callback)
+        {
+            auto action = new FinishAction(this->shared_from_this(), std::move(status));
+            action->setResultCallback(std::move(callback));
+            enqueueFinish(action);
+        }
+
+    private:
+        class WriteAction;
+        class FinishAction;
+
+        void enqueueWrite(WriteAction* action)
+        {
+            std::unique_lock l(_mutex);
+            if (_finishRequested)
+            {
+                l.unlock();
+                action->template setException<InvalidStreamingAction>("Attempt to write after finish.");
+                delete action;
+            }
+            else if (_pendingWriteCount >= _capacity)
+            {
+                _full = true;
+                l.unlock();
+                action->template setException<StreamingQueueFull>("The write queue of the stream is full.");
+                delete action;
+            }
+            else
+            {
+                ++_pendingWriteCount;
+                _full = _pendingWriteCount >= _capacity;
+                enqueueAction(action);
+                unlockAndSetDroppedResults(l);
+            }
+        }
+
+        void enqueueFinish(FinishAction* action)
+        {
+            std::unique_lock l(_mutex);
+            if (_finishRequested)
+            {
+                l.unlock();
+                action->template setException<InvalidStreamingAction>("Duplicate finish call.");
+                delete action;
+            }
+            else
+            {
+                _finishRequested = true;
+                enqueueAction(action);
+                unlockAndSetDroppedResults(l);
+            }
+        }
+
+        // Finish the stream with the specified status unless the finish is already requested.
+        void finishIfNotRequested(grpc::Status status)
+        {
+            std::unique_lock l(_mutex);
+            if (_finishRequested)
+                return;
+
+            _finishRequested = true;
+            enqueueAction(new FinishAction(this->shared_from_this(), std::move(status)));
+            unlockAndSetDroppedResults(l);
+        }
+
+        enum class StreamActionKind
+        {
+            Write,
+            Finish
+        };
+
+        class StreamAction : public AsyncAction<bool>
+        {
+        public:
+            StreamAction(std::shared_ptr<AsyncServerStreamWriter> owner, StreamActionKind kind)
+                : _owner(std::move(owner))
+                , _kind(kind)
+            { }
+
+            [[nodiscard]] bool isWrite() const { return _kind == StreamActionKind::Write; }
+
+            virtual void perform() = 0;
+
+            void finalizeResult(bool ok) final { _owner->finalizeAction(this, ok); }
+
+        protected:
+            // Keeps the writer alive until the action is finalized.
+            const std::shared_ptr<AsyncServerStreamWriter> _owner;
+
+        private:
+            const StreamActionKind _kind;
+        };
+
+        class WriteAction : public StreamAction
+        {
+        public:
+            WriteAction(std::shared_ptr<AsyncServerStreamWriter> owner, Response message, grpc::WriteOptions options)
+                : StreamAction(std::move(owner), StreamActionKind::Write)
+                , _message(std::move(message))
+                , _options(options)
+            { }
+
+            void perform() override { this->_owner->_stream.Write(_message, _options, this); }
+
+        private:
+            Response _message;
+            grpc::WriteOptions _options;
+        };
+
+        class FinishAction : public StreamAction
+        {
+        public:
+            FinishAction(std::shared_ptr<AsyncServerStreamWriter> owner, grpc::Status status)
+                : StreamAction(std::move(owner), StreamActionKind::Finish)
+                , _status(std::move(status))
+            { }
+
+            void perform() override
+            {
+                auto owner = this->_owner.get();
+                if (owner->_loadReporter)
+                    owner->_loadReporter->report(owner->_context);
+                owner->_stream.Finish(_status, this);
+            }
+
+        private:
+            grpc::Status _status;
+        };
+
+        // Must be called with _mutex locked.
+        void enqueueAction(StreamAction* action)
+        {
+            _actions.emplace(action);
+            if (!_performing)
+                performNextAction();
+        }
+
+        // Must be called with _mutex locked.
+        void performNextAction()
+        {
+            while (!_actions.empty())
+            {
+                auto action = _actions.front();
+                _actions.pop();
+
+                bool isWrite = action->isWrite();
+                if (!(_broken && isWrite) && _actionQueue->tryStartOperation([action]() { action->perform(); }))
+                {
+                    _performing = true;
+                    return;
+                }
+
+                // The call is already dead or the queue is shut down, nothing is going to the wire.
+                if (isWrite)
+                {
+                    --_pendingWriteCount;
+                    _broken = true;
+                }
+                _droppedActions.emplace_back(action);
+            }
+        }
+
+        // Release the lock, then set results of the dropped actions. Results are not set with the lock held, since a
+        // result callback may make further actions.
+        void unlockAndSetDroppedResults(std::unique_lock<std::mutex>& lock)
+        {
+            auto droppedActions = std::exchange(_droppedActions, {});
+            lock.unlock();
+            setDroppedResults(droppedActions);
+        }
+
+        static void setDroppedResults(const std::vector<StreamAction*>& droppedActions)
+        {
+            for (auto action : droppedActions)
+            {
+                action->setResult(false);
+                delete action;
+            }
+        }
+
+        void finalizeAction(StreamAction* action, bool ok)
+        {
+            // ok means that the data/metadata/status/etc is going to go to the wire.
+            // If it is false, it not going to the wire because the call is already dead (i.e., canceled, deadline
+            // expired, other side dropped the channel, etc).
+
+            std::function<void()> writableCallback;
+            std::vector<StreamAction*> droppedActions;
+            {
+                std::lock_guard l(_mutex);
+                assert(_performing);
+                _performing = false;
+
+                if (action->isWrite())
+                {
+                    assert(_pendingWriteCount > 0);
+                    --_pendingWriteCount;
+                    if (!ok)
+                        _broken = true;
+                }
+                else
+                {
+                    _admission.reset();
+                }
+
+                performNextAction();
+                droppedActions = std::exchange(_droppedActions, {});
+
+                if (_full && !_finishRequested && _pendingWriteCount < _capacity)
+                {
+                    _full = false;
+                    writableCallback = _writableCallback;
+                }
+            }
+
+            // The result of the finalized action goes before results of the dropped actions.
+            action->setResult(ok);
+            setDroppedResults(droppedActions);
+
+            if (writableCallback)
+                writableCallback();
+        }
+
+        mutable std::mutex _mutex;
+        std::queue<StreamAction*> _actions;
+        std::vector<StreamAction*> _droppedActions;
+        bool _performing {};
+        bool _finishRequested {};
+        bool _broken {};
+    };
+}
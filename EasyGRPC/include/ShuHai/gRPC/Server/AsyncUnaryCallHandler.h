@@ -1,12 +1,20 @@
 #pragma once
 
 #include "ShuHai/gRPC/Server/AsyncCallHandler.h"
+#include "ShuHai/gRPC/Server/AsyncCallContext.h"
+#include "ShuHai/gRPC/Server/Responder.h"
 #include "ShuHai/gRPC/IAsyncAction.h"
+#include "ShuHai/gRPC/Task.h"
 
 #include <grpcpp/alarm.h>
+#include <google/protobuf/arena.h>
 
-#include <asio/dispatch.hpp>
-#include <asio/execution_context.hpp>
+#include <optional>
+#include <chrono>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
 
 namespace ShuHai::gRPC::Server
 {
@@ -16,29 +24,109 @@ namespace ShuHai::gRPC::Server
     public:
         SHUHAI_GRPC_SERVER_EXPAND_AsyncRequestTraits(RequestFuncType);
 
+        /**
+         * \brief The function takes care of a call and returns its response, which is moved to the call rather than
+         *  copied.
+         */
         using HandleFunc = std::function<Response(grpc::ServerContext&, const Request&)>;
 
-        AsyncUnaryCallHandler(grpc::ServerCompletionQueue* completionQueue, Service* service, RequestFunc requestFunc,
-            HandleFunc handleFunc, asio::execution_context* handleFuncExecutionContext)
-            : AsyncCallHandler<RequestFunc>(completionQueue, service, requestFunc)
-            , _handleFunc(std::move(handleFunc))
-            , _handleFuncExecutionContext(handleFuncExecutionContext)
+        /**
+         * \brief The function takes care of a call by filling the given response in place. The response is allocated on
+         *  the arena of the call, thus it makes no heap allocation for the response as long as the arena is large
+         *  enough, see AsyncCallHandlerOptions::arenaInitialBlockSize.
+         */
+        using InPlaceHandleFunc = std::function<void(grpc::ServerContext&, const Request&, Response&)>;
+
+        /**
+         * \brief The function takes care of a call and completes it later through the given responder, from any
+         *  thread. The context and the request stay valid until the call is completed. If the function throws and the
+         *  responder is dropped on the way out, the call fails with the error of the exception. If the function throws
+         *  after moving the responder elsewhere, the exception is ignored and the call completes once that responder
+         *  does.
+         */
+        using ResponderHandleFunc = std::function<void(grpc::ServerContext&, const Request&, Responder<Response>)>;
+
+        AsyncUnaryCallHandler(gRPC::AsyncActionQueue* actionQueue, grpc::ServerCompletionQueue* completionQueue,
+            Service* service, RequestFunc requestFunc, HandleFunc handleFunc,
+            Executor handleFuncExecutionContext, const AsyncCallHandlerOptions& options,
+            std::shared_ptr<AsyncCallHandlerStats> stats)
+            : AsyncUnaryCallHandler(actionQueue, completionQueue, service, requestFunc, handleFuncExecutionContext,
+                options, std::move(stats))
+        {
+            _handleFunc = std::move(handleFunc);
+            newCallRequests();
+        }
+
+        AsyncUnaryCallHandler(gRPC::AsyncActionQueue* actionQueue, grpc::ServerCompletionQueue* completionQueue,
+            Service* service, RequestFunc requestFunc, InPlaceHandleFunc inPlaceHandleFunc,
+            Executor handleFuncExecutionContext, const AsyncCallHandlerOptions& options,
+            std::shared_ptr<AsyncCallHandlerStats> stats)
+            : AsyncUnaryCallHandler(actionQueue, completionQueue, service, requestFunc, handleFuncExecutionContext,
+                options, std::move(stats))
+        {
+            _inPlaceHandleFunc = std::move(inPlaceHandleFunc);
+            newCallRequests();
+        }
+
+        AsyncUnaryCallHandler(gRPC::AsyncActionQueue* actionQueue, grpc::ServerCompletionQueue* completionQueue,
+            Service* service, RequestFunc requestFunc, ResponderHandleFunc responderHandleFunc,
+            Executor handleFuncExecutionContext, const AsyncCallHandlerOptions& options,
+            std::shared_ptr<AsyncCallHandlerStats> stats)
+            : AsyncUnaryCallHandler(actionQueue, completionQueue, service, requestFunc, handleFuncExecutionContext,
+                options, std::move(stats))
+        {
+            _responderHandleFunc = std::move(responderHandleFunc);
+            newCallRequests();
+        }
+
+#ifdef SHUHAI_GRPC_HAS_COROUTINES
+        /**
+         * \brief Coroutine that takes care of a call. The call is finished with the response returned by the task, or
+         *  with an error status if the task throws. The context and the request stay valid until the task completes.
+         */
+        using TaskHandleFunc = std::function<Task<Response>(grpc::ServerContext&, const Request&)>;
+
+        AsyncUnaryCallHandler(gRPC::AsyncActionQueue* actionQueue, grpc::ServerCompletionQueue* completionQueue,
+            Service* service, RequestFunc requestFunc, TaskHandleFunc taskHandleFunc,
+            Executor handleFuncExecutionContext, const AsyncCallHandlerOptions& options,
+            std::shared_ptr<AsyncCallHandlerStats> stats)
+            : AsyncUnaryCallHandler(actionQueue, completionQueue, service, requestFunc, handleFuncExecutionContext,
+                options, std::move(stats))
+        {
+            _taskHandleFunc = std::move(taskHandleFunc);
+            newCallRequests();
+        }
+#endif
+
+        ~AsyncUnaryCallHandler() override
         {
-            newCallRequest();
+            {
+                std::lock_guard l(_lifetime->mutex);
+                _lifetime->alive = false;
+            }
+
+            for (auto call : _freeCalls)
+                delete call;
         }
 
     private:
-        struct Call
+        // Requests are not posted until the handle function is set, since a request may complete right after it is
+        // posted.
+        AsyncUnaryCallHandler(gRPC::AsyncActionQueue* actionQueue, grpc::ServerCompletionQueue* completionQueue,
+            Service* service, RequestFunc requestFunc, Executor handleFuncExecutionContext,
+            const AsyncCallHandlerOptions& options, std::shared_ptr<AsyncCallHandlerStats> stats)
+            : AsyncCallHandler<RequestFunc>(
+                actionQueue, completionQueue, service, requestFunc, options, std::move(stats))
+            , _handleFuncExecutionContext(handleFuncExecutionContext)
+        { }
+
+        void newCallRequests()
         {
-            Call()
-                : stream(&context)
-            { }
+            for (size_t i = 0; i < this->_options.pendingRequestCount; ++i)
+                newCallRequest();
+        }
 
-            grpc::ServerContext context;
-            StreamingInterface stream;
-            Request request;
-            Response response;
-        };
+        class Call;
 
         class CallHandlerAction : public IAsyncAction
         {
@@ -49,6 +137,9 @@ namespace ShuHai::gRPC::Server
             { }
 
         protected:
+            // The action is embedded in its call, thus it is not deleted by the queue.
+            void* tag() { return gRPC::AsyncActionQueue::embeddedTag(this); }
+
             AsyncUnaryCallHandler* const _handler;
             Call* const _call;
         };
@@ -56,13 +147,15 @@ namespace ShuHai::gRPC::Server
         class ServiceRequestAction : public CallHandlerAction
         {
         public:
-            ServiceRequestAction(AsyncUnaryCallHandler* handler, Call* call)
-                : CallHandlerAction(handler, call)
+            using CallHandlerAction::CallHandlerAction;
+
+            void perform()
             {
-                auto service = handler->_service;
-                auto func = handler->_requestFunc;
-                auto cq = handler->_completionQueue;
-                (service->*func)(&call->context, &call->request, &call->stream, cq, cq, this);
+                auto call = this->_call;
+                auto service = this->_handler->_service;
+                auto func = this->_handler->_requestFunc;
+                auto cq = this->_handler->_completionQueue;
+                (service->*func)(&*call->context, call->request, &*call->stream, cq, cq, this->tag());
             }
 
             void finalizeResult(bool ok) override { this->_handler->finalizeCallRequest(this->_call, ok); }
@@ -71,27 +164,62 @@ namespace ShuHai::gRPC::Server
         class CallHandlingAction : public CallHandlerAction
         {
         public:
-            CallHandlingAction(AsyncUnaryCallHandler* handler, Call* call, asio::execution_context* executionContext)
-                : CallHandlerAction(handler, call)
+            using CallHandlerAction::CallHandlerAction;
+
+            void perform(const Executor& executionContext)
             {
-                if (executionContext)
-                    asio::dispatch(asio::get_associated_executor(*executionContext), [this]() { perform(); });
-                else
-                    asio::dispatch([this]() { perform(); });
+                this->_call->dispatchTime = std::chrono::steady_clock::now();
+                AsyncUnaryCallHandler::dispatch(executionContext, [this]() { handle(); });
             }
 
             void finalizeResult(bool ok) override { this->_handler->finalizeCallHandling(this->_call, ok); }
 
         private:
-            void perform()
+            void handle()
             {
-                // Call handler func
                 auto call = this->_call;
-                const auto& func = this->_handler->_handleFunc;
-                call->response = func(call->context, call->request);
+                auto handler = this->_handler;
+                if (!handler->startHandling(call))
+                    return;
+
+                if (handler->_responderHandleFunc)
+                {
+                    handler->handleWithResponder(call);
+                    return;
+                }
+#ifdef SHUHAI_GRPC_HAS_COROUTINES
+                if (handler->_taskHandleFunc)
+                {
+                    handler->startTaskHandling(call);
+                    return;
+                }
+#endif
+
+                // Call handler func
+                try
+                {
+                    if (handler->_inPlaceHandleFunc)
+                        handler->_inPlaceHandleFunc(*call->context, *call->request, *call->response);
+                    else
+                        call->returnedResponse = handler->_handleFunc(*call->context, *call->request);
+                }
+                catch (...)
+                {
+                    handler->newCallFinish(call, AsyncUnaryCallHandler::errorStatus(std::current_exception()));
+                    return;
+                }
+
+                if (handler->_options.finishMode == AsyncCallFinishMode::Direct)
+                {
+                    handler->newCallFinish(call, grpc::Status::OK);
+                    return;
+                }
 
                 // Notify finalize
-                _alarm.Set(this->_handler->_completionQueue, gpr_now(GPR_CLOCK_MONOTONIC), this);
+                bool notified = handler->_actionQueue->tryStartOperation(
+                    [&]() { _alarm.Set(handler->_completionQueue, gpr_now(GPR_CLOCK_MONOTONIC), this->tag()); });
+                if (!notified)
+                    handler->completeCall(call);
             }
 
             grpc::Alarm _alarm;
@@ -100,19 +228,221 @@ namespace ShuHai::gRPC::Server
         class CallFinishAction : public CallHandlerAction
         {
         public:
-            CallFinishAction(AsyncUnaryCallHandler* handler, Call* call, const grpc::Status& status)
-                : CallHandlerAction(handler, call)
+            using CallHandlerAction::CallHandlerAction;
+
+            bool perform(const grpc::Status& status)
             {
-                this->_call->stream.Finish(call->response, status, this);
+                auto call = this->_call;
+                return this->_handler->_actionQueue->tryStartOperation(
+                    [&]() { call->stream->Finish(call->finalResponse(), status, this->tag()); });
             }
 
             void finalizeResult(bool ok) override { this->_handler->finalizeCallFinish(this->_call, ok); }
         };
 
+        class CallDoneAction : public CallHandlerAction
+        {
+        public:
+            using CallHandlerAction::CallHandlerAction;
+
+            void perform() { this->_call->context->AsyncNotifyWhenDone(this->tag()); }
+
+            void finalizeResult(bool ok) override { this->_handler->finalizeCallDone(this->_call); }
+        };
+
+        // Responders may complete their calls after the handler is destroyed, e.g. once the server is stopped, thus
+        // they find out whether the handler is still there through the state shared with it.
+        struct Lifetime
+        {
+            std::shared_mutex mutex;
+            bool alive = true;
+        };
+
+        class CallResponderTarget : public Responder<Response>::Target
+        {
+        public:
+            CallResponderTarget(AsyncUnaryCallHandler* handler, Call* call)
+                : _handler(handler)
+                , _call(call)
+                , _lifetime(handler->_lifetime)
+            { }
+
+            Response& response() override { return *_call->response; }
+
+            void finish(Response&& response) override
+            {
+                _call->returnedResponse = std::move(response);
+                finish(grpc::Status::OK);
+            }
+
+            void drop() override
+            {
+                // A responder dropped while the handle function is running is finished once the function returns,
+                // with the error of the function if it throws.
+                auto handling = HandlingState::Handling;
+                if (_handlingState.compare_exchange_strong(handling, HandlingState::Dropped, std::memory_order_acq_rel))
+                    return;
+                finish(droppedStatus());
+            }
+
+            void beginHandling() { _handlingState.store(HandlingState::Handling, std::memory_order_relaxed); }
+
+            // Whether the responder is dropped while the handle function is running.
+            bool endHandling()
+            {
+                auto state = _handlingState.exchange(HandlingState::Idle, std::memory_order_acq_rel);
+                return state == HandlingState::Dropped;
+            }
+
+            static grpc::Status droppedStatus()
+            {
+                return { grpc::StatusCode::INTERNAL, "The call is dropped without a response." };
+            }
+
+            void finish(const grpc::Status& status) override
+            {
+                std::shared_lock l(_lifetime->mutex);
+                if (_lifetime->alive)
+                {
+                    _handler->newCallFinish(_call, status);
+                    return;
+                }
+                l.unlock();
+
+                // The completion queue is drained before the handler is destroyed, nothing else refers to the call
+                // then. Neither the limiter nor the load reporter of the handler is guaranteed to be there anymore.
+                _call->admission.discardSample();
+                delete _call;
+            }
+
+        private:
+            enum class HandlingState
+            {
+                Idle,
+                Handling,
+                Dropped
+            };
+
+            AsyncUnaryCallHandler* const _handler;
+            Call* const _call;
+            const std::shared_ptr<Lifetime> _lifetime;
+            std::atomic<HandlingState> _handlingState { HandlingState::Idle };
+        };
+
+        // Call objects are reused, the request and the response are allocated on an arena which is reset between
+        // uses, and the actions of each stage are embedded, so that a call makes almost no allocation once its object
+        // is pooled.
+        class Call
+        {
+        public:
+            Call(AsyncUnaryCallHandler* handler, size_t arenaInitialBlockSize)
+                : requestAction(handler, this)
+                , handlingAction(handler, this)
+                , finishAction(handler, this)
+                , doneAction(handler, this)
+                , responderTarget(handler, this)
+                , _arenaBlock(arenaInitialBlockSize > 0 ? new char[arenaInitialBlockSize] : nullptr)
+                , _arena(makeArenaOptions(_arenaBlock.get(), arenaInitialBlockSize))
+            {
+                reset();
+            }
+
+            // Make the call ready for a new incoming rpc.
+            void reset()
+            {
+                admission.reset();
+                stream.reset();
+                context.reset();
+                request = nullptr;
+                response = nullptr;
+                returnedResponse.reset();
+                _arena.Reset();
+
+                // The cancellation flag is reused unless a token of the last rpc is still kept somewhere.
+                if (_cancelled && _cancelled.use_count() == 1)
+                    _cancelled->store(false, std::memory_order_relaxed);
+                else
+                    _cancelled = std::make_shared<std::atomic_bool>(false);
+
+                context.emplace(_cancelled);
+                stream.emplace(&*context);
+                request = google::protobuf::Arena::CreateMessage<Request>(&_arena);
+                response = google::protobuf::Arena::CreateMessage<Response>(&_arena);
+            }
+
+            ServiceRequestAction requestAction;
+            CallHandlingAction handlingAction;
+            CallFinishAction finishAction;
+            CallDoneAction doneAction;
+            CallResponderTarget responderTarget;
+            AsyncCallAdmission admission;
+
+            // A started call is released once it is finished and the done notification is delivered, in either order.
+            std::atomic<int> pendingCompletionCount {};
+
+        private:
+            static google::protobuf::ArenaOptions makeArenaOptions(char* block, size_t blockSize)
+            {
+                google::protobuf::ArenaOptions options;
+                options.initial_block = block;
+                options.initial_block_size = block ? blockSize : 0;
+                return options;
+            }
+
+            std::unique_ptr<char[]> _arenaBlock;
+            google::protobuf::Arena _arena;
+            std::shared_ptr<std::atomic_bool> _cancelled;
+
+        public:
+            std::optional<AsyncCallContext> context;
+            std::optional<StreamingInterface> stream;
+            Request* request {};
+            Response* response {};
+            // Response handed over by the handle function or the responder, which is sent instead of the one on the
+            // arena. Copying it to the arena would cost a deep copy per call.
+            std::optional<Response> returnedResponse;
+            std::chrono::steady_clock::time_point dispatchTime;
+
+            [[nodiscard]] const Response& finalResponse() const
+            {
+                return returnedResponse ? *returnedResponse : *response;
+            }
+        };
+
         void newCallRequest()
         {
-            auto call = new Call();
-            new ServiceRequestAction(this, call);
+            auto call = acquireCall();
+            call->pendingCompletionCount.store(2, std::memory_order_relaxed);
+            call->doneAction.perform();
+            call->requestAction.perform();
+        }
+
+        Call* acquireCall()
+        {
+            {
+                std::lock_guard l(_freeCallsMutex);
+                if (!_freeCalls.empty())
+                {
+                    auto call = _freeCalls.back();
+                    _freeCalls.pop_back();
+                    return call;
+                }
+            }
+            return new Call(this, this->_options.arenaInitialBlockSize);
+        }
+
+        void releaseCall(Call* call)
+        {
+            call->reset();
+
+            std::unique_lock l(_freeCallsMutex);
+            if (_freeCalls.size() < this->_options.callPoolCapacity)
+            {
+                _freeCalls.emplace_back(call);
+                return;
+            }
+            l.unlock();
+            delete call;
         }
 
         void finalizeCallRequest(Call* call, bool ok)
@@ -122,22 +452,83 @@ namespace ShuHai::gRPC::Server
 
             if (ok)
             {
+                this->_stats->consumedRequestCount.fetch_add(1, std::memory_order_relaxed);
                 newCallRequest();
 
-                new CallHandlingAction(this, call, _handleFuncExecutionContext);
+                call->admission = this->admitCall(this->_options.concurrencyLimiter.get());
+                if (!call->admission)
+                {
+                    newCallFinish(call, this->shedStatus());
+                    return;
+                }
+
+                call->handlingAction.perform(_handleFuncExecutionContext);
             }
             else
             {
-                delete call;
+                // The done notification is not delivered since the call never started.
+                releaseCall(call);
+            }
+        }
+
+        // Calls whose callers have already given up, i.e. cancelled or expired, or that waited too long while the
+        // execution context is overloaded, are dropped instead of being handled. Dropped calls finish almost at once,
+        // they are kept from the concurrency limiter which would otherwise take them as a drop of latency.
+        bool startHandling(Call* call)
+        {
+            auto now = std::chrono::steady_clock::now();
+            auto queueDelay = now - call->dispatchTime;
+            this->_stats->queueDelayNanoseconds.fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(queueDelay).count(), std::memory_order_relaxed);
+
+            if (call->context->cancelled())
+            {
+                this->_stats->cancelledCallCount.fetch_add(1, std::memory_order_relaxed);
+                call->admission.discardSample();
+                newCallFinish(call, this->cancelledStatus());
+                return false;
+            }
+
+            if (this->_options.skipExpiredCalls)
+            {
+                auto deadline = call->context->deadline();
+                if (deadline != std::chrono::system_clock::time_point::max()
+                    && deadline <= std::chrono::system_clock::now())
+                {
+                    this->_stats->expiredCallCount.fetch_add(1, std::memory_order_relaxed);
+                    call->admission.discardSample();
+                    newCallFinish(call, { grpc::StatusCode::DEADLINE_EXCEEDED, "Deadline exceeded before handling." });
+                    return false;
+                }
             }
+
+            auto& controller = this->_options.queueDelayController;
+            if (controller && controller->shouldDrop(queueDelay, now))
+            {
+                this->_stats->delayedCallCount.fetch_add(1, std::memory_order_relaxed);
+                call->admission.discardSample();
+                newCallFinish(
+                    call, { grpc::StatusCode::RESOURCE_EXHAUSTED, "The call waited too long to be handled." });
+                return false;
+            }
+            return true;
         }
 
         void finalizeCallHandling(Call* call, bool ok)
         {
             if (ok)
-                new CallFinishAction(this, call, grpc::Status::OK);
+                newCallFinish(call, grpc::Status::OK);
             else
-                delete call;
+                completeCall(call);
+        }
+
+        // Finishing may start from the handle function execution context after the completion queue is shut down, the
+        // call is dropped in that case.
+        void newCallFinish(Call* call, const grpc::Status& status)
+        {
+            this->reportLoad(*call->context);
+            if (!call->finishAction.perform(status))
+                completeCall(call);
         }
 
         void finalizeCallFinish(Call* call, bool ok)
@@ -146,10 +537,69 @@ namespace ShuHai::gRPC::Server
             // If it is false, it not going to the wire because the call is already dead (i.e., canceled, deadline
             // expired, other side dropped the channel, etc).
 
-            delete call;
+            completeCall(call);
         }
 
+        void finalizeCallDone(Call* call)
+        {
+            call->context->notifyDone();
+            completeCall(call);
+        }
+
+        void completeCall(Call* call)
+        {
+            if (call->pendingCompletionCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                releaseCall(call);
+        }
+
+        Responder<Response> newResponder(Call* call) { return Responder<Response>(&call->responderTarget); }
+
+        void handleWithResponder(Call* call)
+        {
+            auto& target = call->responderTarget;
+            target.beginHandling();
+
+            std::exception_ptr error;
+            try
+            {
+                _responderHandleFunc(*call->context, *call->request, newResponder(call));
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            // The responder kept by the function completes the call later, otherwise it is already dropped.
+            if (target.endHandling())
+                target.finish(error ? this->errorStatus(error) : CallResponderTarget::droppedStatus());
+        }
+
+#ifdef SHUHAI_GRPC_HAS_COROUTINES
+        // The call is finished from the thread that completes the task.
+        void startTaskHandling(Call* call)
+        {
+            startTask(_taskHandleFunc(*call->context, *call->request),
+                [responder = newResponder(call)](std::optional<Response> response, std::exception_ptr error) mutable
+                {
+                    if (error)
+                        responder.fail(AsyncUnaryCallHandler::errorStatus(error));
+                    else
+                        responder.respond(std::move(*response));
+                });
+        }
+#endif
+
         HandleFunc _handleFunc;
-        asio::execution_context* _handleFuncExecutionContext {};
+        InPlaceHandleFunc _inPlaceHandleFunc;
+        ResponderHandleFunc _responderHandleFunc;
+        Executor _handleFuncExecutionContext;
+#ifdef SHUHAI_GRPC_HAS_COROUTINES
+        TaskHandleFunc _taskHandleFunc;
+#endif
+
+        std::mutex _freeCallsMutex;
+        std::vector<Call*> _freeCalls;
+
+        const std::shared_ptr<Lifetime> _lifetime = std::make_shared<Lifetime>();
     };
 }
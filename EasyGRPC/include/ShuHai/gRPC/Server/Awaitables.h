@@ -0,0 +1,35 @@
+#pragma once
+
+#include "ShuHai/gRPC/Server/AsyncServerStreamWriter.h"
+#include "ShuHai/gRPC/Task.h"
+
+#ifdef SHUHAI_GRPC_HAS_COROUTINES
+
+namespace ShuHai::gRPC::Server
+{
+    /**
+     * \brief Awaitable of writing the specified \p message by the specified stream \p writer, the awaiting coroutine is
+     *  resumed from the completion queue thread once the write is done. The result of awaiting is the same as the
+     *  result of AsyncServerStreamWriter::write(), i.e. StreamingQueueFull is thrown if the write queue is full.
+     */
+    template<typename RequestFunc>
+    auto awaitWrite(AsyncServerStreamWriter<RequestFunc>& writer, ResponseTypeOf<RequestFunc> message,
+        grpc::WriteOptions options = {})
+    {
+        return awaitFuture<std::future<bool>>([&writer, m = std::move(message), options](auto callback) mutable
+            { writer.write(std::move(m), options, std::move(callback)); });
+    }
+
+    /**
+     * \brief Awaitable of finishing the specified stream \p writer with the specified \p status, the result of awaiting
+     *  is the same as the result of AsyncServerStreamWriter::finish().
+     */
+    template<typename RequestFunc>
+    auto awaitFinish(AsyncServerStreamWriter<RequestFunc>& writer, grpc::Status status = grpc::Status::OK)
+    {
+        return awaitFuture<std::future<bool>>([&writer, s = std::move(status)](auto callback) mutable
+            { writer.finish(std::move(s), std::move(callback)); });
+    }
+}
+
+#endif
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <grpcpp/support/status.h>
+
+#include <stdexcept>
+#include <utility>
+
+namespace ShuHai::gRPC::Server
+{
+    template<typename RequestFunc>
+    class AsyncUnaryCallHandler;
+
+    /**
+     * \brief Completes a unary call with a response or an error status, at any time and from any thread after the
+     *  handle function returns. The responder is move-only and completes its call exactly once; the call fails with
+     *  INTERNAL if the responder is destroyed before it completes the call.
+     *  A responder is allowed to outlive its server: once the server is stopped, the call is already cancelled by the
+     *  shutdown and completing it only releases the resources of the call.
+     */
+    template<typename Response>
+    class Responder
+    {
+    public:
+        /**
+         * \brief The call completed by a responder.
+         */
+        class Target
+        {
+        public:
+            virtual Response& response() = 0;
+
+            virtual void finish(const grpc::Status& status) = 0;
+
+            // Finish the call with the specified response, which is taken by the call rather than copied.
+            virtual void finish(Response&& response) = 0;
+
+            // Fail the call since its responder is destroyed before completing it.
+            virtual void drop() = 0;
+
+        protected:
+            ~Target() = default;
+        };
+
+        Responder() = default;
+
+        Responder(Responder&& other) noexcept
+            : _target(std::exchange(other._target, nullptr))
+        { }
+
+        Responder& operator=(Responder&& other) noexcept
+        {
+            if (this != &other)
+            {
+                dropIfPending();
+                _target = std::exchange(other._target, nullptr);
+            }
+            return *this;
+        }
+
+        Responder(const Responder&) = delete;
+        Responder& operator=(const Responder&) = delete;
+
+        ~Responder() { dropIfPending(); }
+
+        /**
+         * \brief Whether the call is not yet completed by current instance.
+         */
+        [[nodiscard]] bool pending() const { return _target; }
+
+        /**
+         * \brief The response of the call, which is allowed to be filled in place before respond() is called.
+         */
+        [[nodiscard]] Response& response() { return target()->response(); }
+
+        /**
+         * \brief Complete the call with the response filled in place.
+         */
+        void respond() { release()->finish(grpc::Status::OK); }
+
+        /**
+         * \brief Complete the call with the specified \p response, which is moved to the call rather than copied.
+         */
+        void respond(Response response) { release()->finish(std::move(response)); }
+
+        /**
+         * \brief Complete the call with the specified error \p status.
+         */
+        void fail(const grpc::Status& status)
+        {
+            if (status.ok())
+                throw std::invalid_argument("Failing a call requires an error status.");
+            release()->finish(status);
+        }
+
+    private:
+        template<typename RequestFunc>
+        friend class AsyncUnaryCallHandler;
+
+        explicit Responder(Target* target)
+            : _target(target)
+        { }
+
+        Target* target() const
+        {
+            if (!_target)
+                throw std::logic_error("The call is already completed.");
+            return _target;
+        }
+
+        Target* release()
+        {
+            auto t = target();
+            _target = nullptr;
+            return t;
+        }
+
+        void dropIfPending()
+        {
+            if (_target)
+                release()->drop();
+        }
+
+        Target* _target {};
+    };
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <grpcpp/support/string_ref.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+
+namespace ShuHai::gRPC
+{
+    /**
+     * \brief Load of a server, which is reported to clients by the trailing metadata of finished calls if enabled by
+     *  AsyncServerOptions::reportLoad, see ChannelSelection::ServerLoad.
+     */
+    struct ServerLoad
+    {
+        /**
+         * \brief Key of the trailing metadata that carries the load.
+         */
+        static constexpr const char* MetadataKey = "shuhai-server-load";
+
+        /**
+         * \brief Number of calls being handled by the server.
+         */
+        uint64_t inFlightCallCount {};
+
+        /**
+         * \brief Number of handle functions waiting for a thread of the server.
+         */
+        uint64_t queueDepth {};
+
+        /**
+         * \brief Share of time the completion queue threads of the server spent on handling events rather than
+         *  waiting for them, in range [0, 1].
+         */
+        double cpuBusyRatio {};
+
+        /**
+         * \brief Text form of current instance, as carried by the metadata.
+         */
+        [[nodiscard]] std::string toString() const
+        {
+            char buffer[96];
+            auto length = std::snprintf(buffer, sizeof(buffer), "%llu,%llu,%.3f",
+                static_cast<unsigned long long>(inFlightCallCount), static_cast<unsigned long long>(queueDepth),
+                cpuBusyRatio);
+            return std::string(buffer, static_cast<size_t>(length));
+        }
+
+        /**
+         * \brief Parse the load from its text form, empty if the text is malformed.
+         */
+        static std::optional<ServerLoad> parse(grpc::string_ref text)
+        {
+            // The metadata value is not null terminated.
+            std::string s(text.data(), text.size());
+            ServerLoad load;
+            char* end = nullptr;
+            load.inFlightCallCount = std::strtoull(s.c_str(), &end, 10);
+            if (*end != ',')
+                return std::nullopt;
+            load.queueDepth = std::strtoull(end + 1, &end, 10);
+            if (*end != ',')
+                return std::nullopt;
+            load.cpuBusyRatio = std::strtod(end + 1, &end);
+            if (*end != '\0' || !(load.cpuBusyRatio >= 0 && load.cpuBusyRatio <= 1))
+                return std::nullopt;
+            return load;
+        }
+    };
+}
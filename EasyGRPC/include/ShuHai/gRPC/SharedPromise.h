@@ -0,0 +1,80 @@
+#pragma once
+
+#include <future>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include <exception>
+#include <utility>
+
+namespace ShuHai::gRPC
+{
+    /**
+     * \brief Promise of a value that is set once and shared by any number of consumers, a consumer either waits for the
+     *  value by the shared future or gets notified by a callback once the value is ready.
+     */
+    template<typename T>
+    class SharedPromise
+    {
+    public:
+        using Callback = std::function<void(std::shared_future<T>)>;
+
+        SharedPromise()
+            : _future(_promise.get_future())
+        { }
+
+        SharedPromise(const SharedPromise&) = delete;
+        SharedPromise& operator=(const SharedPromise&) = delete;
+
+        [[nodiscard]] std::shared_future<T> future() const { return _future; }
+
+        /**
+         * \brief Call the specified \p callback with the future once the value is ready, on the thread that sets the
+         *  value, or immediately if the value is already set.
+         */
+        void then(Callback callback)
+        {
+            std::unique_lock l(_mutex);
+            if (!_ready)
+            {
+                _callbacks.emplace_back(std::move(callback));
+                return;
+            }
+            l.unlock();
+
+            callback(_future);
+        }
+
+        void setValue(T value)
+        {
+            std::unique_lock l(_mutex);
+            _promise.set_value(std::move(value));
+            notify(l);
+        }
+
+        void setException(std::exception_ptr exception)
+        {
+            std::unique_lock l(_mutex);
+            _promise.set_exception(std::move(exception));
+            notify(l);
+        }
+
+    private:
+        void notify(std::unique_lock<std::mutex>& lock)
+        {
+            _ready = true;
+            auto callbacks = std::exchange(_callbacks, {});
+            lock.unlock();
+
+            for (auto& callback : callbacks)
+                callback(_future);
+        }
+
+        std::promise<T> _promise;
+        std::shared_future<T> _future;
+
+        std::mutex _mutex;
+        bool _ready {};
+        std::vector<Callback> _callbacks;
+    };
+}
@@ -11,4 +11,15 @@ namespace ShuHai::gRPC
             : std::logic_error(message)
         { }
     };
+
+    /**
+     * \brief Throws when a message is written to a stream whose write queue is already full.
+     */
+    class StreamingQueueFull : public std::runtime_error
+    {
+    public:
+        explicit StreamingQueueFull(const char* message)
+            : std::runtime_error(message)
+        { }
+    };
 }
@@ -0,0 +1,344 @@
+#pragma once
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define SHUHAI_GRPC_HAS_COROUTINES 1
+#endif
+
+#ifdef SHUHAI_GRPC_HAS_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <variant>
+#include <atomic>
+#include <utility>
+#include <stdexcept>
+#include <type_traits>
+
+namespace ShuHai::gRPC
+{
+    template<typename T = void>
+    class Task;
+
+    namespace TaskDetail
+    {
+        // The awaiting coroutine (if any) is resumed by symmetric transfer once the task completes.
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept { return false; }
+
+            template<typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+            {
+                auto continuation = handle.promise().continuation();
+                return continuation ? continuation : std::noop_coroutine();
+            }
+
+            void await_resume() noexcept { }
+        };
+
+        class PromiseBase
+        {
+        public:
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            FinalAwaiter final_suspend() noexcept { return {}; }
+
+            [[nodiscard]] std::coroutine_handle<> continuation() const { return _continuation; }
+
+            void setContinuation(std::coroutine_handle<> continuation) { _continuation = continuation; }
+
+        private:
+            std::coroutine_handle<> _continuation;
+        };
+
+        // Coroutine that starts immediately and destroys itself once it completes.
+        struct DetachedTask
+        {
+            struct promise_type
+            {
+                DetachedTask get_return_object() noexcept { return {}; }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() noexcept { }
+                void unhandled_exception() noexcept { std::terminate(); }
+            };
+        };
+    }
+
+    /**
+     * \brief Lazily started coroutine that produces a value of type \p T. The task starts when it is awaited, and the
+     *  awaiting coroutine is resumed on the thread that completes the task, e.g. the completion queue thread that
+     *  finalizes the last operation awaited by the task.
+     */
+    template<typename T>
+    class Task
+    {
+    public:
+        class promise_type : public TaskDetail::PromiseBase
+        {
+        public:
+            Task get_return_object() noexcept { return Task(Handle::from_promise(*this)); }
+
+            template<typename U>
+            void return_value(U&& value)
+            {
+                _result.template emplace<1>(std::forward<U>(value));
+            }
+
+            void unhandled_exception() noexcept { _result.template emplace<2>(std::current_exception()); }
+
+            T result()
+            {
+                if (_result.index() == 2)
+                    std::rethrow_exception(std::get<2>(_result));
+                return std::move(std::get<1>(_result));
+            }
+
+        private:
+            std::variant<std::monostate, T, std::exception_ptr> _result;
+        };
+
+        using Handle = std::coroutine_handle<promise_type>;
+
+        Task(Task&& other) noexcept
+            : _handle(std::exchange(other._handle, {}))
+        { }
+
+        Task& operator=(Task&& other) noexcept
+        {
+            if (this != &other)
+            {
+                destroy();
+                _handle = std::exchange(other._handle, {});
+            }
+            return *this;
+        }
+
+        ~Task() { destroy(); }
+
+        auto operator co_await() &&
+        {
+            struct Awaiter
+            {
+                bool await_ready() noexcept { return handle.done(); }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+                {
+                    handle.promise().setContinuation(awaiting);
+                    return handle;
+                }
+
+                T await_resume() { return handle.promise().result(); }
+
+                Handle handle;
+            };
+            // A moved-from task has no coroutine to await.
+            if (!_handle)
+                throw std::logic_error("Awaiting an empty task.");
+            return Awaiter { _handle };
+        }
+
+    private:
+        explicit Task(Handle handle)
+            : _handle(handle)
+        { }
+
+        void destroy()
+        {
+            if (_handle)
+                _handle.destroy();
+            _handle = {};
+        }
+
+        Handle _handle;
+    };
+
+    template<>
+    class Task<void>
+    {
+    public:
+        class promise_type : public TaskDetail::PromiseBase
+        {
+        public:
+            Task get_return_object() noexcept { return Task(Handle::from_promise(*this)); }
+
+            void return_void() noexcept { }
+
+            void unhandled_exception() noexcept { _exception = std::current_exception(); }
+
+            void result()
+            {
+                if (_exception)
+                    std::rethrow_exception(_exception);
+            }
+
+        private:
+            std::exception_ptr _exception;
+        };
+
+        using Handle = std::coroutine_handle<promise_type>;
+
+        Task(Task&& other) noexcept
+            : _handle(std::exchange(other._handle, {}))
+        { }
+
+        Task& operator=(Task&& other) noexcept
+        {
+            if (this != &other)
+            {
+                destroy();
+                _handle = std::exchange(other._handle, {});
+            }
+            return *this;
+        }
+
+        ~Task() { destroy(); }
+
+        auto operator co_await() &&
+        {
+            struct Awaiter
+            {
+                bool await_ready() noexcept { return handle.done(); }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+                {
+                    handle.promise().setContinuation(awaiting);
+                    return handle;
+                }
+
+                void await_resume() { handle.promise().result(); }
+
+                Handle handle;
+            };
+            // A moved-from task has no coroutine to await.
+            if (!_handle)
+                throw std::logic_error("Awaiting an empty task.");
+            return Awaiter { _handle };
+        }
+
+    private:
+        explicit Task(Handle handle)
+            : _handle(handle)
+        { }
+
+        void destroy()
+        {
+            if (_handle)
+                _handle.destroy();
+            _handle = {};
+        }
+
+        Handle _handle;
+    };
+
+    template<typename T>
+    struct IsTask : std::false_type
+    { };
+
+    template<typename T>
+    struct IsTask<Task<T>> : std::true_type
+    { };
+
+    template<typename T>
+    inline constexpr bool IsTaskV = IsTask<T>::value;
+
+    template<typename EnabledType, typename Func, typename... Args>
+    using EnableIfTaskInvocable = std::enable_if_t<IsTaskV<std::invoke_result_t<Func&, Args...>>, EnabledType>;
+
+    namespace TaskDetail
+    {
+        template<typename T, typename Func>
+        DetachedTask start(Task<T> task, Func onCompleted)
+        {
+            std::exception_ptr error;
+            if constexpr (std::is_void_v<T>)
+            {
+                try
+                {
+                    co_await std::move(task);
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+                onCompleted(error);
+            }
+            else
+            {
+                std::optional<T> result;
+                try
+                {
+                    result.emplace(co_await std::move(task));
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+                onCompleted(std::move(result), error);
+            }
+        }
+    }
+
+    /**
+     * \brief Start the specified \p task without awaiting it. \p onCompleted is called on the thread that completes the
+     *  task, with the signature void(std::optional<T>, std::exception_ptr), or void(std::exception_ptr) if \p T is
+     *  void. The exception pointer is null unless the task throws.
+     */
+    template<typename T, typename Func>
+    void startTask(Task<T> task, Func onCompleted)
+    {
+        TaskDetail::start(std::move(task), std::move(onCompleted));
+    }
+
+    /**
+     * \brief Awaits an operation that reports its result through a callback taking a future, e.g. the callback of an
+     *  AsyncAction. The awaiting coroutine is resumed by the callback, which is called from the completion queue thread
+     *  in most cases; the coroutine continues without suspending if the result is reported before the operation
+     *  returns.
+     */
+    template<typename Future, typename StartFunc>
+    class FutureAwaiter
+    {
+    public:
+        explicit FutureAwaiter(StartFunc start)
+            : _start(std::move(start))
+        { }
+
+        bool await_ready() noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> awaiting)
+        {
+            _awaiting = awaiting;
+            _start(
+                [this](Future future)
+                {
+                    _future = std::move(future);
+                    // Whoever comes second resumes the coroutine.
+                    if (_reported.exchange(true, std::memory_order_acq_rel))
+                        _awaiting.resume();
+                });
+            return !_reported.exchange(true, std::memory_order_acq_rel);
+        }
+
+        auto await_resume() { return _future.get(); }
+
+    private:
+        StartFunc _start;
+        std::coroutine_handle<> _awaiting;
+        std::atomic_bool _reported { false };
+        Future _future;
+    };
+
+    /**
+     * \brief Make an awaitable for an operation started by \p start, which is called with the callback to report the
+     *  result of the operation by a future of type \p Future.
+     */
+    template<typename Future, typename StartFunc>
+    FutureAwaiter<Future, std::decay_t<StartFunc>> awaitFuture(StartFunc&& start)
+    {
+        return FutureAwaiter<Future, std::decay_t<StartFunc>>(std::forward<StartFunc>(start));
+    }
+}
+
+#endif
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace ShuHai::gRPC
+{
+    /**
+     * \brief Restrict the calling thread to run on the specified CPUs only.
+     * \return true if the affinity is applied, false if any of the CPUs is not available or the platform does not
+     *  support setting the affinity of threads.
+     */
+    inline bool setCurrentThreadAffinity(const std::vector<size_t>& cpus)
+    {
+#ifdef __linux__
+        if (cpus.empty())
+            return false;
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (auto cpu : cpus)
+        {
+            if (cpu >= CPU_SETSIZE)
+                return false;
+            CPU_SET(cpu, &set);
+        }
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        (void)cpus;
+        return false;
+#endif
+    }
+
+    /**
+     * \brief Invoke the specified function on a temporary thread restricted to the specified CPUs, and wait for its
+     *  result. Memory first touched by the function is thus allocated on the NUMA node of the CPUs by the default
+     *  policy of the operating system, which keeps long-lived state near the threads that use it. The function is
+     *  invoked on the calling thread if \p cpus is empty.
+     */
+    template<typename Func>
+    std::invoke_result_t<Func&> invokeOnCpus(const std::vector<size_t>& cpus, Func&& func)
+    {
+        using Result = std::invoke_result_t<Func&>;
+        if (cpus.empty())
+            return func();
+
+        std::conditional_t<std::is_void_v<Result>, bool, std::optional<Result>> result {};
+        std::exception_ptr error;
+        std::thread(
+            [&]()
+            {
+                setCurrentThreadAffinity(cpus);
+                try
+                {
+                    if constexpr (std::is_void_v<Result>)
+                        func();
+                    else
+                        result.emplace(func());
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+            })
+            .join();
+
+        if (error)
+            std::rethrow_exception(error);
+        if constexpr (!std::is_void_v<Result>)
+            return std::move(*result);
+    }
+}
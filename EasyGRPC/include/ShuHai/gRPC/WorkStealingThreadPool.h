@@ -0,0 +1,214 @@
+#pragma once
+
+#include "ShuHai/gRPC/ThreadAffinity.h"
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <cstddef>
+
+namespace ShuHai::gRPC
+{
+    /**
+     * \brief Thread pool in which each worker thread owns a queue of functions, so that threads posting functions
+     *  rarely contend with each other. Functions posted from outside the pool are spread over the workers in turn,
+     *  functions posted by a worker go to its own queue, and a worker that runs out of functions steals from the others.
+     *  The pool is usable as an Executor, e.g. the default executor of handle functions of Server::AsyncServer.
+     */
+    class WorkStealingThreadPool
+    {
+    public:
+        struct Options
+        {
+            /**
+             * \brief Number of worker threads, the number of hardware threads if zero.
+             */
+            size_t threadCount = 0;
+
+            /**
+             * \brief CPUs the worker threads are pinned to, worker i is pinned to cpus[i % cpus.size()]. The threads
+             *  are not pinned if empty.
+             */
+            std::vector<size_t> cpus;
+        };
+
+        WorkStealingThreadPool()
+            : WorkStealingThreadPool(Options())
+        { }
+
+        explicit WorkStealingThreadPool(const Options& options)
+        {
+            size_t count = options.threadCount;
+            if (count == 0)
+                count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+            for (size_t i = 0; i < count; ++i)
+                _workers.emplace_back(std::make_unique<Worker>());
+            for (size_t i = 0; i < count; ++i)
+            {
+                std::vector<size_t> cpus;
+                if (!options.cpus.empty())
+                    cpus.emplace_back(options.cpus[i % options.cpus.size()]);
+                _workers[i]->thread = std::thread([this, i, cpus]() { run(i, cpus); });
+            }
+        }
+
+        ~WorkStealingThreadPool() { join(); }
+
+        WorkStealingThreadPool(const WorkStealingThreadPool&) = delete;
+        WorkStealingThreadPool& operator=(const WorkStealingThreadPool&) = delete;
+
+        [[nodiscard]] size_t threadCount() const { return _workers.size(); }
+
+        /**
+         * \brief Number of functions queued but not yet taken by a worker thread.
+         */
+        [[nodiscard]] size_t pendingCount() const { return _pendingCount.load(std::memory_order_relaxed); }
+
+        /**
+         * \brief Queue the specified function to be executed by one of the worker threads.
+         */
+        template<typename Func>
+        void post(Func&& func)
+        {
+            const auto& current = currentWorker();
+            if (current.pool != this && _stopping.load(std::memory_order_acquire))
+                throw std::logic_error("The thread pool is joined.");
+
+            // Counted before queued, so that the count never drops below zero once the function is taken.
+            _pendingCount.fetch_add(1, std::memory_order_seq_cst);
+            size_t index = current.pool == this
+                ? current.index
+                : _nextWorkerIndex.fetch_add(1, std::memory_order_relaxed) % _workers.size();
+            {
+                auto& worker = *_workers[index];
+                std::lock_guard l(worker.mutex);
+                worker.functions.emplace_back(std::forward<Func>(func));
+            }
+
+            if (_sleepingCount.load(std::memory_order_seq_cst) > 0)
+            {
+                std::lock_guard l(_idleMutex);
+                _idleCondition.notify_one();
+            }
+        }
+
+        /**
+         * \brief Execute the specified function right away if the calling thread is a worker of current pool, or post
+         *  it otherwise.
+         */
+        template<typename Func>
+        void dispatch(Func&& func)
+        {
+            if (currentWorker().pool == this)
+                std::forward<Func>(func)();
+            else
+                post(std::forward<Func>(func));
+        }
+
+        /**
+         * \brief Wait for all queued functions to finish and stop the worker threads. Functions are still allowed to
+         *  be posted by the running functions meanwhile, but not by other threads.
+         */
+        void join()
+        {
+            {
+                std::lock_guard l(_idleMutex);
+                _stopping.store(true, std::memory_order_release);
+            }
+            _idleCondition.notify_all();
+
+            for (auto& worker : _workers)
+            {
+                if (worker->thread.joinable())
+                    worker->thread.join();
+            }
+        }
+
+    private:
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<std::function<void()>> functions;
+            std::thread thread;
+        };
+
+        struct CurrentWorker
+        {
+            const WorkStealingThreadPool* pool {};
+            size_t index {};
+        };
+
+        static CurrentWorker& currentWorker()
+        {
+            thread_local CurrentWorker current;
+            return current;
+        }
+
+        void run(size_t index, const std::vector<size_t>& cpus)
+        {
+            currentWorker() = { this, index };
+            if (!cpus.empty())
+                setCurrentThreadAffinity(cpus);
+
+            while (true)
+            {
+                if (auto func = take(index))
+                {
+                    func();
+                    continue;
+                }
+
+                std::unique_lock l(_idleMutex);
+                _sleepingCount.fetch_add(1, std::memory_order_seq_cst);
+                _idleCondition.wait(l,
+                    [this]()
+                    {
+                        return _pendingCount.load(std::memory_order_seq_cst) > 0
+                            || _stopping.load(std::memory_order_relaxed);
+                    });
+                _sleepingCount.fetch_sub(1, std::memory_order_relaxed);
+                if (_stopping.load(std::memory_order_relaxed) && _pendingCount.load(std::memory_order_acquire) == 0)
+                    break;
+            }
+
+            currentWorker() = {};
+        }
+
+        // Take the oldest function from the worker's own queue, or steal one from other workers if it is empty.
+        std::function<void()> take(size_t index)
+        {
+            for (size_t i = 0; i < _workers.size(); ++i)
+            {
+                auto& worker = *_workers[(index + i) % _workers.size()];
+                std::lock_guard l(worker.mutex);
+                if (worker.functions.empty())
+                    continue;
+
+                auto func = std::move(worker.functions.front());
+                worker.functions.pop_front();
+                _pendingCount.fetch_sub(1, std::memory_order_relaxed);
+                return func;
+            }
+            return {};
+        }
+
+        std::vector<std::unique_ptr<Worker>> _workers;
+        std::atomic<size_t> _nextWorkerIndex { 0 };
+
+        // Number of functions posted but not yet taken, workers sleep only when there is none.
+        std::atomic<size_t> _pendingCount { 0 };
+        std::atomic<size_t> _sleepingCount { 0 };
+        std::mutex _idleMutex;
+        std::condition_variable _idleCondition;
+        std::atomic_bool _stopping { false };
+    };
+}
@@ -0,0 +1,130 @@
+#include "ThreadPlacement.grpc.pb.h"
+
+#include <ShuHai/gRPC/Server/AsyncServer.h>
+#include <ShuHai/gRPC/Client/AsyncClient.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ShuHai::gRPC;
+using namespace ShuHai::gRPC::Benchmarks::ThreadPlacement;
+
+using AsyncServer = Server::AsyncServer<Echo::AsyncService>;
+using AsyncClient = Client::AsyncClient<Echo::Stub>;
+using Clock = std::chrono::steady_clock;
+
+struct Settings
+{
+    uint16_t port = 55240;
+    size_t calls = 100000;
+    size_t warmupCalls = 10000;
+    size_t concurrency = 16;
+    size_t queues = 2;
+    size_t pollers = 1;
+    size_t firstCpu = 0;
+};
+
+// Issue calls from the specified number of concurrent callers, each caller waits for the response of its last call
+// before making the next one. Returns the number of calls per second.
+double runCalls(AsyncClient& client, size_t calls, size_t concurrency)
+{
+    std::vector<std::thread> callers;
+
+    auto begin = Clock::now();
+    for (size_t i = 0; i < concurrency; ++i)
+    {
+        callers.emplace_back(
+            [&client, count = calls / concurrency]()
+            {
+                EchoMessage request;
+                request.set_text("benchmark");
+                for (size_t n = 0; n < count; ++n)
+                {
+                    request.set_value(static_cast<int64_t>(n));
+                    client.call(&Echo::Stub::AsyncEcho, request)->response().get();
+                }
+            });
+    }
+    for (auto& c : callers)
+        c.join();
+
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    return static_cast<double>(calls / concurrency * concurrency) / seconds;
+}
+
+// Server queue i is pinned to CPU firstCpu + i, the client queue to the CPU next to the last server queue.
+double runPlacement(const Settings& settings, bool pinned, uint16_t port)
+{
+    Server::AsyncServerOptions serverOptions;
+    serverOptions.completionQueueCount = settings.queues;
+    serverOptions.pollers.threadCount = settings.pollers;
+    serverOptions.inlineHandlers = true;
+    Client::AsyncClientOptions clientOptions;
+    clientOptions.pollers.threadCount = settings.pollers;
+    if (pinned)
+    {
+        size_t cpuCount = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        for (size_t i = 0; i < settings.queues; ++i)
+            serverOptions.pollers.cpuSets.push_back({ (settings.firstCpu + i) % cpuCount });
+        clientOptions.pollers.cpuSets.push_back({ (settings.firstCpu + settings.queues) % cpuCount });
+    }
+
+    AsyncServer server({ "0.0.0.0:" + std::to_string(port) }, serverOptions);
+    server.registerCallHandler(
+        &Echo::AsyncService::RequestEcho, [](grpc::ServerContext&, const EchoMessage& request) { return request; });
+    server.start();
+
+    AsyncClient client("localhost:" + std::to_string(port), grpc::InsecureChannelCredentials(), {}, clientOptions);
+    runCalls(client, settings.warmupCalls, settings.concurrency);
+    return runCalls(client, settings.calls, settings.concurrency);
+}
+
+bool parseArgument(const char* arg, const char* name, size_t& value)
+{
+    auto length = std::strlen(name);
+    if (std::strncmp(arg, name, length) != 0 || arg[length] != '=')
+        return false;
+    value = std::stoul(arg + length + 1);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    for (int i = 1; i < argc; ++i)
+    {
+        size_t port = settings.port;
+        bool parsed = parseArgument(argv[i], "--calls", settings.calls)
+            || parseArgument(argv[i], "--warmup", settings.warmupCalls)
+            || parseArgument(argv[i], "--concurrency", settings.concurrency)
+            || parseArgument(argv[i], "--queues", settings.queues)
+            || parseArgument(argv[i], "--pollers", settings.pollers)
+            || parseArgument(argv[i], "--first-cpu", settings.firstCpu)
+            || parseArgument(argv[i], "--port", port);
+        if (!parsed)
+        {
+            std::printf("Usage: %s [--calls=N] [--warmup=N] [--concurrency=N] [--queues=N] [--pollers=N] "
+                        "[--first-cpu=N] [--port=N]\n",
+                argv[0]);
+            return EXIT_FAILURE;
+        }
+        settings.port = static_cast<uint16_t>(port);
+    }
+    settings.concurrency = std::max<size_t>(settings.concurrency, 1);
+    settings.queues = std::max<size_t>(settings.queues, 1);
+    settings.pollers = std::max<size_t>(settings.pollers, 1);
+
+    std::printf("calls=%zu concurrency=%zu queues=%zu pollers=%zu first-cpu=%zu\n", settings.calls,
+        settings.concurrency, settings.queues, settings.pollers, settings.firstCpu);
+    std::printf("%-16s %12s\n", "placement", "calls/s");
+
+    std::printf("%-16s %12.0f\n", "Unpinned", runPlacement(settings, false, settings.port));
+    std::printf("%-16s %12.0f\n", "Pinned", runPlacement(settings, true, settings.port + 1));
+
+    return EXIT_SUCCESS;
+}
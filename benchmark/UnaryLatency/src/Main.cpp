@@ -0,0 +1,180 @@
+#include "UnaryLatency.grpc.pb.h"
+
+#include <ShuHai/gRPC/Server/AsyncServer.h>
+#include <ShuHai/gRPC/Client/AsyncClient.h>
+
+#include <asio/thread_pool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ShuHai::gRPC;
+using namespace ShuHai::gRPC::Benchmarks::UnaryLatency;
+
+using AsyncServer = Server::AsyncServer<Echo::AsyncService>;
+using AsyncClient = Client::AsyncClient<Echo::Stub>;
+using Clock = std::chrono::steady_clock;
+
+struct Settings
+{
+    uint16_t port = 55230;
+    size_t calls = 100000;
+    size_t warmupCalls = 10000;
+    size_t concurrency = 8;
+    size_t queues = 1;
+    size_t executorThreads = 0;
+    size_t inlineHandlers = 0;
+    size_t spinMicroseconds = 0;
+    size_t clientQueues = 1;
+    size_t channels = 1;
+};
+
+struct Result
+{
+    double seconds {};
+    std::vector<double> latencies; // In microseconds, sorted.
+};
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    auto index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// Issue calls from the specified number of concurrent callers, each caller waits for the response of its last call
+// before making the next one.
+Result runCalls(AsyncClient& client, size_t calls, size_t concurrency)
+{
+    std::vector<std::vector<double>> latencies(concurrency);
+    std::vector<std::thread> callers;
+
+    auto begin = Clock::now();
+    for (size_t i = 0; i < concurrency; ++i)
+    {
+        callers.emplace_back(
+            [&client, &latencies, i, count = calls / concurrency]()
+            {
+                EchoMessage request;
+                request.set_text("benchmark");
+                latencies[i].reserve(count);
+                for (size_t n = 0; n < count; ++n)
+                {
+                    request.set_value(static_cast<int64_t>(n));
+                    auto t = Clock::now();
+                    client.call(&Echo::Stub::AsyncEcho, request)->response().get();
+                    latencies[i].push_back(std::chrono::duration<double, std::micro>(Clock::now() - t).count());
+                }
+            });
+    }
+    for (auto& c : callers)
+        c.join();
+
+    Result result;
+    result.seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    for (auto& l : latencies)
+        result.latencies.insert(result.latencies.end(), l.begin(), l.end());
+    std::sort(result.latencies.begin(), result.latencies.end());
+    return result;
+}
+
+Result runMode(const Settings& settings, Server::AsyncCallFinishMode mode, uint16_t port)
+{
+    std::unique_ptr<asio::thread_pool> executor;
+    if (settings.executorThreads > 0)
+        executor = std::make_unique<asio::thread_pool>(settings.executorThreads);
+
+    Server::AsyncServerOptions serverOptions;
+    serverOptions.completionQueueCount = settings.queues;
+    serverOptions.inlineHandlers = settings.inlineHandlers != 0;
+    if (settings.spinMicroseconds > 0)
+        serverOptions.pollers.spinDurations = { std::chrono::microseconds(settings.spinMicroseconds) };
+    AsyncServer server({ "0.0.0.0:" + std::to_string(port) }, serverOptions);
+    Server::AsyncCallHandlerOptions options;
+    options.finishMode = mode;
+    server.registerCallHandler(
+        &Echo::AsyncService::RequestEcho, [](grpc::ServerContext&, const EchoMessage& request) { return request; },
+        executor.get(), {}, options);
+    server.start();
+
+    Result result;
+    {
+        Client::AsyncClientOptions clientOptions;
+        clientOptions.completionQueueCount = settings.clientQueues;
+        clientOptions.channelCount = std::max<size_t>(settings.channels, 1);
+        clientOptions.pollers.spinDurations = serverOptions.pollers.spinDurations;
+        AsyncClient client("localhost:" + std::to_string(port), grpc::InsecureChannelCredentials(), {}, clientOptions);
+        runCalls(client, settings.warmupCalls, settings.concurrency);
+        result = runCalls(client, settings.calls, settings.concurrency);
+    }
+
+    if (executor)
+        executor->join();
+    return result;
+}
+
+void printResult(const char* name, const Result& result)
+{
+    const auto& l = result.latencies;
+    std::printf("%-16s %12.0f %10.1f %10.1f %10.1f %10.1f\n", name, static_cast<double>(l.size()) / result.seconds,
+        percentile(l, 0.5), percentile(l, 0.9), percentile(l, 0.99), percentile(l, 0.999));
+}
+
+bool parseArgument(const char* arg, const char* name, size_t& value)
+{
+    auto length = std::strlen(name);
+    if (std::strncmp(arg, name, length) != 0 || arg[length] != '=')
+        return false;
+    value = std::stoul(arg + length + 1);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    for (int i = 1; i < argc; ++i)
+    {
+        size_t port = settings.port;
+        bool parsed = parseArgument(argv[i], "--calls", settings.calls)
+            || parseArgument(argv[i], "--warmup", settings.warmupCalls)
+            || parseArgument(argv[i], "--concurrency", settings.concurrency)
+            || parseArgument(argv[i], "--queues", settings.queues)
+            || parseArgument(argv[i], "--executor-threads", settings.executorThreads)
+            || parseArgument(argv[i], "--inline-handlers", settings.inlineHandlers)
+            || parseArgument(argv[i], "--spin-us", settings.spinMicroseconds)
+            || parseArgument(argv[i], "--client-queues", settings.clientQueues)
+            || parseArgument(argv[i], "--channels", settings.channels)
+            || parseArgument(argv[i], "--port", port);
+        if (!parsed)
+        {
+            std::printf("Usage: %s [--calls=N] [--warmup=N] [--concurrency=N] [--queues=N] [--executor-threads=N] "
+                        "[--inline-handlers=0|1] [--spin-us=N] [--client-queues=N] [--channels=N] "
+                        "[--port=N]\n",
+                argv[0]);
+            return EXIT_FAILURE;
+        }
+        settings.port = static_cast<uint16_t>(port);
+    }
+    settings.concurrency = std::max<size_t>(settings.concurrency, 1);
+
+    std::printf("calls=%zu concurrency=%zu queues=%zu executor-threads=%zu inline-handlers=%zu spin-us=%zu "
+                "client-queues=%zu channels=%zu\n",
+        settings.calls, settings.concurrency, settings.queues, settings.executorThreads, settings.inlineHandlers,
+        settings.spinMicroseconds, settings.clientQueues, settings.channels);
+    std::printf("%-16s %12s %10s %10s %10s %10s\n", "finish mode", "calls/s", "p50(us)", "p90(us)", "p99(us)",
+        "p99.9(us)");
+
+    auto cq = runMode(settings, Server::AsyncCallFinishMode::CompletionQueue, settings.port);
+    printResult("CompletionQueue", cq);
+
+    auto direct = runMode(settings, Server::AsyncCallFinishMode::Direct, settings.port + 1);
+    printResult("Direct", direct);
+
+    return EXIT_SUCCESS;
+}
@@ -6,6 +6,9 @@
 #include <ShuHai/gRPC/Server/AsyncServer.h>
 #include <ShuHai/gRPC/Client/AsyncClient.h>
 
+#include <algorithm>
+#include <future>
+
 using namespace ShuHai::gRPC;
 using namespace ShuHai::gRPC::Examples;
 using namespace ShuHai::gRPC::Examples::Streaming;
@@ -14,23 +17,31 @@ using AsyncServer = Server::AsyncServer<Application::AsyncService>;
 using AsyncClient = Client::AsyncClient<Application::Stub>;
 
 using RequestFunc = decltype(&Application::AsyncService::RequestSetFeatures);
+using ServerStreamRequestFunc = decltype(&Application::AsyncService::RequestGetFeatures);
+using ServerStreamWriter = Server::AsyncServerStreamWriter<ServerStreamRequestFunc>;
+using BidiStreamRequestFunc = decltype(&Application::AsyncService::RequestExchangeFeatures);
+using BidiStreamHandler = Server::AsyncBidiStreamCallHandler<BidiStreamRequestFunc>;
 
-SetFeaturesReply handleClientStream(
-    grpc::ServerContext& context, Server::AsyncClientStreamReader<RequestFunc>& streamReader)
-{
-    SetFeaturesReply reply;
+using ClientStreamHandler = Server::AsyncClientStreamCallHandler<RequestFunc>::StreamHandler;
 
+ClientStreamHandler handleClientStream(grpc::ServerContext& context)
+{
     console().writeLine("[Server] Start read client stream...");
-    int count = 0;
-    while (streamReader.moveNext().get())
+
+    auto count = std::make_shared<int>(0);
+    ClientStreamHandler handler;
+    handler.onRead = [count](const Feature& request)
     {
-        const auto& request = streamReader.current();
         console().writeLine("[Server] Request received: %s=%s", request.name().c_str(), request.value().c_str());
-        count++;
-    }
-    reply.set_count(count);
-
-    return reply;
+        (*count)++;
+    };
+    handler.onReadDone = [count]()
+    {
+        SetFeaturesReply reply;
+        reply.set_count(*count);
+        return reply;
+    };
+    return handler;
 }
 
 void registerClientStreamHandler(AsyncServer& server)
@@ -38,6 +49,62 @@ void registerClientStreamHandler(AsyncServer& server)
     server.registerCallHandler(&Application::AsyncService::RequestSetFeatures, &handleClientStream);
 }
 
+// Write features until the write queue is full, and continue once the writer turns writable again.
+void writeFeatures(const std::shared_ptr<ServerStreamWriter>& streamWriter, int next, int count)
+{
+    for (; next < count; ++next)
+    {
+        if (!streamWriter->writable())
+        {
+            std::weak_ptr<ServerStreamWriter> weakWriter = streamWriter;
+            streamWriter->setWritableCallback(
+                [weakWriter, next, count]()
+                {
+                    if (auto w = weakWriter.lock())
+                        writeFeatures(w, next, count);
+                });
+            return;
+        }
+
+        Feature feature;
+        feature.set_name(std::to_string(next));
+        feature.set_value(std::to_string(next));
+        streamWriter->write(std::move(feature));
+    }
+
+    streamWriter->finish();
+    console().writeLine("[Server] Server stream finished: %d features written", count);
+}
+
+void registerServerStreamHandler(AsyncServer& server)
+{
+    server.registerCallHandler(&Application::AsyncService::RequestGetFeatures,
+        [](grpc::ServerContext& context, const GetFeaturesRequest& request,
+            std::shared_ptr<ServerStreamWriter> streamWriter) { writeFeatures(streamWriter, 0, request.count()); });
+}
+
+void registerBidiStreamHandler(AsyncServer& server)
+{
+    server.registerCallHandler(&Application::AsyncService::RequestExchangeFeatures,
+        [](grpc::ServerContext& context, std::shared_ptr<BidiStreamHandler::StreamWriter> streamWriter)
+        {
+            BidiStreamHandler::StreamHandler handler;
+            handler.onRead = [streamWriter](const Feature& request)
+            {
+                // Echo the feature back with its value reversed.
+                Feature feature = request;
+                std::reverse(feature.mutable_value()->begin(), feature.mutable_value()->end());
+                streamWriter->write(std::move(feature));
+            };
+            handler.onReadDone = [streamWriter]()
+            {
+                streamWriter->finish();
+                console().writeLine("[Server] Bidi stream finished");
+            };
+            return handler;
+        });
+}
+
 void clientStream(AsyncClient& client)
 {
     auto call = client.call(&Application::Stub::AsyncSetFeatures);
@@ -59,11 +126,68 @@ void clientStream(AsyncClient& client)
     console().writeLine("[Client] Response received: %d", response.count());
 }
 
+void serverStream(AsyncClient& client)
+{
+    GetFeaturesRequest request;
+    request.set_count(100);
+    auto call = client.call(&Application::Stub::AsyncGetFeatures, request);
+    auto stream = call->streamReader().get();
+
+    console().writeLine("[Client] Start read server stream...");
+    int count = 0;
+    while (stream->moveNext().get())
+    {
+        const auto& feature = stream->current();
+        console().writeLine("[Client] Feature received: %s=%s", feature.name().c_str(), feature.value().c_str());
+        count++;
+    }
+
+    auto status = call->finished().get();
+    console().writeLine("[Client] Server stream finished: %d features read, status %d", count, status.error_code());
+}
+
+void bidiStream(AsyncClient& client)
+{
+    auto call = client.call(&Application::Stub::AsyncExchangeFeatures);
+    auto writer = call->streamWriter().get();
+    auto reader = call->streamReader().get();
+
+    // Read on another thread while writing.
+    auto readTask = std::async(std::launch::async,
+        [reader]()
+        {
+            int count = 0;
+            while (reader->moveNext().get())
+            {
+                const auto& feature = reader->current();
+                console().writeLine(
+                    "[Client] Feature exchanged: %s=%s", feature.name().c_str(), feature.value().c_str());
+                count++;
+            }
+            return count;
+        });
+
+    for (int i = 0; i < 100; ++i)
+    {
+        Feature feature;
+        feature.set_name(std::to_string(i));
+        feature.set_value("value" + std::to_string(i));
+        writer->write(std::move(feature));
+    }
+    writer->finish();
+
+    int count = readTask.get();
+    auto status = call->finished().get();
+    console().writeLine("[Client] Bidi stream finished: %d features exchanged, status %d", count, status.error_code());
+}
+
 int main(int argc, char* argv[])
 {
     constexpr uint16_t Port = 55212;
     AsyncServer server(Port);
     registerClientStreamHandler(server);
+    registerServerStreamHandler(server);
+    registerBidiStreamHandler(server);
     server.start();
 
     // Wait for the server start.
@@ -72,6 +196,8 @@ int main(int argc, char* argv[])
     // Build client.
     AsyncClient client("localhost:" + std::to_string(Port));
     clientStream(client);
+    serverStream(client);
+    bidiStream(client);
 
     // Wait for all calls done.
     waitFor(100);
@@ -0,0 +1,109 @@
+#include "EasyGRPC/EchoTest.h"
+
+#include "ShuHai/gRPC/Server/Awaitables.h"
+#include "ShuHai/gRPC/Client/Awaitables.h"
+
+#ifndef SHUHAI_GRPC_HAS_COROUTINES
+#error Coroutines are required by the tests of task handlers.
+#endif
+
+namespace ShuHai::gRPC::Server::Test
+{
+    using namespace ShuHai::gRPC::Test;
+
+    class TaskHandlerTest : public EchoTest
+    {
+    public:
+        using StreamWriter = AsyncServerStreamWriter<decltype(&EchoService::AsyncService::RequestCount)>;
+
+    protected:
+        // Echo replies the sum of 0 to the requested value by calling itself with the value decreased, and fails with
+        // negative values. Count writes the values from 1 to the requested one, and fails with negative values.
+        void registerHandlers(EchoServer& server) override
+        {
+            server.registerCallHandler(&EchoService::AsyncService::RequestEcho,
+                [this](grpc::ServerContext&, const EchoMessage& request) -> Task<EchoMessage>
+                {
+                    if (request.value() < 0)
+                        throw std::runtime_error("Negative value.");
+
+                    EchoMessage response;
+                    response.set_value(request.value());
+                    if (request.value() > 0)
+                    {
+                        EchoMessage next;
+                        next.set_value(request.value() - 1);
+                        auto sum = co_await Client::awaitCall(*_client, &EchoService::Stub::AsyncEcho, next);
+                        response.set_value(response.value() + sum.value());
+                    }
+                    co_return response;
+                });
+
+            server.registerCallHandler(&EchoService::AsyncService::RequestCount,
+                [](grpc::ServerContext&, const EchoMessage& request, std::shared_ptr<StreamWriter> writer) -> Task<>
+                {
+                    if (request.value() < 0)
+                        throw std::runtime_error("Negative count.");
+
+                    for (int i = 1; i <= request.value(); ++i)
+                    {
+                        EchoMessage message;
+                        message.set_value(i);
+                        co_await awaitWrite(*writer, std::move(message));
+                    }
+                });
+        }
+
+        std::pair<std::vector<int>, grpc::Status> count(int value)
+        {
+            EchoMessage request;
+            request.set_value(value);
+            auto call = _client->call(&EchoService::Stub::AsyncCount, request);
+            auto reader = call->streamReader().get();
+
+            std::vector<int> values;
+            while (reader->moveNext().get())
+                values.push_back(reader->current().value());
+            return { values, call->finished().get() };
+        }
+    };
+
+    TEST_F(TaskHandlerTest, TaskShouldRespondWithReturnedResponse)
+    {
+        EXPECT_EQ(call(0).get().value(), 0);
+    }
+
+    TEST_F(TaskHandlerTest, TaskShouldRespondAfterAwaitedCalls)
+    {
+        EXPECT_EQ(call(4).get().value(), 10);
+    }
+
+    TEST_F(TaskHandlerTest, ThrowingTaskShouldFailCall)
+    {
+        auto response = call(-1);
+        EXPECT_EQ(errorCode(response), grpc::StatusCode::UNKNOWN);
+        try
+        {
+            response.get();
+        }
+        catch (const Client::AsyncCallError& e)
+        {
+            EXPECT_EQ(e.status().error_message(), "Negative value.");
+        }
+    }
+
+    TEST_F(TaskHandlerTest, StreamTaskShouldFinishStreamOnCompletion)
+    {
+        auto [values, status] = count(3);
+        EXPECT_EQ(values, (std::vector<int> { 1, 2, 3 }));
+        EXPECT_TRUE(status.ok());
+    }
+
+    TEST_F(TaskHandlerTest, ThrowingStreamTaskShouldFinishStreamWithError)
+    {
+        auto [values, status] = count(-1);
+        EXPECT_TRUE(values.empty());
+        EXPECT_EQ(status.error_code(), grpc::StatusCode::UNKNOWN);
+        EXPECT_EQ(status.error_message(), "Negative count.");
+    }
+}
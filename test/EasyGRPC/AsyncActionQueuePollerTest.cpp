@@ -0,0 +1,235 @@
+#include "ShuHai/gRPC/AsyncActionQueuePoller.h"
+
+#include <grpcpp/alarm.h>
+
+#include <gtest/gtest.h>
+
+#include <future>
+#include <functional>
+#include <stdexcept>
+
+namespace ShuHai::gRPC::Test
+{
+    using namespace std::chrono_literals;
+
+    class AsyncActionQueuePollerTest : public testing::Test
+    {
+    public:
+        // Action finalized by a polling thread as soon as it is posted.
+        class PostedAction : public IAsyncAction
+        {
+        public:
+            explicit PostedAction(std::function<void()> func)
+                : _func(std::move(func))
+            { }
+
+            bool perform(AsyncActionQueue& queue)
+            {
+                return queue.tryStartOperation(
+                    [&]() { _alarm.Set(queue.completionQueue(), gpr_now(GPR_CLOCK_MONOTONIC), this); });
+            }
+
+            void finalizeResult(bool) override { _func(); }
+
+        private:
+            std::function<void()> _func;
+            grpc::Alarm _alarm;
+        };
+
+        static void post(AsyncActionQueue& queue, std::function<void()> func)
+        {
+            auto action = new PostedAction(std::move(func));
+            if (!action->perform(queue))
+                delete action;
+        }
+
+        // Invoke the specified function on a thread polling the specified queue and wait for its result.
+        template<typename Func>
+        static auto invokeOnPoller(AsyncActionQueue& queue, Func func)
+        {
+            auto promise = std::make_shared<std::promise<std::invoke_result_t<Func&>>>();
+            auto future = promise->get_future();
+            post(queue, [promise, func]() mutable { promise->set_value(func()); });
+            return future.get();
+        }
+
+        static std::vector<size_t> currentThreadCpus()
+        {
+            std::vector<size_t> cpus;
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+                return cpus;
+            for (size_t cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (CPU_ISSET(cpu, &set))
+                    cpus.push_back(cpu);
+            }
+#endif
+            return cpus;
+        }
+
+#ifdef __linux__
+        static clockid_t currentThreadCpuClock()
+        {
+            clockid_t clock {};
+            pthread_getcpuclockid(pthread_self(), &clock);
+            return clock;
+        }
+
+        // CPU time consumed by the thread of the specified clock while the calling thread sleeps for the specified
+        // duration.
+        static std::chrono::nanoseconds cpuTimeDuring(clockid_t clock, std::chrono::nanoseconds duration)
+        {
+            auto now = [clock]()
+            {
+                timespec t {};
+                clock_gettime(clock, &t);
+                return std::chrono::seconds(t.tv_sec) + std::chrono::nanoseconds(t.tv_nsec);
+            };
+
+            auto start = now();
+            std::this_thread::sleep_for(duration);
+            return now() - start;
+        }
+#endif
+
+        static bool waitUntil(const std::function<bool()>& condition)
+        {
+            auto deadline = std::chrono::steady_clock::now() + 10s;
+            while (!condition())
+            {
+                if (std::chrono::steady_clock::now() >= deadline)
+                    return false;
+                std::this_thread::sleep_for(1ms);
+            }
+            return true;
+        }
+
+        static std::unique_ptr<AsyncActionQueue> makeQueue()
+        {
+            return std::make_unique<AsyncActionQueue>(std::make_unique<grpc::CompletionQueue>());
+        }
+    };
+
+#ifdef __linux__
+    TEST_F(AsyncActionQueuePollerTest, ThreadsShouldBePinnedToCpuSetOfTheirQueue)
+    {
+        auto cpu = currentThreadCpus().front();
+        PollerOptions options;
+        options.threadCount = 2;
+        options.cpuSets = { { cpu }, {} };
+
+        auto pinnedQueue = makeQueue();
+        auto unpinnedQueue = makeQueue();
+        AsyncActionQueuePoller pinnedPoller(*pinnedQueue, options, 0);
+        AsyncActionQueuePoller unpinnedPoller(*unpinnedQueue, options, 1);
+
+        EXPECT_EQ(invokeOnPoller(*pinnedQueue, &currentThreadCpus), std::vector<size_t> { cpu });
+        EXPECT_EQ(invokeOnPoller(*unpinnedQueue, &currentThreadCpus), currentThreadCpus());
+
+        pinnedQueue->shutdown();
+        unpinnedQueue->shutdown();
+        pinnedPoller.join();
+        unpinnedPoller.join();
+    }
+
+    TEST_F(AsyncActionQueuePollerTest, InvokeOnCpusShouldRunOnThoseCpus)
+    {
+        auto cpu = currentThreadCpus().front();
+        EXPECT_EQ(invokeOnCpus({ cpu }, &currentThreadCpus), std::vector<size_t> { cpu });
+
+        auto id = invokeOnCpus({ cpu }, []() { return std::this_thread::get_id(); });
+        EXPECT_NE(id, std::this_thread::get_id());
+        EXPECT_EQ(invokeOnCpus({}, []() { return std::this_thread::get_id(); }), std::this_thread::get_id());
+
+        EXPECT_THROW(invokeOnCpus({ cpu }, []() { throw std::runtime_error("Failed."); }), std::runtime_error);
+    }
+
+    TEST_F(AsyncActionQueuePollerTest, ThreadsShouldSpinAfterEventsBeforeBlocking)
+    {
+        PollerOptions options;
+        options.spinDurations = { 1s };
+        auto queue = makeQueue();
+        AsyncActionQueuePoller poller(*queue, options);
+
+        // The spin starts over once the event is handled, the thread blocks once it ends. The bounds only tell a
+        // spinning thread from a blocked one, since a loaded host may run the spinning thread for a fraction of the
+        // window.
+        auto window = options.spinDurations[0] / 4;
+        auto clock = invokeOnPoller(*queue, &currentThreadCpuClock);
+        EXPECT_GT(cpuTimeDuring(clock, window), window / 10);
+        std::this_thread::sleep_for(options.spinDurations[0]);
+        EXPECT_LT(cpuTimeDuring(clock, window), window / 2);
+
+        queue->shutdown();
+        poller.join();
+    }
+
+    TEST_F(AsyncActionQueuePollerTest, ThreadsWithoutSpinDurationShouldBlock)
+    {
+        PollerOptions options;
+        options.spinDurations = { 1s, 0ms };
+        auto queue = makeQueue();
+        AsyncActionQueuePoller poller(*queue, options, 1);
+
+        // Threads of the first queue would spin throughout the window.
+        auto window = options.spinDurations[0] / 4;
+        auto clock = invokeOnPoller(*queue, &currentThreadCpuClock);
+        EXPECT_LT(cpuTimeDuring(clock, window), window / 2);
+
+        queue->shutdown();
+        poller.join();
+    }
+
+    TEST_F(AsyncActionQueuePollerTest, UnavailableCpusShouldNotBeApplied)
+    {
+        auto cpus = currentThreadCpus();
+        EXPECT_FALSE(setCurrentThreadAffinity({}));
+        EXPECT_FALSE(setCurrentThreadAffinity({ CPU_SETSIZE }));
+        EXPECT_EQ(currentThreadCpus(), cpus);
+    }
+#endif
+
+    TEST_F(AsyncActionQueuePollerTest, ThreadsShouldGrowUnderLoadAndStopOnShutdown)
+    {
+        PollerOptions options;
+        options.maxThreadCount = 4;
+        options.growBusyRatio = 0.5;
+        options.growInterval = 5ms;
+        options.idleTimeout = 50ms;
+        auto queue = makeQueue();
+        AsyncActionQueuePoller poller(*queue, options);
+        EXPECT_EQ(poller.threadCount(), 1u);
+
+        auto sleep = []() { std::this_thread::sleep_for(2ms); };
+        for (int i = 0; i < 200; ++i)
+            post(*queue, sleep);
+        EXPECT_TRUE(waitUntil([&]() { return poller.threadCount() > 1; }));
+        EXPECT_LE(poller.threadCount(), 4u);
+
+        // Threads beyond threadCount retire once idle.
+        EXPECT_TRUE(waitUntil([&]() { return poller.threadCount() == 1; }));
+
+        for (int i = 0; i < 200; ++i)
+            post(*queue, sleep);
+        EXPECT_TRUE(waitUntil([&]() { return poller.threadCount() > 1; }));
+
+        // Pending events are drained by the threads, none is started after they exit.
+        queue->shutdown();
+        EXPECT_TRUE(waitUntil([&]() { return poller.threadCount() == 0; }));
+        std::this_thread::sleep_for(10 * options.growInterval);
+        EXPECT_EQ(poller.threadCount(), 0u);
+        poller.join();
+        EXPECT_EQ(poller.threadCount(), 0u);
+    }
+
+    TEST_F(AsyncActionQueuePollerTest, NegativeSpinDurationShouldThrow)
+    {
+        PollerOptions options;
+        options.spinDurations = { -1ms };
+        auto queue = makeQueue();
+        EXPECT_THROW(AsyncActionQueuePoller(*queue, options), std::invalid_argument);
+    }
+}
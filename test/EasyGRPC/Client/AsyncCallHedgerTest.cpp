@@ -0,0 +1,127 @@
+#include "ShuHai/gRPC/Client/AsyncCallHedger.h"
+
+#include <gtest/gtest.h>
+
+namespace ShuHai::gRPC::Client::Test
+{
+    using namespace std::chrono_literals;
+
+    class AsyncCallHedgerTest : public testing::Test
+    {
+    public:
+        static AsyncCallHedger::Options options()
+        {
+            AsyncCallHedger::Options options;
+            options.sampleWindow = 100;
+            return options;
+        }
+
+        static void addSamples(AsyncCallHedger& hedger, std::chrono::nanoseconds first, std::chrono::nanoseconds step)
+        {
+            for (size_t i = 0; i < hedger.options().sampleWindow; ++i)
+                hedger.addSample(first + step * static_cast<int64_t>(i));
+        }
+    };
+
+    TEST_F(AsyncCallHedgerTest, InvalidOptionsShouldThrow)
+    {
+        auto o = options();
+        o.delay = -1ms;
+        EXPECT_THROW(AsyncCallHedger { o }, std::invalid_argument);
+
+        o = options();
+        o.delayPercentile = 1;
+        EXPECT_THROW(AsyncCallHedger { o }, std::invalid_argument);
+
+        o = options();
+        o.sampleWindow = 0;
+        EXPECT_THROW(AsyncCallHedger { o }, std::invalid_argument);
+
+        o = options();
+        o.maxAttempts = 0;
+        EXPECT_THROW(AsyncCallHedger { o }, std::invalid_argument);
+
+        o = options();
+        o.budgetRatio = -0.1;
+        EXPECT_THROW(AsyncCallHedger { o }, std::invalid_argument);
+    }
+
+    TEST_F(AsyncCallHedgerTest, FixedDelayShouldIgnoreSamples)
+    {
+        auto o = options();
+        o.delay = 20ms;
+        AsyncCallHedger hedger(o);
+        EXPECT_EQ(hedger.delay(), 20ms);
+
+        addSamples(hedger, 1ms, 1ms);
+        EXPECT_EQ(hedger.delay(), 20ms);
+    }
+
+    TEST_F(AsyncCallHedgerTest, PercentileDelayShouldWaitForFullWindow)
+    {
+        AsyncCallHedger hedger(options());
+        for (int i = 0; i < 99; ++i)
+            hedger.addSample(10ms);
+        EXPECT_FALSE(hedger.delay());
+
+        hedger.addSample(10ms);
+        EXPECT_EQ(hedger.delay(), 10ms);
+    }
+
+    TEST_F(AsyncCallHedgerTest, PercentileDelayShouldFollowSamples)
+    {
+        AsyncCallHedger hedger(options());
+
+        // The 95th percentile of 1ms, 2ms, ..., 100ms.
+        addSamples(hedger, 1ms, 1ms);
+        EXPECT_EQ(hedger.delay(), 95ms);
+
+        addSamples(hedger, 200ms, 0ms);
+        EXPECT_EQ(hedger.delay(), 200ms);
+    }
+
+    TEST_F(AsyncCallHedgerTest, PercentileDelayShouldNotGoBelowMinimum)
+    {
+        auto o = options();
+        o.minDelay = 5ms;
+        AsyncCallHedger hedger(o);
+        addSamples(hedger, 1us, 0us);
+        EXPECT_EQ(hedger.delay(), 5ms);
+    }
+
+    TEST_F(AsyncCallHedgerTest, BudgetShouldRunOut)
+    {
+        auto o = options();
+        o.maxBudget = 2;
+        AsyncCallHedger hedger(o);
+        EXPECT_TRUE(hedger.tryAcquireHedge());
+        EXPECT_TRUE(hedger.tryAcquireHedge());
+        EXPECT_FALSE(hedger.tryAcquireHedge());
+        EXPECT_EQ(hedger.hedgeCount(), 2u);
+        EXPECT_EQ(hedger.budgetExhaustedCount(), 1u);
+    }
+
+    TEST_F(AsyncCallHedgerTest, CallsShouldRefillBudget)
+    {
+        auto o = options();
+        o.budgetRatio = 0.25;
+        o.maxBudget = 2;
+        AsyncCallHedger hedger(o);
+        while (hedger.tryAcquireHedge())
+            continue;
+
+        for (int i = 0; i < 3; ++i)
+            hedger.addCall();
+        EXPECT_FALSE(hedger.tryAcquireHedge());
+        hedger.addCall();
+        EXPECT_TRUE(hedger.tryAcquireHedge());
+        EXPECT_EQ(hedger.callCount(), 4u);
+
+        // The budget is capped.
+        for (int i = 0; i < 100; ++i)
+            hedger.addCall();
+        EXPECT_TRUE(hedger.tryAcquireHedge());
+        EXPECT_TRUE(hedger.tryAcquireHedge());
+        EXPECT_FALSE(hedger.tryAcquireHedge());
+    }
+}
@@ -0,0 +1,112 @@
+#include "EasyGRPC/EchoTest.h"
+
+namespace ShuHai::gRPC::Client::Test
+{
+    using namespace ShuHai::gRPC::Test;
+    using namespace std::chrono_literals;
+
+    class AsyncCallLimitTest : public EchoTest
+    {
+    protected:
+        AsyncClientOptions clientOptions() const override
+        {
+            AsyncClientOptions options;
+            options.concurrencyLimit.emplace();
+            options.concurrencyLimit->initialLimit = 1;
+            options.concurrencyLimit->maxLimit = 1;
+            options.concurrencyLimit->maxQueueSize = 1;
+            return options;
+        }
+    };
+
+    TEST_F(AsyncCallLimitTest, QueuedCallShouldExpireAtItsDeadline)
+    {
+        auto running = _client->call(&EchoService::Stub::AsyncEcho, EchoMessage())->response();
+        auto responder = takeCall().responder;
+
+        auto context = std::make_unique<grpc::ClientContext>();
+        context->set_deadline(std::chrono::system_clock::now() + 50ms);
+        auto queued = _client->call(&EchoService::Stub::AsyncEcho, EchoMessage(), std::move(context))->response();
+        EXPECT_EQ(_client->callLimiter()->queuedCount(), 1u);
+
+        // The call ahead of the queued one is still running when the queued one expires.
+        EXPECT_EQ(queued.wait_for(10s), std::future_status::ready);
+        EXPECT_EQ(errorCode(queued), grpc::StatusCode::DEADLINE_EXCEEDED);
+        EXPECT_EQ(_client->callLimiter()->queuedCount(), 0u);
+        EXPECT_EQ(running.wait_for(0s), std::future_status::timeout);
+
+        responder.response().set_value(1);
+        responder.respond();
+        EXPECT_EQ(running.get().value(), 1);
+    }
+
+    TEST_F(AsyncCallLimitTest, RejectedCallShouldNotRunCallbackOnCallingThread)
+    {
+        auto running = _client->call(&EchoService::Stub::AsyncEcho, EchoMessage())->response();
+        auto responder = takeCall().responder;
+        auto queued = _client->call(&EchoService::Stub::AsyncEcho, EchoMessage())->response();
+
+        std::promise<std::thread::id> callbackThread;
+        auto rejected = _client
+                            ->call(&EchoService::Stub::AsyncEcho, EchoMessage(),
+                                [&](const std::shared_future<EchoMessage>&)
+                                { callbackThread.set_value(std::this_thread::get_id()); })
+                            ->response();
+        EXPECT_NE(callbackThread.get_future().get(), std::this_thread::get_id());
+        EXPECT_EQ(errorCode(rejected), grpc::StatusCode::RESOURCE_EXHAUSTED);
+        EXPECT_EQ(_client->callLimiter()->rejectedCount(), 1u);
+
+        responder.respond();
+        EXPECT_EQ(errorCode(running), grpc::StatusCode::OK);
+        takeCall().responder.respond();
+        EXPECT_EQ(errorCode(queued), grpc::StatusCode::OK);
+    }
+
+    TEST_F(AsyncCallLimitTest, DestroyingClientShouldCancelQueuedCalls)
+    {
+        // The client waits for the calls in flight once it is destroyed, the deadline ends the running one.
+        auto context = std::make_unique<grpc::ClientContext>();
+        context->set_deadline(std::chrono::system_clock::now() + 200ms);
+        auto running = _client->call(&EchoService::Stub::AsyncEcho, EchoMessage(), std::move(context))->response();
+        auto responder = takeCall().responder;
+        auto queued = _client->call(&EchoService::Stub::AsyncEcho, EchoMessage())->response();
+
+        _client = nullptr;
+        EXPECT_EQ(errorCode(queued), grpc::StatusCode::CANCELLED);
+        EXPECT_EQ(errorCode(running), grpc::StatusCode::DEADLINE_EXCEEDED);
+    }
+
+    TEST_F(AsyncCallLimitTest, QueuedCallShouldBeChargedToChannelOnceStarted)
+    {
+        auto running = _client->call(&EchoService::Stub::AsyncEcho, EchoMessage())->response();
+        auto responder = takeCall().responder;
+        auto queued = _client->call(&EchoService::Stub::AsyncEcho, EchoMessage())->response();
+        EXPECT_EQ(_client->callLimiter()->queuedCount(), 1u);
+        EXPECT_EQ(_client->outstandingCallCount(0), 1u);
+
+        responder.respond();
+        EXPECT_EQ(errorCode(running), grpc::StatusCode::OK);
+        auto queuedResponder = takeCall().responder;
+        EXPECT_TRUE(waitUntil([&]() { return _client->outstandingCallCount(0) == 1; }));
+
+        queuedResponder.respond();
+        EXPECT_EQ(errorCode(queued), grpc::StatusCode::OK);
+        EXPECT_TRUE(waitUntil([&]() { return _client->outstandingCallCount(0) == 0; }));
+    }
+
+    TEST_F(AsyncCallLimitTest, RejectedCallShouldNotBeChargedToChannel)
+    {
+        auto running = _client->call(&EchoService::Stub::AsyncEcho, EchoMessage())->response();
+        auto responder = takeCall().responder;
+        auto queued = _client->call(&EchoService::Stub::AsyncEcho, EchoMessage())->response();
+        auto rejected = _client->call(&EchoService::Stub::AsyncEcho, EchoMessage())->response();
+        EXPECT_EQ(errorCode(rejected), grpc::StatusCode::RESOURCE_EXHAUSTED);
+        EXPECT_EQ(_client->outstandingCallCount(0), 1u);
+
+        responder.respond();
+        takeCall().responder.respond();
+        EXPECT_EQ(errorCode(running), grpc::StatusCode::OK);
+        EXPECT_EQ(errorCode(queued), grpc::StatusCode::OK);
+        EXPECT_TRUE(waitUntil([&]() { return _client->outstandingCallCount(0) == 0; }));
+    }
+}
@@ -0,0 +1,194 @@
+#include "ShuHai/gRPC/Client/AsyncCallLimiter.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace ShuHai::gRPC::Client::Test
+{
+    using namespace std::chrono_literals;
+
+    class AsyncCallLimiterTest : public testing::Test
+    {
+    public:
+        using Clock = AsyncCallLimiter::Clock;
+
+        static AsyncCallLimiter::Options options(size_t initialLimit)
+        {
+            AsyncCallLimiter::Options options;
+            options.initialLimit = initialLimit;
+            options.maxQueueSize = 2;
+            return options;
+        }
+
+        std::optional<AsyncCallLimiter::Ticket> acquire(AsyncCallLimiter& limiter, int id)
+        {
+            return limiter.acquire(
+                [this, id]()
+                {
+                    started.push_back(id);
+                    return true;
+                },
+                [this, id](const grpc::Status& status) { rejected.emplace_back(id, status.error_code()); });
+        }
+
+        // Keep the limiter full while each call takes the specified latency.
+        static void passCalls(AsyncCallLimiter& limiter, size_t count, Clock::duration latency)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                while (limiter.inFlightCount() < limiter.limit())
+                    limiter.acquire([]() { return true; }, [](const grpc::Status&) { });
+                limiter.release(Clock::now() - latency, grpc::Status::OK);
+            }
+        }
+
+        std::vector<int> started;
+        std::vector<std::pair<int, grpc::StatusCode>> rejected;
+    };
+
+    TEST_F(AsyncCallLimiterTest, InvalidOptionsShouldThrow)
+    {
+        auto o = options(1);
+        o.minLimit = 0;
+        EXPECT_THROW(AsyncCallLimiter { o }, std::invalid_argument);
+
+        o = options(1);
+        o.initialLimit = o.maxLimit + 1;
+        EXPECT_THROW(AsyncCallLimiter { o }, std::invalid_argument);
+
+        o = options(1);
+        o.latencyTolerance = 1;
+        EXPECT_THROW(AsyncCallLimiter { o }, std::invalid_argument);
+
+        o = options(1);
+        o.backoffRatio = 1;
+        EXPECT_THROW(AsyncCallLimiter { o }, std::invalid_argument);
+    }
+
+    TEST_F(AsyncCallLimiterTest, CallsBeyondLimitShouldWaitInQueue)
+    {
+        AsyncCallLimiter limiter(options(2));
+        EXPECT_FALSE(acquire(limiter, 0));
+        EXPECT_FALSE(acquire(limiter, 1));
+        EXPECT_TRUE(acquire(limiter, 2));
+        EXPECT_EQ(started, (std::vector<int> { 0, 1 }));
+        EXPECT_EQ(limiter.inFlightCount(), 2u);
+        EXPECT_EQ(limiter.queuedCount(), 1u);
+
+        limiter.release(Clock::now(), grpc::Status::OK);
+        EXPECT_EQ(started, (std::vector<int> { 0, 1, 2 }));
+        EXPECT_EQ(limiter.inFlightCount(), 2u);
+        EXPECT_EQ(limiter.queuedCount(), 0u);
+    }
+
+    TEST_F(AsyncCallLimiterTest, FullQueueShouldRejectCalls)
+    {
+        AsyncCallLimiter limiter(options(1));
+        acquire(limiter, 0);
+        acquire(limiter, 1);
+        acquire(limiter, 2);
+        EXPECT_FALSE(acquire(limiter, 3));
+        EXPECT_EQ(limiter.queuedCount(), 2u);
+        EXPECT_EQ(limiter.rejectedCount(), 1u);
+        ASSERT_EQ(rejected.size(), 1u);
+        EXPECT_EQ(rejected[0], std::make_pair(3, grpc::StatusCode::RESOURCE_EXHAUSTED));
+    }
+
+    TEST_F(AsyncCallLimiterTest, CloseShouldRejectQueuedCalls)
+    {
+        AsyncCallLimiter limiter(options(1));
+        acquire(limiter, 0);
+        acquire(limiter, 1);
+        limiter.close();
+        acquire(limiter, 2);
+        EXPECT_EQ(limiter.queuedCount(), 0u);
+        EXPECT_EQ(rejected, (std::vector<std::pair<int, grpc::StatusCode>> {
+            { 1, grpc::StatusCode::CANCELLED }, { 2, grpc::StatusCode::CANCELLED } }));
+
+        // The started call is still released.
+        limiter.release(Clock::now(), grpc::Status::OK);
+        EXPECT_EQ(limiter.inFlightCount(), 0u);
+        EXPECT_EQ(started, std::vector<int> { 0 });
+    }
+
+    TEST_F(AsyncCallLimiterTest, ExpireShouldRejectQueuedCallOnly)
+    {
+        AsyncCallLimiter limiter(options(1));
+        acquire(limiter, 0);
+        auto first = acquire(limiter, 1);
+        auto second = acquire(limiter, 2);
+        ASSERT_TRUE(first && second);
+
+        EXPECT_TRUE(limiter.expire(*second));
+        EXPECT_FALSE(limiter.expire(*second));
+        EXPECT_EQ(rejected, (std::vector<std::pair<int, grpc::StatusCode>> {
+            { 2, grpc::StatusCode::DEADLINE_EXCEEDED } }));
+
+        // The call started ahead of its deadline is not expired.
+        limiter.release(Clock::now(), grpc::Status::OK);
+        EXPECT_FALSE(limiter.expire(*first));
+        EXPECT_EQ(started, (std::vector<int> { 0, 1 }));
+        EXPECT_EQ(rejected.size(), 1u);
+    }
+
+    TEST_F(AsyncCallLimiterTest, LimitShouldGrowWhileLatencyHolds)
+    {
+        auto o = options(2);
+        o.maxLimit = 5;
+        AsyncCallLimiter limiter(o);
+
+        // The limit grows by about one per round trip of calls, up to the maximum.
+        passCalls(limiter, 3, 10ms);
+        EXPECT_EQ(limiter.limit(), 3u);
+        passCalls(limiter, 100, 10ms);
+        EXPECT_EQ(limiter.limit(), 5u);
+    }
+
+    TEST_F(AsyncCallLimiterTest, IdleLimitShouldNotGrow)
+    {
+        AsyncCallLimiter limiter(options(4));
+        for (int i = 0; i < 100; ++i)
+        {
+            acquire(limiter, i);
+            limiter.release(Clock::now() - 10ms, grpc::Status::OK);
+        }
+        EXPECT_EQ(limiter.limit(), 4u);
+    }
+
+    TEST_F(AsyncCallLimiterTest, DroppedCallShouldBackOff)
+    {
+        AsyncCallLimiter limiter(options(20));
+        for (int i = 0; i < 3; ++i)
+            acquire(limiter, i);
+
+        auto startTime = Clock::now();
+        limiter.release(startTime, grpc::Status(grpc::StatusCode::UNAVAILABLE, ""));
+        EXPECT_EQ(limiter.limit(), 18u);
+
+        // Calls started before the backoff saw the previous limit.
+        limiter.release(startTime, grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, ""));
+        EXPECT_EQ(limiter.limit(), 18u);
+
+        // Errors of the calls themselves tell nothing about the servers.
+        acquire(limiter, 3);
+        limiter.release(Clock::now(), grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, ""));
+        EXPECT_EQ(limiter.limit(), 18u);
+
+        limiter.release(Clock::now(), grpc::Status(grpc::StatusCode::DEADLINE_EXCEEDED, ""));
+        EXPECT_EQ(limiter.limit(), 16u);
+    }
+
+    TEST_F(AsyncCallLimiterTest, GrowingLatencyShouldBackOff)
+    {
+        auto o = options(20);
+        o.minLimit = 10;
+        AsyncCallLimiter limiter(o);
+        passCalls(limiter, 10, 10ms);
+        auto limit = limiter.limit();
+
+        passCalls(limiter, 100, 100ms);
+        EXPECT_LT(limiter.limit(), limit);
+        EXPECT_GE(limiter.limit(), 10u);
+    }
+}
@@ -0,0 +1,265 @@
+#include "EasyGRPC/EchoTest.h"
+
+#include <set>
+#include <string>
+#include <atomic>
+
+namespace ShuHai::gRPC::Client::Test
+{
+    using namespace ShuHai::gRPC::Test;
+    using namespace std::chrono_literals;
+
+    class AsyncClientChannelTest : public EchoTest
+    {
+    public:
+        std::unique_ptr<EchoClient> makeClient(const std::vector<std::string>& endpoints, size_t channelCount,
+            ChannelSelection channelSelection = ChannelSelection::RoundRobin)
+        {
+            AsyncClientOptions options;
+            options.channelCount = channelCount;
+            options.channelSelection = channelSelection;
+            return std::make_unique<EchoClient>(
+                endpoints, grpc::InsecureChannelCredentials(), grpc::ChannelArguments(), options);
+        }
+
+        static std::shared_future<EchoMessage> call(EchoClient& client, int value)
+        {
+            EchoMessage request;
+            request.set_value(value);
+            return client.call(&EchoService::Stub::AsyncEcho, request)->response();
+        }
+
+        static std::vector<size_t> outstandingCallCounts(const EchoClient& client)
+        {
+            std::vector<size_t> counts;
+            for (size_t i = 0; i < client.channelCount(); ++i)
+                counts.push_back(client.outstandingCallCount(i));
+            return counts;
+        }
+
+        // Server that responds to each echo call after the specified delay and counts the calls, except the ones of
+        // negative values which make background load.
+        static std::unique_ptr<EchoServer> startServer(std::chrono::milliseconds delay, std::atomic_int& callCount,
+            const Server::AsyncServerOptions& options = {})
+        {
+            auto server = makeServer(options);
+            server->registerCallHandler(&EchoService::AsyncService::RequestEcho,
+                [delay, &callCount](grpc::ServerContext&, const EchoMessage& request)
+                {
+                    if (request.value() >= 0)
+                        ++callCount;
+                    std::this_thread::sleep_for(delay);
+                    return request;
+                });
+            server->start();
+            return server;
+        }
+
+        std::set<std::string> peers()
+        {
+            std::lock_guard l(_mutex);
+            return _peers;
+        }
+
+    protected:
+        // Same as the default handler, except that the peer of each call is recorded.
+        void registerHandlers(EchoServer& server) override
+        {
+            server.registerCallHandler(&EchoService::AsyncService::RequestEcho,
+                [this](grpc::ServerContext& context, const EchoMessage& request, EchoResponder responder)
+                {
+                    std::lock_guard l(_mutex);
+                    _peers.insert(context.peer());
+                    _calls.push_back({ request.value(), std::move(responder), Server::cancellationToken(context) });
+                    _callsChanged.notify_all();
+                });
+        }
+
+        std::set<std::string> _peers;
+    };
+
+    TEST_F(AsyncClientChannelTest, EachChannelShouldHaveItsOwnConnection)
+    {
+        auto client = makeClient({ address(*_server) }, 3);
+        EXPECT_EQ(client->channelCount(), 3u);
+        for (int i = 0; i < 3; ++i)
+        {
+            auto response = call(*client, i);
+            takeCall().responder.respond();
+            response.get();
+        }
+        EXPECT_EQ(peers().size(), 3u);
+    }
+
+    TEST_F(AsyncClientChannelTest, CallsShouldBeSpreadAcrossChannels)
+    {
+        auto client = makeClient({ address(*_server) }, 3);
+        std::vector<std::shared_future<EchoMessage>> responses;
+        std::vector<EchoResponder> responders;
+        for (int i = 0; i < 6; ++i)
+        {
+            responses.push_back(call(*client, i));
+            responders.push_back(takeCall().responder);
+        }
+        EXPECT_EQ(outstandingCallCounts(*client), (std::vector<size_t> { 2, 2, 2 }));
+
+        for (auto& responder : responders)
+            responder.respond();
+        for (auto& response : responses)
+            response.get();
+        EXPECT_TRUE(waitUntil([&]() { return outstandingCallCounts(*client) == std::vector<size_t> { 0, 0, 0 }; }));
+    }
+
+    TEST_F(AsyncClientChannelTest, LeastOutstandingShouldPickChannelOfFewestCalls)
+    {
+        auto client = makeClient({ address(*_server) }, 2, ChannelSelection::LeastOutstanding);
+        auto first = call(*client, 1);
+        auto firstResponder = takeCall().responder;
+        auto second = call(*client, 2);
+        takeCall().responder.respond();
+        second.get();
+        EXPECT_TRUE(waitUntil([&]() { return outstandingCallCounts(*client) == std::vector<size_t> { 1, 0 }; }));
+
+        // Round robin would pick the busy channel again.
+        auto third = call(*client, 3);
+        auto thirdResponder = takeCall().responder;
+        EXPECT_EQ(outstandingCallCounts(*client), (std::vector<size_t> { 1, 1 }));
+
+        firstResponder.respond();
+        thirdResponder.respond();
+        first.get();
+        third.get();
+    }
+
+    TEST_F(AsyncClientChannelTest, EachEndpointShouldGetItsOwnChannels)
+    {
+        auto other = makeServer();
+        registerHandlers(*other);
+        other->start();
+
+        auto client = makeClient({ address(*_server), address(*other) }, 2);
+        EXPECT_EQ(client->channelCount(), 4u);
+        EXPECT_EQ(client->channelEndpoint(0), address(*_server));
+        EXPECT_EQ(client->channelEndpoint(1), address(*_server));
+        EXPECT_EQ(client->channelEndpoint(2), address(*other));
+        EXPECT_EQ(client->channelEndpoint(3), address(*other));
+
+        for (int i = 0; i < 4; ++i)
+        {
+            auto response = call(*client, i);
+            takeCall().responder.respond();
+            EXPECT_EQ(errorCode(response), grpc::StatusCode::OK);
+        }
+
+        client = nullptr;
+        other->stop();
+    }
+
+    TEST_F(AsyncClientChannelTest, PowerOfTwoChoicesShouldPreferFasterEndpoint)
+    {
+        std::atomic_int fastCallCount {};
+        std::atomic_int slowCallCount {};
+        auto fast = startServer(0ms, fastCallCount);
+        auto slow = startServer(20ms, slowCallCount);
+
+        // Each endpoint gets probed once its latency is unknown, the faster one takes the calls afterwards.
+        auto client = makeClient({ address(*fast), address(*slow) }, 1, ChannelSelection::PowerOfTwoChoices);
+        for (int i = 0; i < 50; ++i)
+            EXPECT_EQ(call(*client, i).get().value(), i);
+
+        EXPECT_GE(fastCallCount, 45);
+        EXPECT_GE(slowCallCount, 1);
+        EXPECT_LT(client->channelLatency(0), client->channelLatency(1));
+        EXPECT_GE(client->channelLatency(1), 20ms);
+
+        client = nullptr;
+        fast->stop();
+        slow->stop();
+    }
+
+    TEST_F(AsyncClientChannelTest, ServerLoadShouldBeReportedByFinishedCalls)
+    {
+        Server::AsyncServerOptions options;
+        options.reportLoad = true;
+        std::atomic_int callCount {};
+        auto server = startServer(0ms, callCount, options);
+
+        auto client = makeClient({ address(*server) }, 1, ChannelSelection::ServerLoad);
+        EXPECT_FALSE(client->channelServerLoad(0));
+        call(*client, 1).get();
+        EXPECT_TRUE(waitUntil([&]() { return client->channelServerLoad(0).has_value(); }));
+
+        // Channels of servers that report no load are taken as idle.
+        auto silentClient = makeClient({ address(*_server) }, 1, ChannelSelection::ServerLoad);
+        auto response = call(*silentClient, 2);
+        takeCall().responder.respond();
+        response.get();
+        EXPECT_FALSE(silentClient->channelServerLoad(0));
+
+        client = nullptr;
+        silentClient = nullptr;
+        server->stop();
+    }
+
+    TEST_F(AsyncClientChannelTest, ServerLoadShouldPreferIdleEndpoint)
+    {
+        // Handlers run on the only completion queue thread, thus a busy server reports the thread as busy.
+        Server::AsyncServerOptions options;
+        options.inlineHandlers = true;
+        options.reportLoad = true;
+        options.loadRefreshInterval = 10ms;
+        std::atomic_int busyCallCount {};
+        std::atomic_int idleCallCount {};
+        auto busy = startServer(5ms, busyCallCount, options);
+        auto idle = startServer(0ms, idleCallCount, options);
+
+        // Keep the busy server busy from another client.
+        std::atomic_bool loading { true };
+        std::vector<std::thread> loaders;
+        for (int i = 0; i < 2; ++i)
+        {
+            loaders.emplace_back(
+                [&]()
+                {
+                    EchoClient loader(address(*busy));
+                    while (loading)
+                        call(loader, -1).get();
+                });
+        }
+        EXPECT_TRUE(waitUntil([&]() { return busy->load().cpuBusyRatio > 0.5; }));
+
+        auto client = makeClient({ address(*busy), address(*idle) }, 1, ChannelSelection::ServerLoad);
+        for (int i = 0; i < 30; ++i)
+            EXPECT_EQ(call(*client, i).get().value(), i);
+
+        loading = false;
+        for (auto& t : loaders)
+            t.join();
+
+        EXPECT_GE(idleCallCount, 25);
+        EXPECT_LE(busyCallCount, 5);
+        ASSERT_TRUE(client->channelServerLoad(0));
+        EXPECT_GT(client->channelServerLoad(0)->cpuBusyRatio, 0.5);
+
+        client = nullptr;
+        busy->stop();
+        idle->stop();
+    }
+
+    TEST_F(AsyncClientChannelTest, LatencyWeightOutOfRangeShouldThrow)
+    {
+        for (auto weight : { 0.0, -0.5, 1.5 })
+        {
+            AsyncClientOptions options;
+            options.latencyEwmaWeight = weight;
+            auto makeClient = [&]()
+            { EchoClient(address(*_server), grpc::InsecureChannelCredentials(), grpc::ChannelArguments(), options); };
+            EXPECT_THROW(makeClient(), std::invalid_argument);
+        }
+    }
+
+    TEST_F(AsyncClientChannelTest, ZeroChannelCountShouldThrow)
+    {
+        EXPECT_THROW(makeClient({ address(*_server) }, 0), std::invalid_argument);
+    }
+}
@@ -0,0 +1,75 @@
+#include "EasyGRPC/EchoTest.h"
+
+#include <set>
+#include <future>
+#include <optional>
+
+namespace ShuHai::gRPC::Client::Test
+{
+    using namespace ShuHai::gRPC::Test;
+
+    class AsyncClientTest : public EchoTest
+    {
+    public:
+        static EchoMessage echo(grpc::ServerContext&, const EchoMessage& request) { return request; }
+
+        // Response callbacks without an execution context run on the thread polling the completion queue of the call.
+        std::thread::id callbackThread(std::optional<size_t> queueKey = std::nullopt)
+        {
+            auto thread = std::make_shared<std::promise<std::thread::id>>();
+            auto callback = [thread](const std::shared_future<EchoMessage>&)
+            { thread->set_value(std::this_thread::get_id()); };
+
+            if (queueKey)
+                _client->callByKey(*queueKey, &EchoService::Stub::AsyncEcho, EchoMessage(), callback);
+            else
+                _client->call(&EchoService::Stub::AsyncEcho, EchoMessage(), callback);
+            return thread->get_future().get();
+        }
+
+    protected:
+        AsyncClientOptions clientOptions() const override
+        {
+            AsyncClientOptions options;
+            options.completionQueueCount = 2;
+            return options;
+        }
+
+        void registerHandlers(EchoServer& server) override
+        {
+            server.registerCallHandler(&EchoService::AsyncService::RequestEcho, &echo);
+        }
+    };
+
+    TEST_F(AsyncClientTest, EachCompletionQueueShouldBePolledByItsOwnThreads)
+    {
+        EXPECT_EQ(_client->completionQueueCount(), 2u);
+        EXPECT_EQ(_client->pollerThreadCount(), 2u);
+    }
+
+    TEST_F(AsyncClientTest, CallsShouldBeSpreadAcrossCompletionQueues)
+    {
+        std::set<std::thread::id> threads;
+        for (int i = 0; i < 4; ++i)
+            threads.insert(callbackThread());
+        EXPECT_EQ(threads.size(), 2u);
+    }
+
+    TEST_F(AsyncClientTest, CallsOfSameKeyShouldStayOnOneCompletionQueue)
+    {
+        auto thread = callbackThread(0);
+        for (int i = 0; i < 3; ++i)
+            EXPECT_EQ(callbackThread(0), thread);
+        EXPECT_EQ(callbackThread(2), thread);
+        EXPECT_NE(callbackThread(1), thread);
+    }
+
+    TEST_F(AsyncClientTest, ZeroCompletionQueueCountShouldMatchHardwareThreads)
+    {
+        AsyncClientOptions options;
+        options.completionQueueCount = 0;
+        EchoClient client(address(*_server), grpc::InsecureChannelCredentials(), grpc::ChannelArguments(), options);
+        EXPECT_EQ(client.completionQueueCount(), std::max<size_t>(std::thread::hardware_concurrency(), 1));
+        EXPECT_EQ(client.call(&EchoService::Stub::AsyncEcho, EchoMessage())->response().get().value(), 0);
+    }
+}
@@ -0,0 +1,89 @@
+#include "EasyGRPC/EchoTest.h"
+
+namespace ShuHai::gRPC::Client::Test
+{
+    using namespace ShuHai::gRPC::Test;
+    using namespace std::chrono_literals;
+
+    class AsyncHedgedUnaryCallTest : public EchoTest
+    { };
+
+    TEST_F(AsyncHedgedUnaryCallTest, FastAttemptShouldNotBeHedged)
+    {
+        AsyncCallHedger::Options options;
+        options.delay = 10s;
+        auto hedger = std::make_shared<AsyncCallHedger>(options);
+
+        auto call = _client->callHedged(hedger, &EchoService::Stub::AsyncEcho, EchoMessage());
+        auto attempt = takeCall();
+        attempt.responder.response().set_value(1);
+        attempt.responder.respond();
+
+        EXPECT_EQ(call->response().get().value(), 1);
+        EXPECT_EQ(call->attemptCount(), 1u);
+        EXPECT_EQ(hedger->hedgeCount(), 0u);
+    }
+
+    TEST_F(AsyncHedgedUnaryCallTest, LosingAttemptShouldBeCancelled)
+    {
+        AsyncCallHedger::Options options;
+        options.delay = 20ms;
+        auto hedger = std::make_shared<AsyncCallHedger>(options);
+
+        auto call = _client->callHedged(hedger, &EchoService::Stub::AsyncEcho, EchoMessage());
+        auto slow = takeCall();
+        auto hedge = takeCall();
+        hedge.responder.response().set_value(2);
+        hedge.responder.respond();
+
+        EXPECT_EQ(call->response().get().value(), 2);
+        EXPECT_EQ(call->attemptCount(), 2u);
+        EXPECT_EQ(hedger->hedgeCount(), 1u);
+        EXPECT_EQ(hedger->hedgeWinCount(), 1u);
+        EXPECT_TRUE(waitUntil([&]() { return slow.cancellationToken.cancelled(); }));
+        EXPECT_FALSE(hedge.cancellationToken.cancelled());
+    }
+
+    TEST_F(AsyncHedgedUnaryCallTest, ExhaustedBudgetShouldStopHedges)
+    {
+        AsyncCallHedger::Options options;
+        options.delay = 10ms;
+        options.maxBudget = 0;
+        options.budgetRatio = 0;
+        auto hedger = std::make_shared<AsyncCallHedger>(options);
+
+        auto call = _client->callHedged(hedger, &EchoService::Stub::AsyncEcho, EchoMessage());
+        auto attempt = takeCall();
+        EXPECT_TRUE(waitUntil([&]() { return hedger->budgetExhaustedCount() > 0; }));
+        attempt.responder.response().set_value(3);
+        attempt.responder.respond();
+
+        EXPECT_EQ(call->response().get().value(), 3);
+        EXPECT_EQ(call->attemptCount(), 1u);
+        EXPECT_EQ(hedger->hedgeCount(), 0u);
+    }
+
+    TEST_F(AsyncHedgedUnaryCallTest, HedgesShouldNotStartOnceClientIsDestroyed)
+    {
+        AsyncCallHedger::Options options;
+        options.delay = 100ms;
+        auto hedger = std::make_shared<AsyncCallHedger>(options);
+
+        auto call = _client->callHedged(hedger, &EchoService::Stub::AsyncEcho, EchoMessage());
+        auto attempt = takeCall();
+
+        // The client waits for the attempt in flight, the hedge delay passes meanwhile.
+        std::thread completion([&attempt]()
+            {
+                std::this_thread::sleep_for(300ms);
+                attempt.responder.response().set_value(4);
+                attempt.responder.respond();
+            });
+        _client = nullptr;
+        completion.join();
+
+        EXPECT_EQ(call->response().get().value(), 4);
+        EXPECT_EQ(call->attemptCount(), 1u);
+        EXPECT_EQ(hedger->hedgeCount(), 0u);
+    }
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "Test.grpc.pb.h"
+
+#include "ShuHai/gRPC/Server/AsyncServer.h"
+#include "ShuHai/gRPC/Client/AsyncClient.h"
+
+#include <gtest/gtest.h>
+
+#include <asio/post.hpp>
+#include <asio/thread_pool.hpp>
+
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <chrono>
+#include <thread>
+
+namespace ShuHai::gRPC::Test
+{
+    /**
+     * \brief Execution context of a single thread that the tests are able to keep busy, so that the calls dispatched to
+     *  it wait until it is released.
+     */
+    class BlockableThread
+    {
+    public:
+        ~BlockableThread()
+        {
+            release();
+            _pool.join();
+        }
+
+        Executor executor() { return &_pool; }
+
+        /**
+         * \brief Keep the thread busy until release() is called, returns once the thread is busy.
+         */
+        void block()
+        {
+            release();
+            _released = std::promise<void>();
+            _blocked = true;
+
+            std::promise<void> busy;
+            asio::post(_pool,
+                [&busy, released = _released.get_future()]()
+                {
+                    busy.set_value();
+                    released.wait();
+                });
+            busy.get_future().wait();
+        }
+
+        void release()
+        {
+            if (!_blocked)
+                return;
+            _blocked = false;
+            _released.set_value();
+        }
+
+    private:
+        asio::thread_pool _pool { 1 };
+        std::promise<void> _released;
+        bool _blocked {};
+    };
+
+    /**
+     * \brief Fixture of end-to-end tests: an echo server on a free local port whose unary calls are completed by the
+     *  tests through takeCall(), and a client of the server.
+     */
+    class EchoTest : public testing::Test
+    {
+    public:
+        using EchoServer = Server::AsyncServer<EchoService::AsyncService>;
+        using EchoClient = Client::AsyncClient<EchoService::Stub>;
+        using EchoResponder = Server::Responder<EchoMessage>;
+
+        /**
+         * \brief A unary call received by the server, which waits for the test to complete it.
+         */
+        struct EchoCall
+        {
+            int value {};
+            EchoResponder responder;
+            CancellationToken cancellationToken;
+        };
+
+        void SetUp() override
+        {
+            _server = makeServer(serverOptions());
+            registerHandlers(*_server);
+            _server->start();
+            _client = std::make_unique<EchoClient>(
+                address(*_server), grpc::InsecureChannelCredentials(), grpc::ChannelArguments(), clientOptions());
+        }
+
+        void TearDown() override
+        {
+            _client = nullptr;
+            if (_server)
+                _server->stop(std::chrono::milliseconds(100));
+            _calls.clear();
+        }
+
+        /**
+         * \brief Make a server listening on a port picked by the system, see address().
+         */
+        static std::unique_ptr<EchoServer> makeServer(const Server::AsyncServerOptions& options = {})
+        {
+            return std::make_unique<EchoServer>(std::vector<std::string> { "localhost:0" }, options);
+        }
+
+        static std::string address(const EchoServer& server)
+        {
+            return "localhost:" + std::to_string(server.selectedPorts().front());
+        }
+
+        std::shared_future<EchoMessage> call(int value)
+        {
+            EchoMessage request;
+            request.set_value(value);
+            return _client->call(&EchoService::Stub::AsyncEcho, request)->response();
+        }
+
+        /**
+         * \brief Wait for the next unary call received by the server.
+         */
+        EchoCall takeCall()
+        {
+            std::unique_lock l(_mutex);
+            _callsChanged.wait(l, [this]() { return !_calls.empty(); });
+            auto call = std::move(_calls.front());
+            _calls.pop_front();
+            return call;
+        }
+
+        static grpc::StatusCode errorCode(const std::shared_future<EchoMessage>& response)
+        {
+            try
+            {
+                response.get();
+            }
+            catch (const Client::AsyncCallError& e)
+            {
+                return e.status().error_code();
+            }
+            return grpc::StatusCode::OK;
+        }
+
+        static bool waitUntil(const std::function<bool()>& condition)
+        {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            while (!condition())
+            {
+                if (std::chrono::steady_clock::now() >= deadline)
+                    return false;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return true;
+        }
+
+    protected:
+        virtual Server::AsyncServerOptions serverOptions() const { return {}; }
+
+        virtual Client::AsyncClientOptions clientOptions() const { return {}; }
+
+        /**
+         * \brief Register the handlers of the server before it starts, the unary echo calls are kept for takeCall()
+         *  by default.
+         */
+        virtual void registerHandlers(EchoServer& server)
+        {
+            server.registerCallHandler(&EchoService::AsyncService::RequestEcho,
+                [this](grpc::ServerContext& context, const EchoMessage& request, EchoResponder responder)
+                {
+                    std::lock_guard l(_mutex);
+                    _calls.push_back({ request.value(), std::move(responder), Server::cancellationToken(context) });
+                    _callsChanged.notify_all();
+                });
+        }
+
+        std::unique_ptr<EchoServer> _server;
+        std::unique_ptr<EchoClient> _client;
+
+        std::mutex _mutex;
+        std::condition_variable _callsChanged;
+        std::deque<EchoCall> _calls;
+    };
+}
@@ -0,0 +1,60 @@
+#include "ShuHai/gRPC/Executor.h"
+
+#include <asio/thread_pool.hpp>
+
+#include <gtest/gtest.h>
+
+#include <future>
+#include <thread>
+
+namespace ShuHai::gRPC::Test
+{
+    class ExecutorTest : public testing::Test
+    {
+    public:
+        static std::thread::id threadIdOf(const Executor& executor)
+        {
+            std::promise<std::thread::id> id;
+            executor.dispatch([&id]() { id.set_value(std::this_thread::get_id()); });
+            return id.get_future().get();
+        }
+    };
+
+    TEST_F(ExecutorTest, NullExecutorShouldExecuteInline)
+    {
+        Executor executor(nullptr);
+        EXPECT_FALSE(executor);
+        EXPECT_EQ(threadIdOf(executor), std::this_thread::get_id());
+
+        asio::thread_pool* pool = nullptr;
+        EXPECT_FALSE(Executor(pool));
+    }
+
+    TEST_F(ExecutorTest, AsioContextShouldExecuteFunctions)
+    {
+        asio::thread_pool pool(1);
+        Executor executor(&pool);
+        EXPECT_TRUE(executor);
+        EXPECT_NE(threadIdOf(executor), std::this_thread::get_id());
+        pool.join();
+    }
+
+    TEST_F(ExecutorTest, BaseClassPointerShouldMakeNullExecutor)
+    {
+        asio::thread_pool pool(1);
+        asio::execution_context* base = &pool;
+#if defined(_MSC_VER)
+#pragma warning(suppress : 4996)
+#else
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+        Executor executor(base);
+#if !defined(_MSC_VER)
+#pragma GCC diagnostic pop
+#endif
+        EXPECT_FALSE(executor);
+        EXPECT_EQ(threadIdOf(executor), std::this_thread::get_id());
+        pool.join();
+    }
+}
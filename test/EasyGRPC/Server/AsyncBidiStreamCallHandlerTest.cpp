@@ -0,0 +1,90 @@
+#include "EasyGRPC/EchoTest.h"
+
+namespace ShuHai::gRPC::Server::Test
+{
+    using namespace ShuHai::gRPC::Test;
+
+    class AsyncBidiStreamCallHandlerTest : public EchoTest
+    {
+    public:
+        using Handler = AsyncBidiStreamCallHandler<decltype(&EchoService::AsyncService::RequestChat)>;
+
+        static EchoMessage message(int value)
+        {
+            EchoMessage m;
+            m.set_value(value);
+            return m;
+        }
+
+    protected:
+        // Greets with 0, replies each message with its double, and replies the number of messages read once the
+        // client is done with writing.
+        void registerHandlers(EchoServer& server) override
+        {
+            EchoTest::registerHandlers(server);
+            server.registerCallHandler(&EchoService::AsyncService::RequestChat,
+                [](grpc::ServerContext&, std::shared_ptr<Handler::StreamWriter> writer)
+                {
+                    writer->write(message(0));
+
+                    auto count = std::make_shared<int>(0);
+                    Handler::StreamHandler handler;
+                    handler.onRead = [writer, count](const EchoMessage& request)
+                    {
+                        ++*count;
+                        writer->write(message(request.value() * 2));
+                    };
+                    handler.onReadDone = [writer, count]()
+                    {
+                        writer->write(message(*count));
+                        writer->finish();
+                    };
+                    return handler;
+                });
+        }
+    };
+
+    TEST_F(AsyncBidiStreamCallHandlerTest, ReadsAndWritesShouldInterleave)
+    {
+        auto call = _client->call(&EchoService::Stub::AsyncChat);
+        auto writer = call->streamWriter().get();
+        auto reader = call->streamReader().get();
+
+        ASSERT_TRUE(reader->moveNext().get());
+        EXPECT_EQ(reader->current().value(), 0);
+
+        // Each message is replied before the next one is written.
+        for (int i = 1; i <= 5; ++i)
+        {
+            ASSERT_TRUE(writer->write(message(i)).get());
+            ASSERT_TRUE(reader->moveNext().get());
+            EXPECT_EQ(reader->current().value(), i * 2);
+        }
+
+        // The server keeps writing after the client is done with writing.
+        EXPECT_TRUE(writer->finish().get());
+        ASSERT_TRUE(reader->moveNext().get());
+        EXPECT_EQ(reader->current().value(), 5);
+
+        EXPECT_FALSE(reader->moveNext().get());
+        EXPECT_TRUE(call->finished().get().ok());
+    }
+
+    TEST_F(AsyncBidiStreamCallHandlerTest, RepliesShouldKeepOrderOfWrites)
+    {
+        auto call = _client->call(&EchoService::Stub::AsyncChat);
+        auto writer = call->streamWriter().get();
+        auto reader = call->streamReader().get();
+
+        // Write all messages ahead of reading any reply.
+        for (int i = 1; i <= 10; ++i)
+            writer->write(message(i));
+        writer->finish();
+
+        std::vector<int> values;
+        while (reader->moveNext().get())
+            values.push_back(reader->current().value());
+        EXPECT_EQ(values, (std::vector<int> { 0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 10 }));
+        EXPECT_TRUE(call->finished().get().ok());
+    }
+}
@@ -0,0 +1,134 @@
+#include "EasyGRPC/EchoTest.h"
+
+#include <atomic>
+#include <vector>
+
+namespace ShuHai::gRPC::Server::Test
+{
+    using namespace ShuHai::gRPC::Test;
+
+    class AsyncCallAdmissionTest : public EchoTest
+    {
+    public:
+        using StreamWriter = AsyncServerStreamWriter<decltype(&EchoService::AsyncService::RequestCount)>;
+        using CountCall = Client::AsyncServerStreamCall<decltype(&EchoService::Stub::AsyncCount)>;
+
+        std::shared_ptr<CountCall> count() { return _client->call(&EchoService::Stub::AsyncCount, EchoMessage()); }
+
+        // Read the stream of the specified call to its end and get the status it finished with.
+        static grpc::Status finishedStatus(CountCall& call)
+        {
+            auto reader = call.streamReader().get();
+            while (reader->moveNext().get())
+            { }
+            return call.finished().get();
+        }
+
+        std::shared_ptr<StreamWriter> takeWriter()
+        {
+            std::unique_lock l(_mutex);
+            _callsChanged.wait(l, [this]() { return !_writers.empty(); });
+            auto writer = std::move(_writers.front());
+            _writers.erase(_writers.begin());
+            return writer;
+        }
+
+    protected:
+        // Both handlers admit one call at a time, the unary calls are kept for takeCall() and the streams for
+        // takeWriter().
+        void registerHandlers(EchoServer& server) override
+        {
+            AsyncCallHandlerOptions options;
+            options.maxInFlightCallCount = 1;
+
+            _unaryStats = server.registerCallHandler(&EchoService::AsyncService::RequestEcho,
+                [this](grpc::ServerContext& context, const EchoMessage& request, EchoResponder responder)
+                {
+                    ++_handledCallCount;
+                    std::lock_guard l(_mutex);
+                    _calls.push_back({ request.value(), std::move(responder), Server::cancellationToken(context) });
+                    _callsChanged.notify_all();
+                },
+                nullptr, {}, options);
+
+            _streamStats = server.registerCallHandler(&EchoService::AsyncService::RequestCount,
+                [this](grpc::ServerContext&, const EchoMessage&, std::shared_ptr<StreamWriter> writer)
+                {
+                    ++_handledCallCount;
+                    std::lock_guard l(_mutex);
+                    _writers.emplace_back(std::move(writer));
+                    _callsChanged.notify_all();
+                },
+                nullptr, {}, options);
+        }
+
+        std::shared_ptr<const AsyncCallHandlerStats> _unaryStats;
+        std::shared_ptr<const AsyncCallHandlerStats> _streamStats;
+        std::atomic_int _handledCallCount {};
+        std::vector<std::shared_ptr<StreamWriter>> _writers;
+    };
+
+    TEST_F(AsyncCallAdmissionTest, UnaryCallBeyondInFlightLimitShouldBeShed)
+    {
+        auto first = call(1);
+        auto responder = takeCall().responder;
+
+        auto second = call(2);
+        EXPECT_EQ(errorCode(second), grpc::StatusCode::RESOURCE_EXHAUSTED);
+        EXPECT_EQ(_handledCallCount, 1);
+        EXPECT_EQ(_unaryStats->acceptedCallCount, 1u);
+        EXPECT_EQ(_unaryStats->shedCallCount, 1u);
+
+        // The slot is released once the admitted call is finished.
+        responder.respond();
+        EXPECT_EQ(errorCode(first), grpc::StatusCode::OK);
+        EXPECT_TRUE(waitUntil([&]() { return _unaryStats->inFlightCallCount == 0; }));
+
+        auto third = call(3);
+        takeCall().responder.respond();
+        EXPECT_EQ(errorCode(third), grpc::StatusCode::OK);
+        EXPECT_EQ(_handledCallCount, 2);
+        EXPECT_EQ(_unaryStats->acceptedCallCount, 2u);
+        EXPECT_EQ(_unaryStats->shedCallCount, 1u);
+    }
+
+    TEST_F(AsyncCallAdmissionTest, StreamBeyondInFlightLimitShouldBeShed)
+    {
+        auto first = count();
+        auto writer = takeWriter();
+
+        auto second = count();
+        EXPECT_EQ(finishedStatus(*second).error_code(), grpc::StatusCode::RESOURCE_EXHAUSTED);
+        EXPECT_EQ(_handledCallCount, 1);
+        EXPECT_EQ(_streamStats->acceptedCallCount, 1u);
+        EXPECT_EQ(_streamStats->shedCallCount, 1u);
+
+        // The slot of a stream is released once its finish completes, rather than once its writer is released.
+        EXPECT_TRUE(writer->finish().get());
+        EXPECT_TRUE(finishedStatus(*first).ok());
+        EXPECT_TRUE(waitUntil([&]() { return _streamStats->inFlightCallCount == 0; }));
+
+        auto third = count();
+        EXPECT_TRUE(takeWriter()->finish().get());
+        EXPECT_TRUE(finishedStatus(*third).ok());
+        EXPECT_EQ(_handledCallCount, 2);
+        EXPECT_EQ(_streamStats->acceptedCallCount, 2u);
+        EXPECT_EQ(_streamStats->shedCallCount, 1u);
+    }
+
+    TEST_F(AsyncCallAdmissionTest, LimitShouldBeKeptPerHandler)
+    {
+        auto response = call(1);
+        auto responder = takeCall().responder;
+
+        // The stream handler has a slot of its own.
+        auto stream = count();
+        EXPECT_TRUE(takeWriter()->finish().get());
+        EXPECT_TRUE(finishedStatus(*stream).ok());
+
+        responder.respond();
+        EXPECT_EQ(errorCode(response), grpc::StatusCode::OK);
+        EXPECT_EQ(_unaryStats->shedCallCount, 0u);
+        EXPECT_EQ(_streamStats->shedCallCount, 0u);
+    }
+}
@@ -0,0 +1,126 @@
+#include "EasyGRPC/EchoTest.h"
+
+namespace ShuHai::gRPC::Server::Test
+{
+    using namespace ShuHai::gRPC::Test;
+    using namespace std::chrono_literals;
+
+    class AsyncCallContextTest : public EchoTest
+    {
+    public:
+        std::shared_ptr<Client::AsyncUnaryCall<decltype(&EchoService::Stub::AsyncEcho)>> echo(
+            int value, std::unique_ptr<grpc::ClientContext> context = nullptr)
+        {
+            EchoMessage request;
+            request.set_value(value);
+            return _client->call(&EchoService::Stub::AsyncEcho, request, std::move(context));
+        }
+    };
+
+    TEST_F(AsyncCallContextTest, CancelledCallShouldSetCancellationFlag)
+    {
+        auto echoCall = echo(1);
+        auto taken = takeCall();
+        EXPECT_FALSE(taken.cancellationToken.cancelled());
+
+        echoCall->context().TryCancel();
+        EXPECT_TRUE(waitUntil([&]() { return taken.cancellationToken.cancelled(); }));
+        EXPECT_EQ(errorCode(echoCall->response()), grpc::StatusCode::CANCELLED);
+
+        // Completing the cancelled call only releases it.
+        taken.responder.respond();
+    }
+
+    TEST_F(AsyncCallContextTest, ExpiredCallShouldSetCancellationFlag)
+    {
+        auto context = std::make_unique<grpc::ClientContext>();
+        context->set_deadline(std::chrono::system_clock::now() + 50ms);
+        auto echoCall = echo(2, std::move(context));
+        auto taken = takeCall();
+
+        EXPECT_TRUE(waitUntil([&]() { return taken.cancellationToken.cancelled(); }));
+        EXPECT_EQ(errorCode(echoCall->response()), grpc::StatusCode::DEADLINE_EXCEEDED);
+    }
+
+    TEST_F(AsyncCallContextTest, CompletedCallShouldNotBeCancelled)
+    {
+        auto response = call(3);
+        auto taken = takeCall();
+        taken.responder.respond();
+        EXPECT_EQ(errorCode(response), grpc::StatusCode::OK);
+        EXPECT_FALSE(taken.cancellationToken.cancelled());
+    }
+
+    class AsyncCallCancelledBeforeHandlingTest : public EchoTest
+    {
+    public:
+        using StreamWriter = AsyncServerStreamWriter<decltype(&EchoService::AsyncService::RequestCount)>;
+
+    protected:
+        // Handlers run on the blockable thread and count the calls they get.
+        void registerHandlers(EchoServer& server) override
+        {
+            _unaryStats = server.registerCallHandler(&EchoService::AsyncService::RequestEcho,
+                [this](grpc::ServerContext&, const EchoMessage& request)
+                {
+                    ++_handledCallCount;
+                    return request;
+                },
+                _thread.executor());
+
+            _streamStats = server.registerCallHandler(&EchoService::AsyncService::RequestCount,
+                [this](grpc::ServerContext&, const EchoMessage&, std::shared_ptr<StreamWriter> writer)
+                {
+                    ++_handledCallCount;
+                    writer->finish();
+                },
+                _thread.executor());
+        }
+
+        BlockableThread _thread;
+        std::shared_ptr<const AsyncCallHandlerStats> _unaryStats;
+        std::shared_ptr<const AsyncCallHandlerStats> _streamStats;
+        std::atomic_int _handledCallCount {};
+    };
+
+    TEST_F(AsyncCallCancelledBeforeHandlingTest, UnaryCallShouldNotBeHandled)
+    {
+        _thread.block();
+        auto call =
+            _client->call(&EchoService::Stub::AsyncEcho, EchoMessage(), std::make_unique<grpc::ClientContext>());
+        EXPECT_TRUE(waitUntil([&]() { return _unaryStats->acceptedCallCount == 1; }));
+        call->context().TryCancel();
+        EXPECT_EQ(errorCode(call->response()), grpc::StatusCode::CANCELLED);
+
+        // The server learns of the cancellation from the done notification of the call, which has nothing to wait for.
+        std::this_thread::sleep_for(100ms);
+        _thread.release();
+        EXPECT_TRUE(waitUntil([&]() { return _unaryStats->cancelledCallCount == 1; }));
+        EXPECT_TRUE(waitUntil([&]() { return _unaryStats->inFlightCallCount == 0; }));
+        EXPECT_EQ(_handledCallCount, 0);
+    }
+
+    TEST_F(AsyncCallCancelledBeforeHandlingTest, ServerStreamShouldNotBeHandled)
+    {
+        _thread.block();
+        auto call = _client->call(&EchoService::Stub::AsyncCount, EchoMessage());
+        EXPECT_TRUE(waitUntil([&]() { return _streamStats->acceptedCallCount == 1; }));
+        call->context().TryCancel();
+        auto reader = call->streamReader().get();
+        EXPECT_FALSE(reader->moveNext().get());
+        EXPECT_EQ(call->finished().get().error_code(), grpc::StatusCode::CANCELLED);
+
+        std::this_thread::sleep_for(100ms);
+        _thread.release();
+        EXPECT_TRUE(waitUntil([&]() { return _streamStats->cancelledCallCount == 1; }));
+        EXPECT_TRUE(waitUntil([&]() { return _streamStats->inFlightCallCount == 0; }));
+        EXPECT_EQ(_handledCallCount, 0);
+    }
+
+    TEST(CancellationTokenTest, TokenOfContextNotMadeByHandlersShouldNeverBeCancelled)
+    {
+        grpc::ServerContext context;
+        EXPECT_FALSE(cancellationToken(context).cancelled());
+        EXPECT_FALSE(CancellationToken().cancelled());
+    }
+}
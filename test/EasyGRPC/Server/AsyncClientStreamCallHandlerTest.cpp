@@ -0,0 +1,106 @@
+#include "EasyGRPC/EchoTest.h"
+
+#include <atomic>
+
+namespace ShuHai::gRPC::Server::Test
+{
+    using namespace ShuHai::gRPC::Test;
+    using namespace std::chrono_literals;
+
+    class AsyncClientStreamCallHandlerTest : public EchoTest
+    {
+    public:
+        using Handler = AsyncClientStreamCallHandler<decltype(&EchoService::AsyncService::RequestSum)>;
+
+        std::shared_future<EchoMessage> sum(int count)
+        {
+            auto call = _client->call(&EchoService::Stub::AsyncSum);
+            auto writer = call->streamWriter().get();
+            for (int i = 1; i <= count; ++i)
+            {
+                EchoMessage message;
+                message.set_value(i);
+                writer->write(message);
+            }
+            writer->finish();
+            return call->response();
+        }
+
+    protected:
+        void registerHandlers(EchoServer& server) override
+        {
+            EchoTest::registerHandlers(server);
+            server.registerCallHandler(
+                &EchoService::AsyncService::RequestSum, [this](grpc::ServerContext&) { return _streamHandler(); }, 0);
+        }
+
+        std::function<Handler::StreamHandler()> _streamHandler;
+    };
+
+    TEST_F(AsyncClientStreamCallHandlerTest, ResponseShouldBeMadeOnceAllMessagesAreRead)
+    {
+        std::vector<int> values;
+        std::atomic_int readDoneCount {};
+        _streamHandler = [&]()
+        {
+            Handler::StreamHandler handler;
+            handler.onRead = [&](const EchoMessage& request) { values.push_back(request.value()); };
+            handler.onReadDone = [&]()
+            {
+                ++readDoneCount;
+                EchoMessage response;
+                for (auto v : values)
+                    response.set_value(response.value() + v);
+                return response;
+            };
+            return handler;
+        };
+
+        EXPECT_EQ(sum(10).get().value(), 55);
+        EXPECT_EQ(values, (std::vector<int> { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 }));
+        EXPECT_EQ(readDoneCount, 1);
+    }
+
+    TEST_F(AsyncClientStreamCallHandlerTest, NextMessageShouldNotBeReadUntilOnReadReturns)
+    {
+        std::atomic_bool reading {};
+        std::atomic_bool overlapped {};
+        std::atomic_int readCount {};
+        _streamHandler = [&]()
+        {
+            Handler::StreamHandler handler;
+            handler.onRead = [&](const EchoMessage&)
+            {
+                if (reading.exchange(true))
+                    overlapped = true;
+                std::this_thread::sleep_for(1ms);
+                ++readCount;
+                reading = false;
+            };
+            handler.onReadDone = [&]()
+            {
+                EchoMessage response;
+                response.set_value(readCount);
+                return response;
+            };
+            return handler;
+        };
+
+        EXPECT_EQ(sum(20).get().value(), 20);
+        EXPECT_FALSE(overlapped);
+    }
+
+    TEST_F(AsyncClientStreamCallHandlerTest, NullReadDoneShouldRespondDefaultResponse)
+    {
+        std::atomic_int readCount {};
+        _streamHandler = [&]()
+        {
+            Handler::StreamHandler handler;
+            handler.onRead = [&](const EchoMessage&) { ++readCount; };
+            return handler;
+        };
+
+        EXPECT_EQ(sum(3).get().value(), 0);
+        EXPECT_EQ(readCount, 3);
+    }
+}
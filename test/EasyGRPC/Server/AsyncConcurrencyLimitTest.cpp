@@ -0,0 +1,124 @@
+#include "EasyGRPC/EchoTest.h"
+
+namespace ShuHai::gRPC::Server::Test
+{
+    using namespace ShuHai::gRPC::Test;
+    using namespace std::chrono_literals;
+
+    class AsyncConcurrencyLimitTest : public EchoTest
+    {
+    public:
+        // Limiter that halves its limit on the first sample, since the first window ends with a probe of the latency
+        // without load.
+        static AsyncConcurrencyLimiter::Options probingOptions()
+        {
+            AsyncConcurrencyLimiter::Options options;
+            options.initialLimit = 4;
+            options.maxLimit = 4;
+            options.windowSampleCount = 1;
+            options.probeIntervalWindowCount = 1;
+            return options;
+        }
+
+        std::shared_ptr<Client::AsyncUnaryCall<decltype(&EchoService::Stub::AsyncEcho)>> echo(int value)
+        {
+            EchoMessage request;
+            request.set_value(value);
+            return _client->call(&EchoService::Stub::AsyncEcho, request, std::make_unique<grpc::ClientContext>());
+        }
+
+    protected:
+        // Echo calls are kept for takeCall() as by default, except that they are handled on the blockable thread and
+        // limited by the limiter of the test.
+        void registerHandlers(EchoServer& server) override
+        {
+            AsyncCallHandlerOptions options;
+            options.concurrencyLimiter = _limiter;
+            _stats = server.registerCallHandler(&EchoService::AsyncService::RequestEcho,
+                [this](grpc::ServerContext& context, const EchoMessage& request, EchoResponder responder)
+                {
+                    ++_handledCallCount;
+                    std::lock_guard l(_mutex);
+                    _calls.push_back({ request.value(), std::move(responder), Server::cancellationToken(context) });
+                    _callsChanged.notify_all();
+                },
+                _thread.executor(), {}, options);
+        }
+
+        BlockableThread _thread;
+        std::shared_ptr<AsyncConcurrencyLimiter> _limiter;
+        std::shared_ptr<const AsyncCallHandlerStats> _stats;
+        std::atomic_int _handledCallCount {};
+    };
+
+    class AsyncConcurrencyLimitOfOneTest : public AsyncConcurrencyLimitTest
+    {
+    protected:
+        void registerHandlers(EchoServer& server) override
+        {
+            AsyncConcurrencyLimiter::Options options;
+            options.initialLimit = 1;
+            options.minLimit = 1;
+            options.maxLimit = 1;
+            _limiter = std::make_shared<AsyncConcurrencyLimiter>(options);
+            AsyncConcurrencyLimitTest::registerHandlers(server);
+        }
+    };
+
+    class AsyncConcurrencyLimitProbingTest : public AsyncConcurrencyLimitTest
+    {
+    protected:
+        void registerHandlers(EchoServer& server) override
+        {
+            _limiter = std::make_shared<AsyncConcurrencyLimiter>(probingOptions());
+            AsyncConcurrencyLimitTest::registerHandlers(server);
+        }
+    };
+
+    TEST_F(AsyncConcurrencyLimitOfOneTest, CallBeyondLimitShouldBeShed)
+    {
+        auto first = call(1);
+        auto responder = takeCall().responder;
+
+        auto second = call(2);
+        EXPECT_EQ(errorCode(second), grpc::StatusCode::RESOURCE_EXHAUSTED);
+        EXPECT_EQ(_handledCallCount, 1);
+        EXPECT_EQ(_stats->acceptedCallCount, 1u);
+        EXPECT_EQ(_stats->shedCallCount, 1u);
+
+        responder.respond();
+        EXPECT_EQ(errorCode(first), grpc::StatusCode::OK);
+        EXPECT_TRUE(waitUntil([&]() { return _stats->inFlightCallCount == 0; }));
+
+        auto third = call(3);
+        takeCall().responder.respond();
+        EXPECT_EQ(errorCode(third), grpc::StatusCode::OK);
+        EXPECT_EQ(_stats->shedCallCount, 1u);
+    }
+
+    TEST_F(AsyncConcurrencyLimitProbingTest, HandledCallShouldAddSample)
+    {
+        EXPECT_EQ(_limiter->limit(), 4u);
+        auto response = call(1);
+        takeCall().responder.respond();
+        EXPECT_EQ(errorCode(response), grpc::StatusCode::OK);
+        EXPECT_TRUE(waitUntil([&]() { return _limiter->limit() == 2; }));
+    }
+
+    TEST_F(AsyncConcurrencyLimitProbingTest, CancelledCallShouldNotAddSample)
+    {
+        _thread.block();
+        auto cancelled = echo(1);
+        EXPECT_TRUE(waitUntil([&]() { return _stats->acceptedCallCount == 1; }));
+        cancelled->context().TryCancel();
+        EXPECT_EQ(errorCode(cancelled->response()), grpc::StatusCode::CANCELLED);
+
+        // The server learns of the cancellation from the done notification of the call, which has nothing to wait for.
+        std::this_thread::sleep_for(100ms);
+        _thread.release();
+        EXPECT_TRUE(waitUntil([&]() { return _stats->inFlightCallCount == 0; }));
+        EXPECT_EQ(_stats->cancelledCallCount, 1u);
+        EXPECT_EQ(_handledCallCount, 0);
+        EXPECT_EQ(_limiter->limit(), 4u);
+    }
+}
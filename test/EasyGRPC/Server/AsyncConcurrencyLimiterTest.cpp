@@ -0,0 +1,126 @@
+#include "ShuHai/gRPC/Server/AsyncConcurrencyLimiter.h"
+
+#include <gtest/gtest.h>
+
+namespace ShuHai::gRPC::Server::Test
+{
+    using namespace std::chrono_literals;
+
+    class AsyncConcurrencyLimiterTest : public testing::Test
+    {
+    public:
+        static AsyncConcurrencyLimiter::Options options()
+        {
+            AsyncConcurrencyLimiter::Options options;
+            options.initialLimit = 20;
+            options.windowSampleCount = 4;
+            return options;
+        }
+
+        static void addWindow(
+            AsyncConcurrencyLimiter& limiter, std::chrono::nanoseconds latency, size_t inFlightCount)
+        {
+            for (size_t i = 0; i < limiter.options().windowSampleCount; ++i)
+                limiter.addSample(latency, inFlightCount);
+        }
+    };
+
+    TEST_F(AsyncConcurrencyLimiterTest, InvalidOptionsShouldThrow)
+    {
+        auto o = options();
+        o.minLimit = 0;
+        EXPECT_THROW(AsyncConcurrencyLimiter { o }, std::invalid_argument);
+
+        o = options();
+        o.initialLimit = o.maxLimit + 1;
+        EXPECT_THROW(AsyncConcurrencyLimiter { o }, std::invalid_argument);
+
+        o = options();
+        o.windowSampleCount = 0;
+        EXPECT_THROW(AsyncConcurrencyLimiter { o }, std::invalid_argument);
+    }
+
+    TEST_F(AsyncConcurrencyLimiterTest, LimitShouldNotChangeWithinWindow)
+    {
+        AsyncConcurrencyLimiter limiter(options());
+        for (size_t i = 0; i + 1 < limiter.options().windowSampleCount; ++i)
+            limiter.addSample(10ms, 20);
+        EXPECT_EQ(limiter.limit(), 20u);
+    }
+
+    TEST_F(AsyncConcurrencyLimiterTest, LimitShouldGrowWhileLatencyStaysLow)
+    {
+        auto o = options();
+        o.maxLimit = 40;
+        AsyncConcurrencyLimiter limiter(o);
+
+        addWindow(limiter, 10ms, 20);
+        auto grown = limiter.limit();
+        EXPECT_GT(grown, 20u);
+
+        for (int i = 0; i < 10; ++i)
+            addWindow(limiter, 10ms, limiter.limit());
+        EXPECT_EQ(limiter.limit(), 40u);
+    }
+
+    TEST_F(AsyncConcurrencyLimiterTest, LimitShouldNotGrowUnlessHit)
+    {
+        AsyncConcurrencyLimiter limiter(options());
+        for (int i = 0; i < 10; ++i)
+            addWindow(limiter, 10ms, 5);
+        EXPECT_EQ(limiter.limit(), 20u);
+    }
+
+    TEST_F(AsyncConcurrencyLimiterTest, LimitShouldBackOffOnceLatencyGrows)
+    {
+        auto o = options();
+        o.minLimit = 10;
+        AsyncConcurrencyLimiter limiter(o);
+
+        addWindow(limiter, 10ms, 20);
+        auto limit = limiter.limit();
+        for (int i = 0; i < 5; ++i)
+        {
+            addWindow(limiter, 40ms, limiter.limit());
+            EXPECT_LT(limiter.limit(), limit);
+            limit = limiter.limit();
+        }
+
+        for (int i = 0; i < 30; ++i)
+            addWindow(limiter, 40ms, limiter.limit());
+        EXPECT_EQ(limiter.limit(), 10u);
+    }
+
+    TEST_F(AsyncConcurrencyLimiterTest, ProbeShouldHalveLimitForOneWindow)
+    {
+        auto o = options();
+        o.probeIntervalWindowCount = 2;
+        AsyncConcurrencyLimiter limiter(o);
+
+        addWindow(limiter, 10ms, 20);
+        auto limit = limiter.limit();
+        ASSERT_GT(limit, 20u);
+
+        addWindow(limiter, 10ms, limit);
+        EXPECT_EQ(limiter.limit(), limit / 2);
+
+        addWindow(limiter, 10ms, limit / 2);
+        EXPECT_EQ(limiter.limit(), limit);
+    }
+
+    TEST_F(AsyncConcurrencyLimiterTest, ProbeShouldFollowSlowerService)
+    {
+        auto o = options();
+        o.probeIntervalWindowCount = 2;
+        AsyncConcurrencyLimiter limiter(o);
+
+        addWindow(limiter, 10ms, 20);
+        auto limit = limiter.limit();
+        addWindow(limiter, 10ms, limit);
+
+        // The service got slower for good, which the probe window takes as the latency without load.
+        addWindow(limiter, 20ms, limit / 2);
+        addWindow(limiter, 20ms, limit);
+        EXPECT_GT(limiter.limit(), limit);
+    }
+}
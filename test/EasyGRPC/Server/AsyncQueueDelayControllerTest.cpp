@@ -0,0 +1,109 @@
+#include "ShuHai/gRPC/Server/AsyncQueueDelayController.h"
+
+#include <gtest/gtest.h>
+
+namespace ShuHai::gRPC::Server::Test
+{
+    using namespace std::chrono_literals;
+
+    class AsyncQueueDelayControllerTest : public testing::Test
+    {
+    public:
+        using Clock = AsyncQueueDelayController::Clock;
+
+        static AsyncQueueDelayController::Options options()
+        {
+            AsyncQueueDelayController::Options options;
+            options.target = 5ms;
+            options.interval = 100ms;
+            return options;
+        }
+
+        // Let every call of the interval starting at the specified time wait for the specified delay, the next
+        // interval starts right after.
+        static void passInterval(AsyncQueueDelayController& controller, Clock::time_point start, Clock::duration delay)
+        {
+            for (auto t = start; t < start + controller.options().interval; t += 10ms)
+                controller.shouldDrop(delay, t);
+        }
+
+        const Clock::time_point start = Clock::time_point(100s);
+    };
+
+    TEST_F(AsyncQueueDelayControllerTest, InvalidOptionsShouldThrow)
+    {
+        auto o = options();
+        o.target = Clock::duration::zero();
+        EXPECT_THROW(AsyncQueueDelayController { o }, std::invalid_argument);
+
+        o = options();
+        o.interval = o.target - 1ms;
+        EXPECT_THROW(AsyncQueueDelayController { o }, std::invalid_argument);
+    }
+
+    TEST_F(AsyncQueueDelayControllerTest, CallsBeyondIntervalShouldDropWhileNotOverloaded)
+    {
+        AsyncQueueDelayController controller(options());
+        EXPECT_FALSE(controller.shouldDrop(50ms, start));
+        EXPECT_FALSE(controller.shouldDrop(100ms, start + 1ms));
+        EXPECT_TRUE(controller.shouldDrop(101ms, start + 2ms));
+        EXPECT_FALSE(controller.overloaded());
+    }
+
+    TEST_F(AsyncQueueDelayControllerTest, FirstIntervalShouldNotOverload)
+    {
+        AsyncQueueDelayController controller(options());
+        for (auto t = start; t < start + 100ms; t += 10ms)
+        {
+            EXPECT_FALSE(controller.shouldDrop(50ms, t));
+            EXPECT_FALSE(controller.overloaded());
+        }
+    }
+
+    TEST_F(AsyncQueueDelayControllerTest, StandingQueueShouldOverload)
+    {
+        AsyncQueueDelayController controller(options());
+        passInterval(controller, start, 10ms);
+        EXPECT_FALSE(controller.overloaded());
+
+        // The shortest wait of the whole interval exceeds the target.
+        EXPECT_TRUE(controller.shouldDrop(6ms, start + 100ms));
+        EXPECT_TRUE(controller.overloaded());
+        EXPECT_FALSE(controller.shouldDrop(5ms, start + 110ms));
+        EXPECT_TRUE(controller.shouldDrop(10ms, start + 120ms));
+    }
+
+    TEST_F(AsyncQueueDelayControllerTest, ShortWaitShouldNotOverload)
+    {
+        AsyncQueueDelayController controller(options());
+        passInterval(controller, start, 10ms);
+        controller.shouldDrop(5ms, start + 95ms);
+
+        EXPECT_FALSE(controller.shouldDrop(50ms, start + 100ms));
+        EXPECT_FALSE(controller.overloaded());
+    }
+
+    TEST_F(AsyncQueueDelayControllerTest, DrainedQueueShouldEndOverload)
+    {
+        AsyncQueueDelayController controller(options());
+        passInterval(controller, start, 10ms);
+        passInterval(controller, start + 100ms, 10ms);
+        ASSERT_TRUE(controller.overloaded());
+
+        passInterval(controller, start + 200ms, 1ms);
+        EXPECT_FALSE(controller.shouldDrop(50ms, start + 300ms));
+        EXPECT_FALSE(controller.overloaded());
+    }
+
+    TEST_F(AsyncQueueDelayControllerTest, IdleIntervalShouldEndOverload)
+    {
+        AsyncQueueDelayController controller(options());
+        passInterval(controller, start, 10ms);
+        passInterval(controller, start + 100ms, 10ms);
+        ASSERT_TRUE(controller.overloaded());
+
+        // No call during the whole interval after start + 200ms.
+        EXPECT_FALSE(controller.shouldDrop(50ms, start + 300ms));
+        EXPECT_FALSE(controller.overloaded());
+    }
+}
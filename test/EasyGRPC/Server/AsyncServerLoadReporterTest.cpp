@@ -0,0 +1,103 @@
+#include "ShuHai/gRPC/Server/AsyncServerLoadReporter.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+namespace ShuHai::gRPC::Server::Test
+{
+    using namespace std::chrono_literals;
+
+    TEST(ServerLoadTest, ParseShouldRestoreTextForm)
+    {
+        ServerLoad load;
+        load.inFlightCallCount = 3;
+        load.queueDepth = 2;
+        load.cpuBusyRatio = 0.5;
+        EXPECT_EQ(load.toString(), "3,2,0.500");
+
+        auto parsed = ServerLoad::parse(load.toString());
+        ASSERT_TRUE(parsed);
+        EXPECT_EQ(parsed->inFlightCallCount, 3u);
+        EXPECT_EQ(parsed->queueDepth, 2u);
+        EXPECT_DOUBLE_EQ(parsed->cpuBusyRatio, 0.5);
+    }
+
+    TEST(ServerLoadTest, MalformedTextShouldNotParse)
+    {
+        for (const char* text : { "", "1,2", "a,2,0.1", "1,2,x", "1,2,0.1x", "1,2,1.5", "1,2,-0.1" })
+            EXPECT_FALSE(ServerLoad::parse(text)) << text;
+    }
+
+    class AsyncServerLoadReporterTest : public testing::Test
+    {
+    public:
+        AsyncServerLoadReporter::Sampler sampler()
+        {
+            return [this]()
+            {
+                ++_sampleCount;
+                AsyncServerLoadReporter::Sample sample;
+                sample.inFlightCallCount = _inFlightCallCount;
+                sample.queueDepth = 1;
+                sample.busyTime = std::chrono::nanoseconds(_busyNanoseconds.load());
+                sample.threadCount = 1;
+                return sample;
+            };
+        }
+
+    protected:
+        std::atomic<uint64_t> _inFlightCallCount { 0 };
+        std::atomic<int64_t> _busyNanoseconds { 0 };
+        std::atomic_int _sampleCount { 0 };
+    };
+
+    TEST_F(AsyncServerLoadReporterTest, LoadShouldFollowSamplesOncePerInterval)
+    {
+        _inFlightCallCount = 4;
+        AsyncServerLoadReporter reporter(sampler(), 1ms);
+        auto load = reporter.load();
+        EXPECT_EQ(load.inFlightCallCount, 4u);
+        EXPECT_EQ(load.queueDepth, 1u);
+        EXPECT_EQ(load.cpuBusyRatio, 0);
+
+        // The threads are busier than the interval is long, which is taken as fully busy.
+        _inFlightCallCount = 7;
+        _busyNanoseconds = std::chrono::nanoseconds(1h).count();
+        std::this_thread::sleep_for(2ms);
+        load = reporter.load();
+        EXPECT_EQ(load.inFlightCallCount, 7u);
+        EXPECT_EQ(load.cpuBusyRatio, 1);
+
+        std::this_thread::sleep_for(2ms);
+        EXPECT_EQ(reporter.load().cpuBusyRatio, 0);
+    }
+
+    TEST_F(AsyncServerLoadReporterTest, LoadShouldNotBeSampledBeforeInterval)
+    {
+        AsyncServerLoadReporter reporter(sampler(), 1h);
+        _inFlightCallCount = 5;
+        for (int i = 0; i < 10; ++i)
+            EXPECT_EQ(reporter.load().inFlightCallCount, 0u);
+        EXPECT_EQ(_sampleCount, 1);
+    }
+
+    TEST_F(AsyncServerLoadReporterTest, StoppedReporterShouldKeepLoad)
+    {
+        AsyncServerLoadReporter reporter(sampler(), 1ms);
+        reporter.stop();
+        auto sampleCount = _sampleCount.load();
+
+        _inFlightCallCount = 5;
+        std::this_thread::sleep_for(2ms);
+        EXPECT_EQ(reporter.load().inFlightCallCount, 0u);
+        EXPECT_EQ(_sampleCount, sampleCount);
+    }
+
+    TEST_F(AsyncServerLoadReporterTest, InvalidArgumentsShouldThrow)
+    {
+        EXPECT_THROW(AsyncServerLoadReporter(nullptr, 1ms), std::invalid_argument);
+        EXPECT_THROW(AsyncServerLoadReporter(sampler(), 0ms), std::invalid_argument);
+    }
+}
@@ -0,0 +1,80 @@
+#include "EasyGRPC/EchoTest.h"
+
+namespace ShuHai::gRPC::Server::Test
+{
+    using namespace ShuHai::gRPC::Test;
+    using namespace std::chrono_literals;
+
+    class AsyncServerStopTest : public EchoTest
+    { };
+
+    TEST_F(AsyncServerStopTest, CallsInFlightAtDeadlineShouldBeAborted)
+    {
+        auto response = call(1);
+        auto responder = takeCall().responder;
+        EXPECT_EQ(_server->inFlightCallCount(), 1u);
+
+        auto stats = _server->stop(50ms);
+        EXPECT_EQ(stats.inFlightCallCount, 1u);
+        EXPECT_EQ(stats.abortedCallCount, 1u);
+        EXPECT_EQ(stats.drainedCallCount, 0u);
+        EXPECT_GE(stats.duration, 50ms);
+        EXPECT_NE(errorCode(response), grpc::StatusCode::OK);
+
+        // The call is already cancelled by the shutdown, completing it only releases it.
+        responder.respond();
+    }
+
+    TEST_F(AsyncServerStopTest, CallsCompletedBeforeDeadlineShouldBeDrained)
+    {
+        auto response = call(2);
+        auto responder = takeCall().responder;
+        std::thread completion([&responder]()
+            {
+                std::this_thread::sleep_for(20ms);
+                responder.response().set_value(4);
+                responder.respond();
+            });
+
+        auto stats = _server->stop(10s);
+        completion.join();
+        EXPECT_EQ(stats.inFlightCallCount, 1u);
+        EXPECT_EQ(stats.drainedCallCount, 1u);
+        EXPECT_EQ(stats.abortedCallCount, 0u);
+        EXPECT_LT(stats.duration, 10s);
+        EXPECT_EQ(response.get().value(), 4);
+    }
+
+    TEST_F(AsyncServerStopTest, StopWithoutCallsShouldReturnAtOnce)
+    {
+        auto stats = _server->stop(10s);
+        EXPECT_EQ(stats.inFlightCallCount, 0u);
+        EXPECT_LT(stats.duration, 10s);
+        EXPECT_TRUE(_server->stopped());
+    }
+
+    TEST_F(AsyncServerStopTest, StopOnStoppedServerShouldTakeNoEffect)
+    {
+        auto response = call(3);
+        takeCall().responder.respond();
+        response.get();
+
+        _server->stop();
+        auto stats = _server->stop(10s);
+        EXPECT_EQ(stats.inFlightCallCount, 0u);
+        EXPECT_EQ(stats.drainedCallCount, 0u);
+        EXPECT_EQ(stats.abortedCallCount, 0u);
+        EXPECT_EQ(stats.duration, 0ns);
+        EXPECT_THROW(_server->start(), std::logic_error);
+    }
+
+    TEST_F(AsyncServerStopTest, ServerNeverStartedShouldStopAtOnce)
+    {
+        auto server = makeServer();
+        registerHandlers(*server);
+        auto stats = server->stop(10s);
+        EXPECT_EQ(stats.inFlightCallCount, 0u);
+        EXPECT_LT(stats.duration, 10s);
+        EXPECT_FALSE(server->started());
+    }
+}
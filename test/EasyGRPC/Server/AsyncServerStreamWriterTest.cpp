@@ -0,0 +1,125 @@
+#include "EasyGRPC/EchoTest.h"
+
+namespace ShuHai::gRPC::Server::Test
+{
+    using namespace ShuHai::gRPC::Test;
+    using namespace std::chrono_literals;
+
+    class AsyncServerStreamWriterTest : public EchoTest
+    {
+    public:
+        using StreamWriter = AsyncServerStreamWriter<decltype(&EchoService::AsyncService::RequestCount)>;
+
+        struct StreamResult
+        {
+            std::vector<int> values;
+            grpc::Status status;
+        };
+
+        static EchoMessage message(int value)
+        {
+            EchoMessage m;
+            m.set_value(value);
+            return m;
+        }
+
+        StreamResult count()
+        {
+            auto call = _client->call(&EchoService::Stub::AsyncCount, EchoMessage());
+            auto reader = call->streamReader().get();
+
+            StreamResult result;
+            while (reader->moveNext().get())
+                result.values.push_back(reader->current().value());
+            result.status = call->finished().get();
+            return result;
+        }
+
+    protected:
+        // Handlers run on the only completion queue thread, so no write is finalized while a handler runs.
+        AsyncServerOptions serverOptions() const override
+        {
+            AsyncServerOptions options;
+            options.inlineHandlers = true;
+            return options;
+        }
+
+        void registerHandlers(EchoServer& server) override
+        {
+            EchoTest::registerHandlers(server);
+            server.registerCallHandler(&EchoService::AsyncService::RequestCount,
+                [this](grpc::ServerContext&, const EchoMessage&, std::shared_ptr<StreamWriter> writer)
+                { _streamHandler(writer); });
+        }
+
+        std::function<void(const std::shared_ptr<StreamWriter>&)> _streamHandler;
+    };
+
+    TEST_F(AsyncServerStreamWriterTest, WriteToFullQueueShouldFail)
+    {
+        _streamHandler = [](const std::shared_ptr<StreamWriter>& writer)
+        {
+            writer->setCapacity(1);
+            EXPECT_TRUE(writer->writable());
+            writer->write(message(1));
+            EXPECT_FALSE(writer->writable());
+            EXPECT_EQ(writer->pendingWriteCount(), 1u);
+
+            auto rejected = writer->write(message(2));
+            EXPECT_THROW(rejected.get(), StreamingQueueFull);
+            EXPECT_EQ(writer->pendingWriteCount(), 1u);
+            writer->finish();
+        };
+
+        auto result = count();
+        EXPECT_EQ(result.values, std::vector<int> { 1 });
+        EXPECT_TRUE(result.status.ok());
+    }
+
+    TEST_F(AsyncServerStreamWriterTest, WritableCallbackShouldBeCalledOnceQueueDrains)
+    {
+        std::atomic_int callbackCount {};
+        _streamHandler = [&callbackCount](const std::shared_ptr<StreamWriter>& writer)
+        {
+            writer->setCapacity(1);
+            writer->write(message(1));
+            EXPECT_FALSE(writer->writable());
+
+            std::weak_ptr<StreamWriter> weakWriter = writer;
+            writer->setWritableCallback(
+                [weakWriter, &callbackCount]()
+                {
+                    auto w = weakWriter.lock();
+                    ASSERT_TRUE(w);
+                    EXPECT_TRUE(w->writable());
+                    if (++callbackCount > 1)
+                        return;
+                    w->write(message(2));
+                    w->finish();
+                });
+        };
+
+        auto result = count();
+        EXPECT_EQ(result.values, (std::vector<int> { 1, 2 }));
+        EXPECT_TRUE(result.status.ok());
+        EXPECT_EQ(callbackCount, 1);
+    }
+
+    TEST_F(AsyncServerStreamWriterTest, FinishShouldFollowWrittenMessages)
+    {
+        _streamHandler = [](const std::shared_ptr<StreamWriter>& writer)
+        {
+            for (int i = 1; i <= 3; ++i)
+                writer->write(message(i));
+            writer->finish({ grpc::StatusCode::NOT_FOUND, "No more values." });
+            EXPECT_FALSE(writer->writable());
+
+            EXPECT_THROW(writer->write(message(4)).get(), InvalidStreamingAction);
+            EXPECT_THROW(writer->finish().get(), InvalidStreamingAction);
+        };
+
+        auto result = count();
+        EXPECT_EQ(result.values, (std::vector<int> { 1, 2, 3 }));
+        EXPECT_EQ(result.status.error_code(), grpc::StatusCode::NOT_FOUND);
+    }
+}
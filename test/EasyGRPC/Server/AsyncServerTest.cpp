@@ -0,0 +1,40 @@
+#include "EasyGRPC/EchoTest.h"
+
+namespace ShuHai::gRPC::Server::Test
+{
+    using namespace ShuHai::gRPC::Test;
+
+    class AsyncServerTest : public EchoTest
+    {
+    public:
+        static EchoMessage echo(grpc::ServerContext&, const EchoMessage& request) { return request; }
+
+    protected:
+        AsyncServerOptions serverOptions() const override
+        {
+            AsyncServerOptions options;
+            options.completionQueueCount = 2;
+            return options;
+        }
+
+        void registerHandlers(EchoServer& server) override
+        {
+            server.registerCallHandler(&EchoService::AsyncService::RequestEcho, &echo, nullptr, 1);
+        }
+    };
+
+    TEST_F(AsyncServerTest, HandlerRegisteredOnQueueIndexShouldHandleCalls)
+    {
+        EXPECT_EQ(call(3).get().value(), 3);
+        EXPECT_EQ(call(4).get().value(), 4);
+    }
+
+    TEST_F(AsyncServerTest, RegisterOnMissingQueueShouldThrow)
+    {
+        auto server = makeServer();
+        EXPECT_THROW(server->registerCallHandler(&EchoService::AsyncService::RequestEcho, &echo, nullptr, 1),
+            std::out_of_range);
+        EXPECT_THROW(server->registerCallHandler(&EchoService::AsyncService::RequestEcho, &echo, nullptr, { 0, 0 }),
+            std::invalid_argument);
+    }
+}
@@ -0,0 +1,120 @@
+#include "EasyGRPC/EchoTest.h"
+
+namespace ShuHai::gRPC::Server::Test
+{
+    using namespace ShuHai::gRPC::Test;
+    using namespace std::chrono_literals;
+
+    class AsyncUnaryCallDropTest : public EchoTest
+    {
+    public:
+        using StreamWriter = AsyncServerStreamWriter<decltype(&EchoService::AsyncService::RequestCount)>;
+
+        void TearDown() override
+        {
+            releaseQueue();
+            EchoTest::TearDown();
+        }
+
+        // Keep the only completion queue thread busy by a stream handler until releaseQueue() is called, thus the
+        // server does not learn of calls being cancelled meanwhile.
+        std::shared_ptr<Client::AsyncServerStreamCall<decltype(&EchoService::Stub::AsyncCount)>> blockQueue()
+        {
+            auto call = _client->call(&EchoService::Stub::AsyncCount, EchoMessage());
+            _queueBlocked.get_future().wait();
+            return call;
+        }
+
+        void releaseQueue()
+        {
+            if (!_queueReleased)
+            {
+                _queueReleased = true;
+                _queueRelease.set_value();
+            }
+        }
+
+    protected:
+        // Handlers run on the completion queue thread unless they have a context of their own.
+        AsyncServerOptions serverOptions() const override
+        {
+            AsyncServerOptions options;
+            options.inlineHandlers = true;
+            return options;
+        }
+
+        // Echo calls are handled on the blockable thread, calls waiting there for longer than 10ms are dropped.
+        void registerHandlers(EchoServer& server) override
+        {
+            AsyncQueueDelayController::Options controllerOptions;
+            controllerOptions.target = 10ms;
+            controllerOptions.interval = 10ms;
+            AsyncCallHandlerOptions options;
+            options.queueDelayController = std::make_shared<AsyncQueueDelayController>(controllerOptions);
+            _stats = server.registerCallHandler(&EchoService::AsyncService::RequestEcho,
+                [this](grpc::ServerContext&, const EchoMessage& request)
+                {
+                    ++_handledCallCount;
+                    return request;
+                },
+                _thread.executor(), {}, options);
+
+            server.registerCallHandler(&EchoService::AsyncService::RequestCount,
+                [this](grpc::ServerContext&, const EchoMessage&, std::shared_ptr<StreamWriter> writer)
+                {
+                    _queueBlocked.set_value();
+                    _queueRelease.get_future().wait();
+                    writer->finish();
+                });
+        }
+
+        BlockableThread _thread;
+        std::shared_ptr<const AsyncCallHandlerStats> _stats;
+        std::atomic_int _handledCallCount {};
+
+        std::promise<void> _queueBlocked;
+        std::promise<void> _queueRelease;
+        bool _queueReleased {};
+    };
+
+    TEST_F(AsyncUnaryCallDropTest, CallWaitedBeyondIntervalShouldBeDropped)
+    {
+        _thread.block();
+        auto response = call(1);
+        EXPECT_TRUE(waitUntil([&]() { return _stats->acceptedCallCount == 1; }));
+        std::this_thread::sleep_for(50ms);
+        _thread.release();
+
+        EXPECT_EQ(errorCode(response), grpc::StatusCode::RESOURCE_EXHAUSTED);
+        EXPECT_EQ(_stats->delayedCallCount, 1u);
+        EXPECT_GE(_stats->queueDelayNanoseconds, static_cast<uint64_t>(std::chrono::nanoseconds(50ms).count()));
+        EXPECT_EQ(_handledCallCount, 0);
+
+        // Calls that get handled in time are not dropped.
+        EXPECT_EQ(call(2).get().value(), 2);
+        EXPECT_EQ(_stats->delayedCallCount, 1u);
+        EXPECT_EQ(_handledCallCount, 1);
+    }
+
+    TEST_F(AsyncUnaryCallDropTest, CallExpiredBeforeHandlingShouldBeDropped)
+    {
+        _thread.block();
+        auto context = std::make_unique<grpc::ClientContext>();
+        context->set_deadline(std::chrono::system_clock::now() + 50ms);
+        auto response = _client->call(&EchoService::Stub::AsyncEcho, EchoMessage(), std::move(context))->response();
+        EXPECT_TRUE(waitUntil([&]() { return _stats->acceptedCallCount == 1; }));
+
+        // The call is not known to be cancelled by the time its deadline passes, it is dropped since it expired.
+        auto stream = blockQueue();
+        std::this_thread::sleep_for(100ms);
+        _thread.release();
+        EXPECT_TRUE(waitUntil([&]() { return _stats->expiredCallCount == 1; }));
+        releaseQueue();
+
+        EXPECT_EQ(errorCode(response), grpc::StatusCode::DEADLINE_EXCEEDED);
+        EXPECT_EQ(_stats->cancelledCallCount, 0u);
+        EXPECT_EQ(_stats->delayedCallCount, 0u);
+        EXPECT_EQ(_handledCallCount, 0);
+        EXPECT_TRUE(waitUntil([&]() { return _stats->inFlightCallCount == 0; }));
+    }
+}
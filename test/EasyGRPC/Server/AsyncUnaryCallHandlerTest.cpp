@@ -0,0 +1,275 @@
+#include "EasyGRPC/EchoTest.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    // Heap allocations made by the threads counting them, the server thread only.
+    std::atomic<size_t> allocationCount {};
+    thread_local bool countingAllocations = false;
+}
+
+void* operator new(std::size_t size)
+{
+    if (countingAllocations)
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (auto p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace ShuHai::gRPC::Server::Test
+{
+    using namespace ShuHai::gRPC::Test;
+
+    class AsyncUnaryCallHandlerTest : public EchoTest
+    {
+    public:
+        static constexpr int ValueCount = 16;
+
+        static void fill(const EchoMessage& request, EchoMessage& response)
+        {
+            response.set_value(request.value());
+            for (int i = 0; i < ValueCount; ++i)
+                response.add_values(i);
+        }
+
+        static void echoInPlace(grpc::ServerContext&, const EchoMessage& request, EchoMessage& response)
+        {
+            countingAllocations = true;
+            fill(request, response);
+        }
+
+        static EchoMessage echoReturned(grpc::ServerContext&, const EchoMessage& request)
+        {
+            countingAllocations = true;
+            EchoMessage response;
+            fill(request, response);
+            return response;
+        }
+
+        // Heap allocations made by the server thread for the specified number of calls. Handlers run on the only
+        // completion queue thread, which does all the work of the server for the calls.
+        template<typename HandleFunc>
+        static size_t serverAllocations(HandleFunc handleFunc, int callCount)
+        {
+            AsyncServerOptions options;
+            options.inlineHandlers = true;
+            auto server = makeServer(options);
+            server->registerCallHandler(&EchoService::AsyncService::RequestEcho, handleFunc);
+            server->start();
+            EchoClient client(address(*server));
+
+            auto run = [&](int count)
+            {
+                for (int i = 0; i < count; ++i)
+                {
+                    EchoMessage request;
+                    request.set_value(i);
+                    auto response = client.call(&EchoService::Stub::AsyncEcho, request)->response().get();
+                    EXPECT_EQ(response.values_size(), ValueCount);
+                }
+            };
+
+            // Warm up until the calls are pooled.
+            run(callCount);
+            allocationCount = 0;
+            run(callCount);
+            size_t count = allocationCount;
+
+            server->stop();
+            return count;
+        }
+
+    protected:
+        void registerHandlers(EchoServer& server) override
+        {
+            server.registerCallHandler(&EchoService::AsyncService::RequestEcho,
+                [](grpc::ServerContext&, const EchoMessage& request, EchoMessage& response)
+                { fill(request, response); });
+        }
+    };
+
+    TEST_F(AsyncUnaryCallHandlerTest, InPlaceHandlerShouldFillResponse)
+    {
+        auto response = call(7).get();
+        EXPECT_EQ(response.value(), 7);
+        EXPECT_EQ(response.values_size(), ValueCount);
+        EXPECT_EQ(response.values(ValueCount - 1), ValueCount - 1);
+    }
+
+    TEST_F(AsyncUnaryCallHandlerTest, InPlaceHandlerShouldAllocateLessThanReturnedResponse)
+    {
+        constexpr int callCount = 50;
+        auto inPlace = serverAllocations(&echoInPlace, callCount);
+        auto returned = serverAllocations(&echoReturned, callCount);
+
+        // The returned response allocates its values on the heap several times for each call as they grow, the one
+        // filled in place allocates them on the arena of the pooled call.
+        EXPECT_LT(inPlace + 2 * callCount, returned) << "in place: " << inPlace << ", returned: " << returned;
+    }
+
+    TEST_F(AsyncUnaryCallHandlerTest, PendingRequestsShouldServeBurstOfCalls)
+    {
+        constexpr int callCount = 16;
+        std::mutex mutex;
+        std::condition_variable responderAdded;
+        std::vector<EchoResponder> responders;
+
+        AsyncCallHandlerOptions options;
+        options.pendingRequestCount = 4;
+        auto server = makeServer();
+        auto stats = server->registerCallHandler(&EchoService::AsyncService::RequestEcho,
+            [&](grpc::ServerContext&, const EchoMessage& request, EchoResponder responder)
+            {
+                responder.response().set_value(request.value());
+                std::lock_guard l(mutex);
+                responders.emplace_back(std::move(responder));
+                responderAdded.notify_all();
+            },
+            nullptr, {}, options);
+        server->start();
+        EchoClient client(address(*server));
+
+        std::vector<std::shared_future<EchoMessage>> responses;
+        for (int i = 0; i < callCount; ++i)
+        {
+            EchoMessage request;
+            request.set_value(i);
+            responses.emplace_back(client.call(&EchoService::Stub::AsyncEcho, request)->response());
+        }
+
+        // All calls of the burst are matched while none of them is finished.
+        {
+            std::unique_lock l(mutex);
+            EXPECT_TRUE(responderAdded.wait_for(l, std::chrono::seconds(10),
+                [&]() { return responders.size() == static_cast<size_t>(callCount); }));
+        }
+        EXPECT_EQ(stats->consumedRequestCount, static_cast<uint64_t>(callCount));
+        EXPECT_EQ(stats->acceptedCallCount, static_cast<uint64_t>(callCount));
+
+        for (auto& responder : responders)
+            responder.respond();
+        for (int i = 0; i < callCount; ++i)
+            EXPECT_EQ(responses[i].get().value(), i);
+        EXPECT_EQ(stats->consumedRequestCount, static_cast<uint64_t>(callCount));
+
+        server->stop();
+    }
+
+    TEST_F(AsyncUnaryCallHandlerTest, ZeroPendingRequestCountShouldThrow)
+    {
+        AsyncCallHandlerOptions options;
+        options.pendingRequestCount = 0;
+        auto server = makeServer();
+        EXPECT_THROW(server->registerCallHandler(&EchoService::AsyncService::RequestEcho, &echoReturned, nullptr, {},
+                         options),
+            std::invalid_argument);
+    }
+
+    class AsyncUnaryCallFinishModeTest
+        : public EchoTest
+        , public testing::WithParamInterface<AsyncCallFinishMode>
+    {
+    public:
+        // Make a call to a server whose echo calls are handled by the specified function in the finish mode of the
+        // test, and wait for its response.
+        template<typename HandleFunc>
+        std::shared_future<EchoMessage> callWith(HandleFunc handleFunc, int value)
+        {
+            AsyncCallHandlerOptions options;
+            options.finishMode = GetParam();
+            auto server = makeServer();
+            server->registerCallHandler(&EchoService::AsyncService::RequestEcho, handleFunc, nullptr, {}, options);
+            server->start();
+
+            auto client = std::make_unique<EchoClient>(address(*server));
+            EchoMessage request;
+            request.set_value(value);
+            auto response = client->call(&EchoService::Stub::AsyncEcho, request)->response();
+            response.wait();
+
+            client = nullptr;
+            server->stop();
+            return response;
+        }
+    };
+
+    TEST_P(AsyncUnaryCallFinishModeTest, ReturnedResponseShouldBeSent)
+    {
+        auto response = callWith([](grpc::ServerContext&, const EchoMessage& request) { return request; }, 1);
+        EXPECT_EQ(response.get().value(), 1);
+    }
+
+    TEST_P(AsyncUnaryCallFinishModeTest, InPlaceResponseShouldBeSent)
+    {
+        auto response = callWith([](grpc::ServerContext&, const EchoMessage& request, EchoMessage& response)
+            { AsyncUnaryCallHandlerTest::fill(request, response); },
+            2);
+        EXPECT_EQ(response.get().value(), 2);
+        EXPECT_EQ(response.get().values_size(), AsyncUnaryCallHandlerTest::ValueCount);
+    }
+
+    TEST_P(AsyncUnaryCallFinishModeTest, ResponderShouldSendResponse)
+    {
+        auto response = callWith(
+            [](grpc::ServerContext&, const EchoMessage& request, EchoResponder responder)
+            {
+                responder.response().set_value(request.value());
+                responder.respond();
+            },
+            3);
+        EXPECT_EQ(response.get().value(), 3);
+    }
+
+    TEST_P(AsyncUnaryCallFinishModeTest, ThrowingHandlerShouldFailCall)
+    {
+        auto response = callWith([](grpc::ServerContext&, const EchoMessage&) -> EchoMessage
+            { throw std::runtime_error("Failed."); },
+            4);
+        EXPECT_EQ(errorCode(response), grpc::StatusCode::UNKNOWN);
+    }
+
+    TEST_P(AsyncUnaryCallFinishModeTest, ResponseMadeAfterShutdownShouldBeDropped)
+    {
+        std::promise<void> release;
+        auto released = release.get_future().share();
+        std::promise<void> entered;
+
+        AsyncCallHandlerOptions options;
+        options.finishMode = GetParam();
+        auto server = makeServer();
+        server->registerCallHandler(&EchoService::AsyncService::RequestEcho,
+            [&](grpc::ServerContext&, const EchoMessage& request)
+            {
+                entered.set_value();
+                released.wait();
+                return request;
+            },
+            nullptr, {}, options);
+        server->start();
+        EchoClient client(address(*server));
+        auto response = client.call(&EchoService::Stub::AsyncEcho, EchoMessage())->response();
+        entered.get_future().wait();
+
+        // The server waits for the handle function once its queues are shut down, the response made afterwards has
+        // nowhere to go.
+        std::thread stopping([&server]() { server->stop(std::chrono::milliseconds(10)); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        release.set_value();
+        stopping.join();
+        EXPECT_NE(errorCode(response), grpc::StatusCode::OK);
+    }
+
+    INSTANTIATE_TEST_SUITE_P(FinishModes, AsyncUnaryCallFinishModeTest,
+        testing::Values(AsyncCallFinishMode::CompletionQueue, AsyncCallFinishMode::Direct));
+}
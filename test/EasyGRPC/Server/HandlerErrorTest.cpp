@@ -0,0 +1,202 @@
+#include "EasyGRPC/EchoTest.h"
+
+#include <atomic>
+#include <stdexcept>
+
+namespace ShuHai::gRPC::Server::Test
+{
+    using namespace ShuHai::gRPC::Test;
+
+    class HandlerErrorTest : public EchoTest
+    {
+    public:
+        using ServerStreamWriter = AsyncServerStreamWriter<decltype(&EchoService::AsyncService::RequestCount)>;
+        using ClientStreamHandler = AsyncClientStreamCallHandler<decltype(&EchoService::AsyncService::RequestSum)>;
+        using BidiStreamHandler = AsyncBidiStreamCallHandler<decltype(&EchoService::AsyncService::RequestChat)>;
+
+        // The function of a stream handler that throws.
+        enum class Stage
+        {
+            Start,
+            Read,
+            ReadDone
+        };
+
+        [[noreturn]] static void fail() { throw std::runtime_error("Failed."); }
+
+        static grpc::Status status(const std::shared_future<EchoMessage>& response)
+        {
+            try
+            {
+                response.get();
+            }
+            catch (const Client::AsyncCallError& e)
+            {
+                return e.status();
+            }
+            return grpc::Status::OK;
+        }
+
+        static void expectFailed(const grpc::Status& status)
+        {
+            EXPECT_EQ(status.error_code(), grpc::StatusCode::UNKNOWN);
+            EXPECT_EQ(status.error_message(), "Failed.");
+        }
+
+        // Status of a unary call to a server of the specified handle function.
+        template<typename HandleFunc>
+        static grpc::Status unaryStatus(HandleFunc handleFunc)
+        {
+            auto server = makeServer();
+            server->registerCallHandler(&EchoService::AsyncService::RequestEcho, handleFunc);
+            server->start();
+            EchoClient client(address(*server));
+            auto result = status(client.call(&EchoService::Stub::AsyncEcho, EchoMessage())->response());
+            server->stop();
+            return result;
+        }
+
+        grpc::Status sum()
+        {
+            auto call = _client->call(&EchoService::Stub::AsyncSum);
+            auto writer = call->streamWriter().get();
+            for (int i = 1; i <= 3; ++i)
+            {
+                EchoMessage message;
+                message.set_value(i);
+                writer->write(message);
+            }
+            writer->finish();
+            return status(call->response());
+        }
+
+        grpc::Status chat()
+        {
+            auto call = _client->call(&EchoService::Stub::AsyncChat);
+            auto writer = call->streamWriter().get();
+            auto reader = call->streamReader().get();
+            for (int i = 1; i <= 3; ++i)
+            {
+                EchoMessage message;
+                message.set_value(i);
+                writer->write(message);
+            }
+            writer->finish();
+            while (reader->moveNext().get())
+                ;
+            return call->finished().get();
+        }
+
+    protected:
+        // Echo calls of negative values throw, the others are kept for takeCall() before throwing.
+        void registerHandlers(EchoServer& server) override
+        {
+            server.registerCallHandler(&EchoService::AsyncService::RequestEcho,
+                [this](grpc::ServerContext& context, const EchoMessage& request, EchoResponder responder)
+                {
+                    if (request.value() >= 0)
+                    {
+                        std::lock_guard l(_mutex);
+                        _calls.push_back({ request.value(), std::move(responder), cancellationToken(context) });
+                        _callsChanged.notify_all();
+                    }
+                    fail();
+                });
+
+            server.registerCallHandler(&EchoService::AsyncService::RequestCount,
+                [](grpc::ServerContext&, const EchoMessage&, std::shared_ptr<ServerStreamWriter> writer)
+                {
+                    writer->write(EchoMessage());
+                    fail();
+                });
+
+            server.registerCallHandler(&EchoService::AsyncService::RequestSum,
+                [this](grpc::ServerContext&)
+                {
+                    failAt(Stage::Start);
+                    ClientStreamHandler::StreamHandler handler;
+                    handler.onRead = [this](const EchoMessage&) { failAt(Stage::Read); };
+                    handler.onReadDone = [this]()
+                    {
+                        failAt(Stage::ReadDone);
+                        return EchoMessage();
+                    };
+                    return handler;
+                });
+
+            server.registerCallHandler(&EchoService::AsyncService::RequestChat,
+                [this](grpc::ServerContext&, std::shared_ptr<BidiStreamHandler::StreamWriter> writer)
+                {
+                    failAt(Stage::Start);
+                    BidiStreamHandler::StreamHandler handler;
+                    handler.onRead = [this](const EchoMessage&) { failAt(Stage::Read); };
+                    handler.onReadDone = [this, writer]()
+                    {
+                        failAt(Stage::ReadDone);
+                        writer->finish();
+                    };
+                    return handler;
+                });
+        }
+
+        void failAt(Stage stage) const
+        {
+            if (stage == _failingStage)
+                fail();
+        }
+
+        std::atomic<Stage> _failingStage { Stage::Start };
+    };
+
+    TEST_F(HandlerErrorTest, ThrowingHandlerShouldFailCall)
+    {
+        expectFailed(unaryStatus([](grpc::ServerContext&, const EchoMessage&) -> EchoMessage { fail(); }));
+    }
+
+    TEST_F(HandlerErrorTest, ThrowingInPlaceHandlerShouldFailCall)
+    {
+        expectFailed(unaryStatus([](grpc::ServerContext&, const EchoMessage&, EchoMessage& response)
+            {
+                response.set_value(1);
+                fail();
+            }));
+    }
+
+    TEST_F(HandlerErrorTest, ThrowingResponderHandlerShouldFailCall) { expectFailed(status(call(-1))); }
+
+    TEST_F(HandlerErrorTest, ResponderKeptByThrowingHandlerShouldCompleteCall)
+    {
+        auto response = call(3);
+        auto [value, responder, _] = takeCall();
+        responder.response().set_value(value * 2);
+        responder.respond();
+        EXPECT_EQ(response.get().value(), 6);
+    }
+
+    TEST_F(HandlerErrorTest, ThrowingServerStreamHandlerShouldFailCall)
+    {
+        auto call = _client->call(&EchoService::Stub::AsyncCount, EchoMessage());
+        auto reader = call->streamReader().get();
+        while (reader->moveNext().get())
+            ;
+        expectFailed(call->finished().get());
+    }
+
+    TEST_F(HandlerErrorTest, ThrowingClientStreamHandlerShouldFailCall)
+    {
+        for (auto stage : { Stage::Start, Stage::Read, Stage::ReadDone })
+        {
+            _failingStage = stage;
+            expectFailed(sum());
+        }
+    }
+
+    TEST_F(HandlerErrorTest, ThrowingBidiStreamHandlerShouldFailCall)
+    {
+        for (auto stage : { Stage::Start, Stage::Read, Stage::ReadDone })
+        {
+            _failingStage = stage;
+            expectFailed(chat());
+        }
+    }
+}
@@ -0,0 +1,112 @@
+#include "EasyGRPC/EchoTest.h"
+
+namespace ShuHai::gRPC::Server::Test
+{
+    using namespace ShuHai::gRPC::Test;
+    using namespace std::chrono_literals;
+
+    class ResponderTest : public EchoTest
+    { };
+
+    TEST_F(ResponderTest, RespondShouldCompleteCall)
+    {
+        auto response = call(3);
+        auto [value, responder, cancellationToken] = takeCall();
+        EXPECT_TRUE(responder.pending());
+        EXPECT_FALSE(cancellationToken.cancelled());
+
+        EchoMessage reply;
+        reply.set_value(value * 2);
+        responder.respond(reply);
+        EXPECT_FALSE(responder.pending());
+        EXPECT_EQ(response.get().value(), 6);
+    }
+
+    TEST_F(ResponderTest, RespondInPlaceShouldCompleteCall)
+    {
+        auto response = call(4);
+        auto [value, responder, _] = takeCall();
+        responder.response().set_value(value * 2);
+        responder.respond();
+        EXPECT_EQ(response.get().value(), 8);
+    }
+
+    TEST_F(ResponderTest, RespondOnAnotherThreadShouldCompleteCall)
+    {
+        auto response = call(5);
+        std::thread([responder = takeCall().responder]() mutable
+            {
+                responder.response().set_value(10);
+                responder.respond();
+            })
+            .join();
+        EXPECT_EQ(response.get().value(), 10);
+    }
+
+    TEST_F(ResponderTest, FailShouldCompleteCallWithStatus)
+    {
+        auto response = call(6);
+        auto responder = takeCall().responder;
+        responder.fail({ grpc::StatusCode::INVALID_ARGUMENT, "Invalid value." });
+        EXPECT_FALSE(responder.pending());
+        EXPECT_EQ(errorCode(response), grpc::StatusCode::INVALID_ARGUMENT);
+    }
+
+    TEST_F(ResponderTest, FailWithOkStatusShouldThrow)
+    {
+        auto response = call(7);
+        auto responder = takeCall().responder;
+        EXPECT_THROW(responder.fail(grpc::Status::OK), std::invalid_argument);
+        EXPECT_TRUE(responder.pending());
+        responder.respond();
+        EXPECT_EQ(errorCode(response), grpc::StatusCode::OK);
+    }
+
+    TEST_F(ResponderTest, CompleteTwiceShouldThrow)
+    {
+        auto response = call(8);
+        auto responder = takeCall().responder;
+        responder.respond();
+        EXPECT_THROW(responder.respond(), std::logic_error);
+        EXPECT_THROW(responder.fail({ grpc::StatusCode::INTERNAL, "" }), std::logic_error);
+        EXPECT_THROW(static_cast<void>(responder.response()), std::logic_error);
+        EXPECT_EQ(errorCode(response), grpc::StatusCode::OK);
+    }
+
+    TEST_F(ResponderTest, MovedFromResponderShouldNotComplete)
+    {
+        auto response = call(9);
+        auto responder = takeCall().responder;
+        auto moved = std::move(responder);
+        EXPECT_FALSE(responder.pending());
+        EXPECT_THROW(responder.respond(), std::logic_error);
+        moved.response().set_value(18);
+        moved.respond();
+        EXPECT_EQ(response.get().value(), 18);
+    }
+
+    TEST_F(ResponderTest, DroppedResponderShouldFailCallWithInternal)
+    {
+        auto response = call(10);
+        takeCall();
+        EXPECT_EQ(errorCode(response), grpc::StatusCode::INTERNAL);
+    }
+
+    TEST_F(ResponderTest, CompleteAfterServerStoppedShouldBeDropped)
+    {
+        auto response = call(11);
+        auto responder = takeCall().responder;
+        auto droppedResponse = call(12);
+        auto dropped = takeCall().responder;
+
+        _server->stop(100ms);
+        EXPECT_NE(errorCode(response), grpc::StatusCode::OK);
+        EXPECT_NE(errorCode(droppedResponse), grpc::StatusCode::OK);
+
+        // The calls are already cancelled by the shutdown, completing them only releases them.
+        responder.response().set_value(22);
+        responder.respond();
+        EXPECT_FALSE(responder.pending());
+        dropped = {};
+    }
+}
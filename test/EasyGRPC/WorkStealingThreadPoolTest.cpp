@@ -0,0 +1,132 @@
+#include "ShuHai/gRPC/WorkStealingThreadPool.h"
+#include "ShuHai/gRPC/Executor.h"
+
+#include <gtest/gtest.h>
+
+#include <future>
+
+namespace ShuHai::gRPC::Test
+{
+    using namespace std::chrono_literals;
+
+    class WorkStealingThreadPoolTest : public testing::Test
+    {
+    public:
+        static WorkStealingThreadPool::Options options(size_t threadCount)
+        {
+            WorkStealingThreadPool::Options options;
+            options.threadCount = threadCount;
+            return options;
+        }
+    };
+
+    TEST_F(WorkStealingThreadPoolTest, PostShouldRunFunctionsOnWorkers)
+    {
+        WorkStealingThreadPool pool(options(4));
+        EXPECT_EQ(pool.threadCount(), 4u);
+
+        std::atomic<int> count { 0 };
+        std::atomic<int> inlineCount { 0 };
+        auto caller = std::this_thread::get_id();
+        for (int i = 0; i < 1000; ++i)
+        {
+            pool.post(
+                [&]()
+                {
+                    if (std::this_thread::get_id() == caller)
+                        ++inlineCount;
+                    ++count;
+                });
+        }
+        pool.join();
+        EXPECT_EQ(count, 1000);
+        EXPECT_EQ(inlineCount, 0);
+        EXPECT_EQ(pool.pendingCount(), 0u);
+    }
+
+    TEST_F(WorkStealingThreadPoolTest, DispatchShouldRunInlineOnWorkerOnly)
+    {
+        WorkStealingThreadPool pool(options(2));
+
+        std::promise<bool> inlineOnWorker;
+        pool.post(
+            [&]()
+            {
+                bool ran = false;
+                pool.dispatch([&]() { ran = true; });
+                inlineOnWorker.set_value(ran);
+            });
+        EXPECT_TRUE(inlineOnWorker.get_future().get());
+
+        std::promise<std::thread::id> id;
+        pool.dispatch([&]() { id.set_value(std::this_thread::get_id()); });
+        EXPECT_NE(id.get_future().get(), std::this_thread::get_id());
+    }
+
+    TEST_F(WorkStealingThreadPoolTest, PoolShouldWorkAsExecutor)
+    {
+        WorkStealingThreadPool pool(options(1));
+        Executor executor(&pool);
+        EXPECT_TRUE(executor);
+
+        std::promise<std::thread::id> id;
+        executor.dispatch([&]() { id.set_value(std::this_thread::get_id()); });
+        EXPECT_NE(id.get_future().get(), std::this_thread::get_id());
+    }
+
+    TEST_F(WorkStealingThreadPoolTest, IdleWorkerShouldStealFunctions)
+    {
+        WorkStealingThreadPool pool(options(2));
+
+        // Functions posted by a worker go to its own queue, the other worker takes them while it is blocked.
+        std::promise<void> release;
+        auto released = release.get_future().share();
+        std::atomic<int> count { 0 };
+        pool.post(
+            [&]()
+            {
+                for (int i = 0; i < 10; ++i)
+                    pool.post([&]() { ++count; });
+                released.wait();
+            });
+
+        auto deadline = std::chrono::steady_clock::now() + 10s;
+        while (count < 10 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(1ms);
+        EXPECT_EQ(count, 10);
+
+        release.set_value();
+        pool.join();
+    }
+
+    TEST_F(WorkStealingThreadPoolTest, JoinShouldWaitForFunctionsPostedByFunctions)
+    {
+        WorkStealingThreadPool pool(options(4));
+
+        std::atomic<int> count { 0 };
+        std::function<void(int)> spawn = [&](int depth)
+        {
+            ++count;
+            if (depth == 0)
+                return;
+            std::this_thread::sleep_for(1ms);
+            pool.post([&spawn, depth]() { spawn(depth - 1); });
+            pool.post([&spawn, depth]() { spawn(depth - 1); });
+        };
+        pool.post([&]() { spawn(6); });
+        pool.join();
+        EXPECT_EQ(count, (1 << 7) - 1);
+        EXPECT_EQ(pool.pendingCount(), 0u);
+    }
+
+    TEST_F(WorkStealingThreadPoolTest, PostAfterJoinShouldThrow)
+    {
+        WorkStealingThreadPool pool(options(2));
+        pool.join();
+        EXPECT_THROW(pool.post([]() { }), std::logic_error);
+        EXPECT_THROW(pool.dispatch([]() { }), std::logic_error);
+
+        // Joining again takes no effect.
+        pool.join();
+    }
+}